@@ -8,8 +8,6 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
-uniform vec3 cameraPos;
-
 float near = 0.1f;
 float far = 100.0f;
 
@@ -0,0 +1,10 @@
+// per-frame camera data (shared uniform buffer, filled by updateFrameBuffer)
+
+layout (std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 lightSpace;
+	
+	vec3 cameraPos;
+};
@@ -0,0 +1,70 @@
+// lights (shared uniform buffer, filled by updateLightBuffer)
+
+// light structs are laid out for std140 (vec3 followed by a float), keep in sync with graphics.cpp
+struct DirectionalLight {
+	vec3 direction;
+	float ambient; // ambient brightness (not color)
+	
+	vec3 color;
+	float diffuse; // diffuse brightness (not color)
+	
+	float specular; // specular brightness (not color)
+};
+
+struct PointLight {
+	vec3 position; // position
+	float constant; // attenuation factors
+	
+	vec3 color; // (this is color)
+	float linear;
+	
+	float quadratic;
+	float ambient; // ambient brightness (not color)
+	float diffuse; // diffuse brightness (not color)
+	float specular; // specular brightness (not color)
+};
+
+struct SpotLight {
+	vec3 position; // position
+	float angle; // angle of cone
+	
+	vec3 direction; // direction
+	float outerAngle; // outer angle of cone
+	
+	vec3 color; // (this is color)
+	float constant; // attenuation factors
+	
+	float linear;
+	float quadratic;
+	float ambient; // ambient brightness (not color)
+	float diffuse; // diffuse brightness (not color)
+	
+	float specular; // specular brightness (not color)
+};
+
+#define MAX_POINT_LIGHTS 16
+#define MAX_SPOT_LIGHTS 16
+#define MAX_DIRECTIONAL_LIGHTS 16
+layout (std140) uniform Lights {
+	int pointLightCount;
+	int spotLightCount;
+	int directionalLightCount;
+	
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLights[MAX_SPOT_LIGHTS];
+	DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+};
+
+// shader variants get the light counts as constants (see getShaderVariant) so the loops unroll or disappear,
+// everything else reads them from the buffer
+#ifndef POINT_LIGHT_COUNT
+#define POINT_LIGHT_COUNT pointLightCount
+#endif
+
+#ifndef SPOT_LIGHT_COUNT
+#define SPOT_LIGHT_COUNT spotLightCount
+#endif
+
+#ifndef DIRECTIONAL_LIGHT_COUNT
+#define DIRECTIONAL_LIGHT_COUNT directionalLightCount
+#endif
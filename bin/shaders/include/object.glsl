@@ -0,0 +1,6 @@
+// per-draw transform (a range of the streaming ring buffer, bound by setUniformTransform)
+
+layout (std140) uniform Object {
+	mat4 model;
+	mat3 normalMatrix;
+};
@@ -0,0 +1,27 @@
+// decoding of compact vertex formats (Vertex_Format, set per draw by setUniformVertexFormat)
+// the defaults leave plain float vertices alone
+
+#define VERTEX_NORMAL_OCT16 1 // same values as graphics.h
+
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+uniform int normalEncoding = 0;
+
+// quantized positions back to mesh space (16 bit normalized ones arrive in [0, 1], half floats relative to the center)
+vec3 decodePosition(vec3 position){
+	return positionOffset + position * positionScale;
+}
+
+// octahedral normals arrive as (x, y, 0), everything else is already a normal (10_10_10_2 is normalized by the attribute)
+vec3 decodeNormal(vec3 normal){
+	if(normalEncoding != VERTEX_NORMAL_OCT16)
+		return normal;
+	
+	vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+	float t = max(-n.z, 0.0);
+	
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	
+	return normalize(n);
+}
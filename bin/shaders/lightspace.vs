@@ -2,8 +2,9 @@
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
+#include "include/vertexformat.glsl"
+#include "include/object.glsl"
 
 void main(){
-	gl_Position = model * vec4(aPos, 1.0);
+	gl_Position = model * vec4(decodePosition(aPos), 1.0);
 }
\ No newline at end of file
@@ -2,6 +2,20 @@
 
 #version 330 core
 
+// shadow modes, keep in sync with shader.h
+#define SHADOW_NONE 0
+#define SHADOW_HARD 1
+#define SHADOW_PCF 2
+
+// variants (see getShaderVariant) define exactly the features the material uses,
+// without SHADER_VARIANT everything is on and decided at runtime like before
+#ifndef SHADER_VARIANT
+#define HAS_DIFFUSE_MAP
+#define HAS_SPECULAR_MAP
+#define HAS_EMISSION_MAP
+#define SHADOW_MODE SHADOW_PCF
+#endif
+
 struct Material {
 	sampler2D diffuseMaps[8]; // max of 8 textures
 	sampler2D specularMaps[8]; // max of 8 specular
@@ -19,56 +33,6 @@ struct Material {
 	float specularStrength;
 };
 
-struct DirectionalLight {
-	vec3 direction;
-	
-	vec3 color;
-	
-	float ambient;
-	float diffuse;
-	float specular;
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
-struct PointLight {
-	vec3 position; // position
-	
-	// attenuation factors
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 color; // (this is color)
-	
-	float ambient; // ambient brightness (not color)
-	float diffuse; // diffuse brightness (not color)
-	float specular; // specular brightness (not color)
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
-struct SpotLight {
-	vec3 position; // position
-	vec3 direction; // direction
-	
-	float angle; // angle of cone
-	float outerAngle; // outer angle of cone
-	
-	// attenuation factors
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 color; // (this is color)
-	
-	float ambient; // ambient brightness (not color)
-	float diffuse; // diffuse brightness (not color)
-	float specular; // specular brightness (not color)
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
@@ -78,15 +42,9 @@ out vec4 FragColor;
 
 uniform Material material;
 
-// lights
-#define MAX_POINT_LIGHTS 16
-#define MAX_SPOT_LIGHTS 16
-#define MAX_DIRECTIONAL_LIGHTS 16
-uniform PointLight pointLights[MAX_POINT_LIGHTS];
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
-uniform DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+#include "include/lights.glsl"
 
-uniform vec3 cameraPos;
+#include "include/frame.glsl"
 
 uniform sampler2D shadowMap;
 
@@ -112,6 +70,7 @@ void main(){
 	vec3 specularSample = vec3(1, 1, 1);
 	vec3 emissionSample = vec3(0, 0, 0);
 	
+#ifdef HAS_DIFFUSE_MAP
 	if(material.diffuseCount > 0){
 		diffuseSample = texture(material.diffuseMaps[0], TexCoords);
 		//diffuseSample = pow(texture(material.diffuseMaps[0], TexCoords), vec4(vec3(GAMMA), 1.0));
@@ -120,7 +79,9 @@ void main(){
 			diffuseSample = mix(diffuseSample, texture(material.diffuseMaps[i], TexCoords), 0.5);
 		}
 	}
+#endif
 	
+#ifdef HAS_SPECULAR_MAP
 	if(material.specularCount > 0){
 		specularSample = vec3(texture(material.specularMaps[0], TexCoords));
 		
@@ -128,7 +89,9 @@ void main(){
 			specularSample += vec3(texture(material.specularMaps[i], TexCoords));
 		}
 	}
+#endif
 	
+#ifdef HAS_EMISSION_MAP
 	if(material.emissionCount > 0){
 		emissionSample = vec3(texture(material.emissionMaps[0], TexCoords));
 		
@@ -136,6 +99,7 @@ void main(){
 			emissionSample += vec3(texture(material.emissionMaps[i], TexCoords));
 		}	
 	}
+#endif
 	
 	// final values
 	vec3 ambient = 	vec3(0.0f, 0.0f, 0.0f);
@@ -143,48 +107,34 @@ void main(){
 	vec3 specular = vec3(0.0f, 0.0f, 0.0f);
 	
 	// loop through each light
-	for(int i = 0; i < MAX_POINT_LIGHTS; i++){
-		//vec3 lightingFactors = calculatePointLight(pointLights[i], material);
+	for(int i = 0; i < POINT_LIGHT_COUNT; i++){
 		PointLight l = pointLights[i];
 		
-		// for now, this is a cheap hack to test if the light actually exists (if not then ambient should be undefined and this if will progress)
-		if(l.exists){
-			vec3 lightingFactors = calculatePointLight(l, material);
-			
-			ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculatePointLight(l, material);
+		
+		ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
 	}
 	
-	for(int i = 0; i < MAX_SPOT_LIGHTS; i++){
+	for(int i = 0; i < SPOT_LIGHT_COUNT; i++){
 		SpotLight l = spotLights[i];
 		
-		if(l.exists){	
-			vec3 lightingFactors = calculateSpotLight(l, material);
-			
-			ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculateSpotLight(l, material);
+		
+		ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
 	}
 	
-	for(int i = 0; i < MAX_DIRECTIONAL_LIGHTS; i++){
+	for(int i = 0; i < DIRECTIONAL_LIGHT_COUNT; i++){
 		DirectionalLight l = directionalLights[i];
 		
-		if(l.exists){
-			vec3 lightingFactors = calculateDirectionalLight(directionalLights[i], material);
-			
-			ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculateDirectionalLight(l, material);
+		
+		ambient += material.color * vec3(diffuseSample) * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * vec3(diffuseSample) * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularSample * lightingFactors.z * l.color * l.specular;
 	}
 	
 	/*if(testing == 1.0f){
@@ -198,7 +148,11 @@ void main(){
 	}*/
 	
 	// final color
+#if SHADOW_MODE != SHADOW_NONE
 	float shadow = calculateFragInShadow(FragPosLightSpace);
+#else
+	float shadow = 0.0;
+#endif
 	vec3 final = ambient + (1.0 - shadow) * (diffuse + specular) + emissionSample;
 	final.rgb = pow(final, vec3(1.0/GAMMA));
 	FragColor = vec4(final, diffuseSample.w);
@@ -292,6 +246,7 @@ float calculateFragInShadow(vec4 fragPosLightSpace){
 	//float bias = max(0.05 * (1.0 - dot(normalize(Normal), lightDir)), 0.005);
 	float bias = 0.0;
 	
+#if SHADOW_MODE == SHADOW_PCF
 	float shadow = 0.0;
 	vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
 	for(float x = -2; x <= 2; x++)
@@ -303,6 +258,9 @@ float calculateFragInShadow(vec4 fragPosLightSpace){
 			}    
 	}
 	shadow /= 25.0;
+#else
+	float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
+#endif
 
 	// if the currentDepth is greater (therefore further) than the closest depth, then the fragment is in shadow)
 	return shadow;
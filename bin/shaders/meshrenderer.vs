@@ -6,13 +6,22 @@ layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec2 vTexCoord;
 layout (location = 2) in vec3 vNormal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "include/frame.glsl"
+#include "include/vertexformat.glsl"
 
-uniform mat4 lightSpace;
+#ifdef INSTANCED
+// per-instance transforms (Instance_Data)
+layout (location = 3) in mat4 iModel;
+layout (location = 7) in mat3 iNormalMatrix;
 
-uniform mat3 normalMatrix;
+#define MODEL_MATRIX iModel
+#define NORMAL_MATRIX iNormalMatrix
+#else
+#include "include/object.glsl"
+
+#define MODEL_MATRIX model
+#define NORMAL_MATRIX normalMatrix
+#endif
 
 out vec3 Normal;
 out vec3 FragPos;
@@ -21,11 +30,11 @@ out vec4 FragPosLightSpace;
 
 void main(){
 	// translate according to matrices
-	gl_Position = projection * view * model * vec4(vPos, 1.0);
+	FragPos = vec3(MODEL_MATRIX * vec4(decodePosition(vPos), 1.0));
+	gl_Position = viewProjection * vec4(FragPos, 1.0);
 
-	FragPos = vec3(model * vec4(vPos, 1.0));
 	FragPosLightSpace = lightSpace * vec4(FragPos, 1.0);
 	
-	Normal = normalMatrix * vNormal;
+	Normal = NORMAL_MATRIX * decodeNormal(vNormal);
 	TexCoords = vTexCoord;
 }
\ No newline at end of file
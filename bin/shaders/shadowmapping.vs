@@ -4,11 +4,21 @@
 
 layout (location = 0) in vec3 vPos;
 
-uniform mat4 model;
+#include "include/frame.glsl"
+#include "include/vertexformat.glsl"
 
-uniform mat4 lightSpace;
+#ifdef INSTANCED
+// per-instance transform (Instance_Data), the normal matrix at location 7 isn't needed here
+layout (location = 3) in mat4 iModel;
+
+#define MODEL_MATRIX iModel
+#else
+#include "include/object.glsl"
+
+#define MODEL_MATRIX model
+#endif
 
 void main(){
 	// translate according to matrices
-	gl_Position = lightSpace * model * vec4(vPos, 1.0);
+	gl_Position = lightSpace * MODEL_MATRIX * vec4(decodePosition(vPos), 1.0);
 }
\ No newline at end of file
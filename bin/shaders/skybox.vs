@@ -4,12 +4,12 @@ layout (location = 0) in vec3 vPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "include/frame.glsl"
 
 void main(){
 	TexCoords = vPos;
 	
-	vec4 pos = projection * view * vec4(vPos, 1.0);
+	// rotation only, the skybox follows the camera
+	vec4 pos = projection * mat4(mat3(view)) * vec4(vPos, 1.0);
 	gl_Position = pos.xyww;
 }
\ No newline at end of file
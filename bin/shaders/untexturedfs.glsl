@@ -27,56 +27,6 @@ struct Light {
 	float specular; // specular brightness (not color)
 };
 
-struct DirectionalLight {
-	vec3 direction;
-	
-	vec3 color;
-	
-	float ambient;
-	float diffuse;
-	float specular;
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
-struct PointLight {
-	vec3 position; // position
-	
-	// attenuation factors
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 color; // (this is color)
-	
-	float ambient; // ambient brightness (not color)
-	float diffuse; // diffuse brightness (not color)
-	float specular; // specular brightness (not color)
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
-struct SpotLight {
-	vec3 position; // position
-	vec3 direction; // direction
-	
-	float angle; // angle of cone
-	float outerAngle; // outer angle of cone
-	
-	// attenuation factors
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 color; // (this is color)
-	
-	float ambient; // ambient brightness (not color)
-	float diffuse; // diffuse brightness (not color)
-	float specular; // specular brightness (not color)
-	
-	bool exists; // when setting a light, set this to true so the shader knows to actually calculate it
-};
-
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
@@ -85,15 +35,9 @@ out vec4 FragColor;
 
 uniform Material material;
 
-// lights
-#define MAX_POINT_LIGHTS 16
-#define MAX_SPOT_LIGHTS 16
-#define MAX_DIRECTIONAL_LIGHTS 16
-uniform PointLight pointLights[MAX_POINT_LIGHTS];
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
-uniform DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+#include "include/lights.glsl"
 
-uniform vec3 cameraPos;
+#include "include/frame.glsl"
 
 // quick definitions
 vec3 calculateDirectionalLight(DirectionalLight dlight, Material mat);
@@ -124,48 +68,34 @@ void main(){
 	vec3 specular = vec3(0.0f, 0.0f, 0.0f);
 	
 	// loop through each light
-	for(int i = 0; i < MAX_POINT_LIGHTS; i++){
-		//vec3 lightingFactors = calculatePointLight(pointLights[i], material);
+	for(int i = 0; i < POINT_LIGHT_COUNT; i++){
 		PointLight l = pointLights[i];
 		
-		// for now, this is a cheap hack to test if the light actually exists (if not then ambient should be undefined and this if will progress)
-		if(l.exists){
-			vec3 lightingFactors = calculatePointLight(l, material);
-			
-			ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculatePointLight(l, material);
+		
+		ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
 	}
 	
-	for(int i = 0; i < MAX_SPOT_LIGHTS; i++){
+	for(int i = 0; i < SPOT_LIGHT_COUNT; i++){
 		SpotLight l = spotLights[i];
 		
-		if(l.exists){	
-			vec3 lightingFactors = calculateSpotLight(l, material);
-			
-			ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculateSpotLight(l, material);
+		
+		ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
 	}
 	
-	for(int i = 0; i < MAX_DIRECTIONAL_LIGHTS; i++){
+	for(int i = 0; i < DIRECTIONAL_LIGHT_COUNT; i++){
 		DirectionalLight l = directionalLights[i];
 		
-		if(l.exists){
-			vec3 lightingFactors = calculateDirectionalLight(directionalLights[i], material);
-			
-			ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
-			diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
-			specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
-		} else {
-			break;
-		}
+		vec3 lightingFactors = calculateDirectionalLight(l, material);
+		
+		ambient += material.color * diffuseTextureSample * lightingFactors.x * l.color * l.ambient;
+		diffuse += material.color * diffuseTextureSample * lightingFactors.y * l.color * l.diffuse;
+		specular += material.specularStrength * specularTextureSample * lightingFactors.z * l.color * l.specular;
 	}
 	
 	// final color
@@ -6,11 +6,9 @@ layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec2 vTexCoord;
 layout (location = 2) in vec3 vNormal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-uniform mat3 normalMatrix;
+#include "include/frame.glsl"
+#include "include/vertexformat.glsl"
+#include "include/object.glsl"
 
 out vec3 Normal;
 out vec3 FragPos;
@@ -18,10 +16,9 @@ out vec2 TexCoords;
 
 void main(){
 	// translate according to matrices
-	gl_Position = projection * view * model * vec4(vPos, 1.0);
-
-	FragPos = vec3(model * vec4(vPos, 1.0));
+	FragPos = vec3(model * vec4(decodePosition(vPos), 1.0));
+	gl_Position = viewProjection * vec4(FragPos, 1.0);
 	
-	Normal = normalMatrix * vNormal;
+	Normal = normalMatrix * decodeNormal(vNormal);
 	TexCoords = vTexCoord;
 }
\ No newline at end of file
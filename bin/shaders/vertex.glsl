@@ -7,13 +7,14 @@ layout (location = 1) in vec2 vTexCoord;
 
 out vec2 TexCoord;
 
+#include "include/frame.glsl"
+#include "include/vertexformat.glsl"
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main(){
 	// translate according to matrices
-	gl_Position = projection * view * model * vec4(vPos, 1.0);
+	gl_Position = viewProjection * model * vec4(decodePosition(vPos), 1.0);
 	
 	TexCoord = vTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+// linear allocator for short lived scratch memory (header)
+
+#ifndef PRACTICE_ARENA_H
+#define PRACTICE_ARENA_H
+
+#include <vector>
+
+#include <types.h>
+
+#define ARENA_ALIGNMENT 16
+
+// chunks of memory handed out front to back, nothing is freed on its own, only everything after a mark at once
+// (or the whole arena), a request that doesn't fit in the current block starts a new one
+struct Arena_Block {
+	u8 *memory;
+	u64 size;
+	u64 used;
+};
+
+struct Memory_Arena {
+	std::vector<Arena_Block> blocks;
+	u32 current; // block being allocated from
+	u64 blockSize; // minimum size of a new block
+	
+	u64 used; // bytes handed out right now (including alignment padding)
+	u64 peak;
+	u64 reserved; // bytes malloc'd for blocks
+};
+
+// a point to rewind to
+struct Arena_Mark {
+	u32 block;
+	u64 used;
+	u64 arenaUsed;
+};
+
+void initArena(Memory_Arena *arena, u64 blockSize);
+void freeArena(Memory_Arena *arena);
+
+void *arenaAlloc(Memory_Arena *arena, u64 size);
+
+Arena_Mark arenaMark(Memory_Arena *arena);
+void arenaRewind(Memory_Arena *arena, Arena_Mark mark);
+
+// typed helper, memory is uninitialized
+#define arenaPush(arena, type, count) ((type*)arenaAlloc(arena, (u64)(count) * sizeof(type)))
+
+#endif
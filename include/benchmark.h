@@ -0,0 +1,15 @@
+// microbenchmarks (header)
+
+#ifndef PRACTICE_BENCHMARK_H
+#define PRACTICE_BENCHMARK_H
+
+#include <shader.h>
+#include <ringbuffer.h>
+#include <types.h>
+
+void benchmarkUniforms(ShaderProgram *program, u32 iterations);
+void benchmarkObjectTransforms(ShaderProgram *uniformProgram, ShaderProgram *blockProgram, Ring_Buffer *ring, u32 iterations);
+void benchmarkTransforms();
+void benchmarkModelLoading();
+
+#endif
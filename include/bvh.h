@@ -0,0 +1,79 @@
+// dynamic bounding volume hierarchy over scene objects/model meshes (header)
+
+#ifndef PRACTICE_BVH_H
+#define PRACTICE_BVH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <graphics.h>
+#include <model.h>
+#include <types.h>
+
+#define BVH_NULL -1
+
+// what a leaf stands for, either an object or one mesh of a model
+// (objects/models are pointed to, so they can't move in memory while they're in the tree)
+struct BVH_Leaf {
+	Object_Data *object;
+	Model *model;
+	u32 mesh;
+};
+
+struct BVH_Node {
+	// leaves store a box a bit bigger than what was inserted so small movements don't touch the tree
+	glm::vec3 minimum;
+	glm::vec3 maximum;
+	
+	s32 parent; // next free node while on the free list
+	s32 children[2]; // BVH_NULL for leaves
+	s32 height; // 0 for leaves, -1 for free nodes
+	
+	BVH_Leaf leaf;
+};
+
+// nodes live in one array and refer to each other by index, proxies (leaf indices) stay valid until removed
+struct BVH {
+	std::vector<BVH_Node> nodes;
+	s32 root;
+	s32 freeList;
+	
+	float margin; // added to every side of a leaf's box
+	u32 leafCount;
+	
+	std::vector<s32> stack; // traversal stack, kept so queries don't allocate
+};
+
+// closest thing a ray hit
+struct BVH_Hit {
+	bool hit;
+	float distance; // along the (normalized) ray direction
+	glm::vec3 position;
+	s32 proxy; // leaf that was hit
+	u32 triangle; // index of the triangle within the mesh (first index / 3)
+};
+
+void initBVH(BVH *bvh, float margin);
+
+s32 insertBVH(BVH *bvh, Bounds bounds, BVH_Leaf leaf);
+void removeBVH(BVH *bvh, s32 proxy);
+bool moveBVH(BVH *bvh, s32 proxy, Bounds bounds);
+
+// objects/models, bounds come from their vertex data and current matrices (call after updateObjectData/updateModel)
+void insertObjectBVH(BVH *bvh, Object_Data *object);
+void updateObjectBVH(BVH *bvh, Object_Data *object);
+void removeObjectBVH(BVH *bvh, Object_Data *object);
+void insertModelBVH(BVH *bvh, Model *model);
+void updateModelBVH(BVH *bvh, Model *model);
+void removeModelBVH(BVH *bvh, Model *model);
+
+// queries append the proxies of every leaf whose (fattened) box passes the test, return how many were added
+u32 queryBVHFrustum(BVH *bvh, glm::vec4 *frustumPlanes, std::vector<s32> *results);
+u32 queryBVHSphere(BVH *bvh, glm::vec3 center, float radius, std::vector<s32> *results);
+u32 queryBVHBox(BVH *bvh, Bounds box, std::vector<s32> *results);
+
+// nearest triangle hit (leaves without cpu side triangles are hit on their box)
+BVH_Hit raycastBVH(BVH *bvh, glm::vec3 origin, glm::vec3 direction, float maxDistance);
+
+#endif
@@ -21,6 +21,12 @@ struct Camera {
 	// matrices
 	glm::mat4 view;
 	glm::mat4 projection;
+	glm::mat4 viewProjection; // projection * view
+	
+	float nearPlane;
+	float farPlane;
+	
+	glm::vec4 frustumPlanes[6]; // from viewProjection (see extractFrustumPlanes), world space
 };
 
 Camera createCamera(glm::vec3 position, glm::vec3 rotation, float fov, float aspect, float near, float far);
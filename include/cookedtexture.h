@@ -0,0 +1,45 @@
+// pre-mipmapped, block compressed textures written by the cooker (header)
+
+#ifndef PRACTICE_COOKEDTEXTURE_H
+#define PRACTICE_COOKEDTEXTURE_H
+
+#include <types.h>
+
+#define TEXTURE_COOKED_EXTENSION ".cooked" // added to an image's path for its cooked file
+#define CUBEMAP_COOKED_NAME "cubemap.cooked" // all 6 faces of a cubemap, next to them
+
+#define COOKED_TEXTURE_MAGIC 0x58455443 // "CTEX"
+#define COOKED_TEXTURE_VERSION 1
+#define COOKED_TEXTURE_MAX_LEVELS 16 // 32768 x 32768
+
+// S3TC, 4x4 pixel blocks
+#define COOKED_TEXTURE_BC1 0 // rgb, 8 bytes per block
+#define COOKED_TEXTURE_BC3 1 // rgba, 16 bytes per block (BC1 colors + interpolated alpha)
+
+// file layout: this, then every level (largest first) of face 0, then of face 1...
+// rows of blocks go bottom to top for textures (the way opengl wants them), top to bottom for cubemap faces
+struct Cooked_Texture_Header {
+	u32 magic;
+	u32 version;
+	u64 key; // source images' size/time (see cookedTextureKey), anything else is stale
+	
+	u32 width; // level 0
+	u32 height;
+	u32 channels; // of the source image
+	u32 compression;
+	u32 faces; // 1, or 6 for cubemaps (+x, -x, +y, -y, +z, -z)
+	u32 levels; // down to 1x1
+};
+
+u64 cookedTextureKey(const char **paths, u32 count);
+
+u32 getCookedLevelSize(u32 width, u32 height, u32 compression);
+u64 getCookedTextureSize(Cooked_Texture_Header *header); // everything after the header
+
+bool cookTexture(const char *path);
+bool cookCubemap(const char **paths, const char *cookedPath);
+
+void compressBlockBC1(u8 *destination, const u8 *pixels);
+void compressBlockBC3(u8 *destination, const u8 *pixels);
+
+#endif
@@ -0,0 +1,18 @@
+// frustum culling (header)
+
+#ifndef PRACTICE_CULLING_H
+#define PRACTICE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <types.h>
+
+// planes (xyz = inward normal, w = distance) of the frustum of viewProjection, left, right, bottom, top, near, far
+void extractFrustumPlanes(glm::mat4 viewProjection, glm::vec4 *planes);
+
+// test world space boxes against 6 planes, visible[i] = 1 if box i is at least partly inside, returns the visible count
+// boxes are one array per component (center x, y, z then extents x, y, z), 4 at a time with sse when it's available
+// arrays don't need any alignment or padding
+u32 cullBoxes(glm::vec4 *planes, float *centers[3], float *extents[3], u32 count, u8 *visible);
+
+#endif
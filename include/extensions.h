@@ -0,0 +1,91 @@
+// opengl extensions newer than the 3.3 core glad was generated for (header)
+
+#ifndef PRACTICE_EXTENSIONS_H
+#define PRACTICE_EXTENSIONS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <types.h>
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// ARB_draw_indirect (core in 4.0) + ARB_multi_draw_indirect (core in 4.3)
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+// EXT_texture_compression_s3tc (+ the sRGB versions from EXT_texture_sRGB)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// layout of one command in a GL_DRAW_INDIRECT_BUFFER for indexed draws
+struct DrawElementsIndirectCommand {
+	u32 count;
+	u32 instanceCount;
+	u32 firstIndex;
+	s32 baseVertex;
+	u32 baseInstance; // must be 0 without ARB_base_instance (glExtensions.baseInstance)
+};
+
+typedef void (APIENTRYP PFN_MULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+typedef void (APIENTRYP PFN_BUFFERSTORAGE)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+typedef void (APIENTRYP PFN_MAXSHADERCOMPILERTHREADS)(GLuint count);
+
+typedef void (APIENTRYP PFN_GETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFN_PROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFN_PROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+
+// which extensions are usable on the current context
+struct GLExtensions {
+	bool programBinary;
+	bool parallelShaderCompile;
+	bool multiDrawIndirect;
+	bool baseInstance; // indirect commands and instanced attributes can start past instance 0
+	bool bufferStorage;
+	bool textureCompressionS3TC;
+	bool textureSRGBS3TC; // sRGB versions of the S3TC formats
+};
+
+extern GLExtensions glExtensions;
+
+extern PFN_GETPROGRAMBINARY extGetProgramBinary;
+extern PFN_PROGRAMBINARY extProgramBinary;
+extern PFN_PROGRAMPARAMETERI extProgramParameteri;
+
+extern PFN_MAXSHADERCOMPILERTHREADS extMaxShaderCompilerThreads;
+
+extern PFN_MULTIDRAWELEMENTSINDIRECT extMultiDrawElementsIndirect;
+
+extern PFN_BUFFERSTORAGE extBufferStorage;
+
+void loadExtensions();
+
+#endif
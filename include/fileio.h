@@ -3,6 +3,14 @@
 #ifndef PRACTICE_FILEIO_H
 #define PRACTICE_FILEIO_H
 
+#include <types.h>
+
 char* read_entire_file(char* file);
+void* read_binary_file(const char* file, u64 *size);
+bool write_binary_file(const char* file, const void* data, u64 size);
+bool make_directory(const char* path);
+bool file_info(const char* file, u64 *size, u64 *modified);
+void* map_file(const char* file, u64 *size);
+void unmap_file(void* data, u64 size);
 
-#endif
\ No newline at end of file
+#endif
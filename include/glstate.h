@@ -0,0 +1,51 @@
+// gl state cache (header)
+
+#ifndef PRACTICE_GLSTATE_H
+#define PRACTICE_GLSTATE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <types.h>
+
+#define STATE_TEXTURE_UNITS 32 // units tracked by the cache, binds past this always go through
+
+// kinds of state changes that are counted
+enum StateCounter {
+	STATE_PROGRAM,
+	STATE_VERTEX_ARRAY,
+	STATE_FRAMEBUFFER,
+	STATE_ACTIVE_TEXTURE,
+	STATE_TEXTURE,
+	STATE_CAPABILITY, // enable/disable of cull face and blend
+	STATE_CULL_FACE,
+	STATE_BLEND_FUNC,
+	
+	STATE_COUNTER_COUNT
+};
+
+// how many gl calls were actually issued vs skipped because the state already matched
+struct StateStats {
+	u32 issued[STATE_COUNTER_COUNT];
+	u32 elided[STATE_COUNTER_COUNT];
+};
+
+void stateInvalidate();
+
+void stateUseProgram(u32 program);
+void stateBindVertexArray(u32 vertexArray);
+void stateDeleteVertexArray(u32 vertexArray);
+void stateBindFramebuffer(u32 framebuffer);
+void stateActiveTexture(u32 unit);
+void stateBindTexture(GLenum target, u32 texture);
+void stateBindTexture(u32 unit, GLenum target, u32 texture);
+void stateEnable(GLenum capability);
+void stateDisable(GLenum capability);
+void stateCullFace(GLenum mode);
+void stateBlendFunc(GLenum source, GLenum destination);
+
+StateStats *stateGetStats();
+void stateResetStats();
+void statePrintStats();
+
+#endif
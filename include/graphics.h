@@ -9,6 +9,7 @@
 #include <shader.h>
 #include <types.h>
 #include <camera.h>
+#include <ringbuffer.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,19 +20,70 @@
 #define SPECULAR_MAP 1
 #define EMISSION_MAP 2
 
+// light limits (must match the Lights block in the shaders)
+#define MAX_POINT_LIGHTS 16
+#define MAX_SPOT_LIGHTS 16
+#define MAX_DIRECTIONAL_LIGHTS 16
+
+// axis aligned box and a sphere around the same center
+struct Bounds {
+	glm::vec3 center;
+	glm::vec3 extents; // half the size on each axis
+	float radius;
+};
+
+// vertex attribute encodings, decoded in the vertex shaders (include/vertexformat.glsl has the same values)
+#define VERTEX_POSITION_FLOAT 			0 // 3 floats
+#define VERTEX_POSITION_HALF 			1 // 3 half floats (+ padding) relative to the bounds' center
+#define VERTEX_POSITION_UNORM16 		2 // 3 x 16 bit normalized (+ padding) across the bounds
+
+#define VERTEX_UV_FLOAT 				0 // 2 floats
+#define VERTEX_UV_HALF 					1 // 2 half floats
+
+#define VERTEX_NORMAL_FLOAT 			0 // 3 floats
+#define VERTEX_NORMAL_OCT16 			1 // octahedral, 2 x 16 bit snorm
+#define VERTEX_NORMAL_INT_2_10_10_10 	2 // 3 x 10 bit snorm (+ 2 unused bits)
+
+// how the vertices in a VBO are stored, attributes are interleaved (0 position, 1 uv, 2 normal)
+struct Vertex_Format {
+	u8 position; // VERTEX_POSITION_*
+	u8 uv; // VERTEX_UV_*
+	u8 normal; // VERTEX_NORMAL_*
+	
+	// bytes
+	u32 stride;
+	u32 uvOffset;
+	u32 normalOffset;
+	
+	// stored positions are turned back into mesh space with positionOffset + position * positionScale
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+};
+
 // holds vertex data and VBO
 struct Vertex_Data {
-	float *vertexData; // vertex data
+	float *vertexData; // cpu side vertices, borrowed (whoever created it keeps them alive, NULL once they're gone)
 	u32 vertexCount; // amount of vertices
 	
 	u32 VBO; // vertex buffer object id of this data
 	u32 VAO; // vertex array object id for vertex attributes (NOTE: maybe should be separate?)
+	Vertex_Format format; // what's in the VBO (vertexData is always 8 floats per vertex)
 
-	u32 *indices;
+	u32 *indices; // borrowed too, only u32 indices
 	u32 indicesCount;
 	
 	u32 EBO; // element buffer object id
+	GLenum indexType; // GL_UNSIGNED_INT, or GL_UNSIGNED_SHORT when every index fits
+	u32 indexSize; // bytes per index in the EBO
 	bool usingEBO; // whether or not this vertex data uses EBO (for drawVertexData calls)
+	
+	// where this mesh starts when it shares its ranges with others (models), 0 otherwise
+	u32 firstIndex; // offset into the EBO (in indices)
+	s32 baseVertex; // added to every index (first vertex when drawn without indices)
+	s32 allocation; // mesh pool ranges the buffers above are part of (see meshpool.h), -1 if they're its own
+	u32 ringGeneration; // dynamic data only, ring storage the VAO points at (see Ring_Buffer)
+	
+	Bounds bounds; // local space, from the vertex positions
 };
 
 // texture data
@@ -46,14 +98,17 @@ struct Texture_Data {
 };
 
 struct Material {
+	u32 id; // unique per createMaterial call (copies share it), used to group draws
+	bool transparent; // blended, drawn back to front after everything opaque
+	
 	// TODO: multiple textures
-	u32 diffuseMaps[8]; // texture id
+	u32 diffuseMaps[MAX_MATERIAL_TEXTURES]; // texture id
 	int diffuseCount; // whether or not texture is bound
 	
-	u32 specularMaps[8]; // texture id
+	u32 specularMaps[MAX_MATERIAL_TEXTURES]; // texture id
 	int specularCount; // whether or not texture is bound
 	
-	u32 emissionMaps[8]; // texture id
+	u32 emissionMaps[MAX_MATERIAL_TEXTURES]; // texture id
 	int emissionCount; // whether or not texture is bound
 	
 	glm::vec3 color;
@@ -119,6 +174,21 @@ struct SpotLight {
 	float specular; // specular brightness (not color)
 };
 
+// what a model/normal matrix pair was last built from, so unchanged transforms aren't rebuilt
+struct Transform_Cache {
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+	
+	bool valid; // false until the first build
+};
+
+// matrices built by updateTransform since the last resetTransformStats
+struct TransformStats {
+	u32 rebuilt;
+	u32 unchanged;
+};
+
 // a 3 dimensional object which uses a Vertex_Data as the base and has a position, and rotation
 struct Object_Data {
 	Vertex_Data vertexData; // vertex data to reference when drawing
@@ -128,8 +198,35 @@ struct Object_Data {
 	glm::vec3 scale;
 	
 	glm::mat4 modelMatrix; // model matrix used for transformations
+	glm::mat3 normalMatrix; // inverse transpose of modelMatrix, built with it
+	Transform_Cache transformCache;
 	
 	Material material; // material
+	
+	s32 bvhProxy; // leaf in a BVH (see bvh.h), -1 if it isn't in one
+};
+
+// per-instance attributes (locations 3-6 model, 7-9 normal matrix in the INSTANCED shader variants)
+struct Instance_Transform {
+	glm::mat4 modelMatrix;
+	glm::mat3 normalMatrix;
+};
+
+#define INSTANCE_ATTRIBUTE_MODEL 3
+#define INSTANCE_ATTRIBUTE_NORMAL 7
+
+// many copies of the same vertex data drawn with one call, each with its own transform
+struct Instance_Data {
+	Vertex_Data vertexData; // mesh being instanced (its buffers are shared, not copied)
+	
+	u32 VAO; // mesh attributes + per-instance attributes
+	u32 instanceVBO;
+	u32 capacity; // instances instanceVBO has room for
+	
+	std::vector<Instance_Transform> transforms; // cpu side, uploaded by updateInstanceData
+	u32 uploadedCount; // instances in instanceVBO (what gets drawn)
+	
+	Bounds bounds; // world space, around every uploaded instance
 };
 
 // a framebuffer which can be rendered to (useful for rendering the scene from a different perspective/settings and storing it for use in the scene itself)
@@ -162,13 +259,26 @@ struct ShadowCaster {
 
 Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize);
 Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize, u32 *indices, u32 indicesCount, u32 indicesSize);
+Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize, u16 *indices, u32 indicesCount, u32 indicesSize);
+Vertex_Data createVertexData(float *vertexData, u32 vertexCount, Vertex_Format format, void *indices, u32 indicesCount, GLenum indexType);
+Vertex_Data createPackedVertexData(void *vertices, u32 vertexCount, Vertex_Format format, void *indices, u32 indicesCount, GLenum indexType, Bounds bounds);
+Vertex_Format createVertexFormat(u32 position, u32 uv, u32 normal);
+u32 packVertices(void *destination, float *vertexData, u32 vertexCount, Vertex_Format *format);
+Vertex_Data createDynamicVertexData(Ring_Buffer *ring, Vertex_Format format);
+void updateDynamicVertexData(Vertex_Data *data, Ring_Buffer *ring, float *vertexData, u32 vertexCount);
+void freeVertexData(Vertex_Data *data);
+void applyVertexFormat(Vertex_Format *format);
 void drawVertexData(Vertex_Data *data, ShaderProgram *shaderProgram);
 
+Bounds computeBounds(float *vertexData, u32 vertexCount, u32 stride);
+Bounds transformBounds(Bounds bounds, glm::mat4 matrix);
+Bounds mergeBounds(Bounds a, Bounds b);
+
 Texture_Data createTexture(const char* path, bool sRGB);
 Texture_Data createTexture(s32 width, s32 height, GLenum format);
 
 u32 createCubemap(std::vector<std::string> paths);
-void drawCubemap(u32 cubemap, Vertex_Data *cube_data, Camera *camera, ShaderProgram program);
+void drawCubemap(u32 cubemap, Vertex_Data *cube_data, Camera *camera, ShaderProgram *program);
 
 DepthBuffer generateDepthMap(s32 width, s32 height);
 DepthBuffer generateDepthCubemap(s32 width, s32 height);
@@ -180,26 +290,55 @@ RenderableBuffer createRenderableBuffer(s32 width, s32 height);
 
 Material createMaterial(glm::vec3 color, float shininess, float specularStrength);
 void bindTextureToMaterial(Material *material, Texture_Data *textureData, int type);
-void setUniformMaterial(Material *material, ShaderProgram program);
+void setUniformMaterial(Material *material, ShaderProgram *program);
+void bindMaterial(Material *material, ShaderProgram *program);
 
 Light createLight(glm::vec3 position, glm::vec3 color, float ambient, float diffuse, float specular);
-void setUniformLight(Light *light, ShaderProgram program);
+void setUniformLight(Light *light, ShaderProgram *program);
 DirectionalLight createDirectionalLight(glm::vec3 direction, glm::vec3 color, float ambient, float diffuse, float specular);
-void setUniformDirectionalLight(DirectionalLight *light, ShaderProgram program, const char* buffer);
+void setUniformDirectionalLight(DirectionalLight *light, ShaderProgram *program, const char* buffer);
 PointLight createPointLight(glm::vec3 position, float constant, float linear, float quadratic, glm::vec3 color, float ambient, float diffuse, float specular);
-void setUniformPointLight(PointLight *light, ShaderProgram program, const char* buffer);
+void setUniformPointLight(PointLight *light, ShaderProgram *program, const char* buffer);
 SpotLight createSpotLight(glm::vec3 position, glm::vec3 direction, float angle, float outerAngle, float constant, float linear, float quadratic, glm::vec3 color, float ambient, float diffuse, float specular);
-void setUniformSpotLight(SpotLight *light, ShaderProgram program, const char* buffer);
+void setUniformSpotLight(SpotLight *light, ShaderProgram *program, const char* buffer);
+
+void initFrameBuffer();
+void updateFrameBuffer(Camera *camera, glm::mat4 lightSpace);
+
+void initObjectBuffer(Ring_Buffer *ring);
 
-void pushPointLight(ShaderProgram program, PointLight *light);
+void initLightBuffer();
+void updateLightBuffer();
+
+void pushPointLight(PointLight *light);
 void resetPointLights();
-void pushSpotLight(ShaderProgram program, SpotLight *light);
+void pushSpotLight(SpotLight *light);
 void resetSpotLights();
-void pushDirectionalLight(ShaderProgram program, DirectionalLight *light);
+void pushDirectionalLight(DirectionalLight *light);
 void resetDirectionalLights();
 
+u32 getShaderVariantKey(Material *material, u32 shadowMode);
+u32 getShaderVariantKey(Material *material, u32 shadowMode, u32 features);
+
+bool updateTransform(Transform_Cache *cache, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix);
+TransformStats *getTransformStats();
+void resetTransformStats();
+
 Object_Data createObjectData(Vertex_Data *vertexData, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, Material *material);
 void updateObjectData(Object_Data *object);
+void setUniformTransform(ShaderProgram *program, glm::mat4 modelMatrix, glm::mat3 normalMatrix);
+void setUniformVertexFormat(ShaderProgram *program, Vertex_Format *format);
 void drawObjectData(Object_Data *object, Camera *camera, ShaderProgram *program);
+void drawObjectData(Object_Data *object, Camera *camera, ShaderPermutations *permutations);
+
+Instance_Data createInstanceData(Vertex_Data *vertexData, u32 capacity);
+void freeInstanceData(Instance_Data *instances);
+void setInstanceBase(Instance_Data *instances, u32 first);
+void clearInstances(Instance_Data *instances);
+void pushInstance(Instance_Data *instances, glm::mat4 modelMatrix);
+void updateInstanceData(Instance_Data *instances);
+void drawInstances(Instance_Data *instances, ShaderProgram *program);
+void drawInstanceData(Instance_Data *instances, Material *material, ShaderProgram *program);
+void drawInstanceData(Instance_Data *instances, Material *material, ShaderPermutations *permutations);
 
 #endif
\ No newline at end of file
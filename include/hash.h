@@ -0,0 +1,35 @@
+// small non-cryptographic hash for cache keys (FNV-1a, 64 bit)
+
+#ifndef PRACTICE_HASH_H
+#define PRACTICE_HASH_H
+
+#include <types.h>
+
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+// hash size bytes of data, chain calls by passing the previous result as seed
+inline u64 hashData(const void *data, u64 size, u64 seed = HASH_SEED){
+	const u8 *bytes = (const u8*)data;
+	u64 hash = seed;
+	
+	for(u64 i = 0; i < size; i++){
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	
+	return hash;
+}
+
+// hash a null terminated string
+inline u64 hashString(const char *string, u64 seed = HASH_SEED){
+	u64 hash = seed;
+	
+	while(*string){
+		hash ^= (u8)*string++;
+		hash *= 0x100000001b3ULL;
+	}
+	
+	return hash;
+}
+
+#endif
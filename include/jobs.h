@@ -0,0 +1,17 @@
+// worker threads for splitting work into independent pieces (header)
+
+#ifndef PRACTICE_JOBS_H
+#define PRACTICE_JOBS_H
+
+#include <types.h>
+
+// called once per piece of work, index goes from 0 to count - 1
+typedef void (*Job_Function)(void *data, u32 index);
+
+void initJobs(u32 threads);
+void shutdownJobs();
+u32 getJobThreadCount();
+
+void runJobs(Job_Function function, void *data, u32 count);
+
+#endif
@@ -0,0 +1,31 @@
+// load time mesh optimization (header)
+
+#ifndef PRACTICE_MESHOPTIMIZE_H
+#define PRACTICE_MESHOPTIMIZE_H
+
+#include <types.h>
+
+#define VERTEX_CACHE_SIZE 16 // fifo post-transform cache used to measure ACMR (and find cluster boundaries for overdraw)
+#define OVERDRAW_THRESHOLD 1.05f // how much worse (relative) ACMR may get when reordering for overdraw
+
+// remap[i] is the index vertex i gets once identical vertices (all stride floats equal) are merged,
+// unique vertices keep the order they first appear in, returns how many there are
+u32 weldVertices(u32 *remap, float *vertices, u32 vertexCount, u32 stride);
+void remapVertices(float *destination, float *vertices, u32 vertexCount, u32 stride, u32 *remap);
+void remapIndices(u32 *destination, u32 *indices, u32 indexCount, u32 *remap);
+
+// reorder triangles so vertices are reused while they're still in the post-transform cache (forsyth's linear speed algorithm)
+void optimizeVertexCache(u32 *destination, u32 *indices, u32 indexCount, u32 vertexCount);
+
+// reorder clusters of an already cache optimized mesh so outward facing ones are drawn first, without
+// making ACMR worse than threshold times the input's (vertices are the positions, first 3 of every stride floats)
+void optimizeOverdraw(u32 *destination, u32 *indices, u32 indexCount, float *vertices, u32 vertexCount, u32 stride, float threshold);
+
+// reorder vertices by first use so vertex fetches walk the buffer forward, indices are rewritten in place
+// returns how many vertices are used (unused ones are dropped)
+u32 optimizeVertexFetch(float *destination, u32 *indices, u32 indexCount, float *vertices, u32 vertexCount, u32 stride);
+
+// average cache misses per triangle with a fifo cache of cacheSize vertices (0.5 is ideal for big grids, 3 is no reuse)
+float analyzeVertexCache(u32 *indices, u32 indexCount, u32 vertexCount, u32 cacheSize, u32 *misses);
+
+#endif
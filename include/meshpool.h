@@ -0,0 +1,90 @@
+// pooled vertex/index buffers for mesh data (header)
+
+#ifndef PRACTICE_MESHPOOL_H
+#define PRACTICE_MESHPOOL_H
+
+#include <vector>
+
+#include <graphics.h>
+#include <types.h>
+
+#define MESH_POOL_VERTEX_BYTES (8 * 1024 * 1024) // vertex buffer of each page (a bigger mesh gets a page sized for it)
+#define MESH_POOL_INDEX_BYTES (4 * 1024 * 1024) // index buffer of each page
+#define MESH_POOL_INDEX_UNIT 4 // index ranges are handed out in 4 byte units so u16 and u32 offsets are both aligned
+#define MESH_POOL_DEFRAGMENT_THRESHOLD 0.5f // compact a page once its fragmentation goes above this after a free
+
+// free space of a buffer in units (vertices, or index units), sorted by offset and never touching each other
+struct Pool_Range {
+	u32 offset;
+	u32 size;
+};
+
+struct Range_Allocator {
+	u32 capacity;
+	u32 used;
+	std::vector<Pool_Range> free;
+};
+
+// one vertex + index buffer pair (immutable storage where supported) and the VAO every mesh in it is drawn with
+struct Mesh_Pool_Page {
+	u32 layout; // vertex layout key, every vertex in the page has this stride/format
+	Vertex_Format format;
+	
+	u32 vertexBuffer;
+	u32 indexBuffer;
+	u32 VAO;
+	
+	Range_Allocator vertices; // units of format.stride
+	Range_Allocator indices; // units of MESH_POOL_INDEX_UNIT
+};
+
+// where a mesh lives right now (defragmenting moves it, handles stay the same)
+struct Mesh_Pool_Allocation {
+	s32 page; // -1 = unused handle
+	
+	u32 firstVertex;
+	u32 vertexCount;
+	
+	u32 indexUnit;
+	u32 indexUnits;
+};
+
+struct Mesh_Pool_Stats {
+	u32 pages;
+	u32 allocations;
+	
+	// bytes
+	u64 vertexCapacity;
+	u64 vertexUsed;
+	u64 indexCapacity;
+	u64 indexUsed;
+	
+	// free ranges across every page, fragmentation is 1 - largest free range / all free space (0 = free space in one piece)
+	u32 freeRanges;
+	float vertexFragmentation;
+	float indexFragmentation;
+	
+	u32 defragmentations;
+	u64 bytesMoved;
+};
+
+// copy a mesh into the pool, vertices are already packed in format, indices can be NULL
+// returns a handle for the functions below
+s32 allocateMesh(Vertex_Format *format, void *vertices, u32 vertexCount, void *indices, u32 indexBytes);
+void freeMesh(s32 allocation);
+
+Mesh_Pool_Page *getMeshPage(s32 allocation);
+
+// current position of a mesh in its page's buffers (0 for -1, so unpooled vertex data can go through the same path)
+s32 getMeshBaseVertex(s32 allocation);
+u64 getMeshIndexOffset(s32 allocation); // bytes
+
+// bumped whenever defragmenting moves something, cached offsets (model batches) have to be rebuilt when it changes
+u32 getMeshPoolGeneration();
+
+u64 defragmentMeshPool();
+
+Mesh_Pool_Stats getMeshPoolStats();
+void printMeshPoolStats();
+
+#endif
@@ -8,27 +8,153 @@
 
 #include <graphics.h>
 #include <shader.h>
+#include <arena.h>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#define MODEL_LOD_SCREEN_SIZE 0.5f // projected radius (fraction of half the screen height) below which lod 1 is used, halves every level
+#define MODEL_LOD_HYSTERESIS 0.1f // how far (relative) the size has to go past a threshold before switching back
+#define MODEL_LOD_MAX_ERROR 0.05f // simplifying a level stops once it would move the surface more than this (fraction of the mesh size)
+
+#define MODEL_IMPORT_BLOCK_SIZE (4 * 1024 * 1024) // minimum arena block for import scratch
+
+#define MODEL_COOKED_EXTENSION ".cooked" // added to a model's path for its cooked file (see loadModel)
+
+// cpu side copies a model keeps once it's on the gpu (see setModelCpuData), everything else imported is freed by then
+#define MODEL_CPU_NONE 0
+#define MODEL_CPU_PICKING (1 << 0) // positions + indices of every level (BVH raycasts, collision)
+#define MODEL_CPU_VERTICES (1 << 1) // full float vertices (8 per vertex) of every mesh, for rebuilding geometry (lods, formats)
+
+// what optimizeModelMesh did to the meshes of the model being imported (reported once it's done)
+struct Model_Optimize_Stats {
+	u32 vertices; // as imported
+	u32 optimizedVertices;
+	u32 triangles;
+	u32 misses; // post-transform cache misses (VERTEX_CACHE_SIZE fifo)
+	u32 optimizedMisses;
+};
+
+// texture a material of the model uses, as the model file names it
+struct Model_Texture_Reference {
+	u32 material;
+	s32 type; // DIFFUSE_MAP/SPECULAR_MAP
+	std::string path; // relative to the model's directory
+};
+
+// everything a model load works with before upload, the arrays all from the arena (released when loadModel returns)
+struct Model_Import {
+	Memory_Arena arena;
+	
+	float *vertices; // 8 floats per vertex, every mesh back to back
+	u32 vertexCount;
+	u32 vertexCapacity;
+	
+	u32 *indices; // relative to each mesh's baseVertex, simplified levels are appended after every mesh
+	u32 indexCount;
+	u32 indexCapacity;
+	
+	std::vector<Model_Texture_Reference> textures; // in the order they're bound (cooked files keep these)
+	Model_Optimize_Stats optimizeStats;
+};
+
+// glMultiDrawElementsBaseVertex arguments of one level of detail of a batch, one entry per mesh
+struct Model_Batch_Lod {
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets; // byte offsets into the pool page's EBO
+	
+	u32 indirectOffset; // byte offset of this level's commands in Model::indirectBuffer
+};
+
+// every mesh of a model using the same material, drawn with one multi draw call
+// meshes can hang off different nodes, each draw picks its node's matrices from Model::nodeInstances by instance
+struct Model_Batch {
+	u32 material; // index into Model::materials
+	
+	std::vector<u32> meshes; // in mesh order, so meshes of the same node are next to each other
+	std::vector<GLint> baseVertices; // every level indexes the same vertices (pool page relative, like offsets)
+	std::vector<Model_Batch_Lod> lods; // lods[0] is the full mesh
+	
+	Bounds bounds; // every mesh in the batch, world space as of the last updateModel that moved something
+};
+
 struct Model {
-	std::vector<Object_Data> meshes;
+	std::vector<Object_Data> meshes; // per mesh draws (all share geometry's buffers through firstIndex/baseVertex)
 	std::string path; // I don't like to use std::string, but when it comes to strings in structs it just gets too complicated when I just want a quick test thing
 	
-	// transformations (no model matrix because only object data is rendered)
+	Vertex_Data geometry; // every mesh's vertices/indices, one range each in the mesh pool
+	std::vector<Material> materials; // one per assimp material, meshes using it get copies (same id)
+	std::vector<u32> meshMaterials; // materials index of each mesh
+	std::vector<u32> meshNodes; // node each mesh hangs off
+	std::vector<Model_Batch> batches;
+	
+	// simplified index buffers, stored after the full ones in the same EBO
+	u32 lodCount; // 1 = only the full meshes
+	u32 lod; // level drawn right now (see selectModelLod)
+	std::vector<float> lodErrors; // largest error of each level (fraction of the mesh size)
+	
+	// node hierarchy (assimp's aiNode tree), in depth first order so every parent comes before its children
+	// and a node's subtree is the range [node, node + subtree size), node 0 is the root
+	std::vector<std::string> nodeNames;
+	std::vector<s32> nodeParents; // -1 for the root
+	std::vector<u32> nodeSubtreeSizes; // including the node itself
+	std::vector<glm::mat4> nodeLocalMatrices; // relative to the parent (aiNode::mTransformation to start with)
+	std::vector<glm::mat4> nodeWorldMatrices; // modelMatrix * parents' local matrices * local matrix
+	std::vector<glm::mat3> nodeNormalMatrices;
+	std::vector<u8> nodeDirty; // local matrix changed, subtree needs new world matrices
+	u32 dirtyNodes; // so a static model skips the hierarchy entirely
+	
+	// world + normal matrix of every node as instance attributes over geometry's buffers, batches are drawn with it
+	// (so with INSTANCED programs), every draw of a mesh uses its node as the instance
+	Instance_Data nodeInstances;
+	
+	u32 indirectBuffer; // draw commands for every batch, base instance = node (0 without multi draw indirect + base instance)
+	
+	// geometry's place in the mesh pool the batches were built for, rebased when defragmenting moves it
+	u32 poolGeneration;
+	s32 poolBaseVertex;
+	u64 poolIndexOffset;
+	
+	// cpu side copies of the geometry, only filled if asked for when loading (see MODEL_CPU_*)
+	// meshes index them through firstIndex/baseVertex like the EBO, lods come after
+	u32 cpuData;
+	std::vector<glm::vec3> positions;
+	std::vector<u32> indices;
+	std::vector<float> vertices;
+	
+	std::vector<s32> meshProxies; // BVH leaf of each mesh (see insertModelBVH)
+	
+	// transformations
 	glm::vec3 position;
 	glm::vec3 rotation;
 	glm::vec3 scale;
+	
+	glm::mat4 modelMatrix; // from position/rotation/scale, updated by updateModel (parent of the root node)
+	glm::mat3 normalMatrix;
+	Transform_Cache transformCache;
 };
 
+void setModelVertexFormat(u32 position, u32 uv, u32 normal);
+void setModelCpuData(u32 flags);
+void releaseModelCpuData(Model *model, u32 flags);
+u64 getModelCpuBytes(Model *model);
 Model loadModel(std::string path);
 Model loadModel(std::string path, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
-void processAssimpNode(Model *model, aiNode *node, const aiScene *scene);
-Object_Data processAssimpMesh(aiMesh *mesh, const aiScene *scene, std::string path);
+Model loadModel(std::string path, u32 lodCount);
+Model loadModel(std::string path, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, u32 lodCount);
+void freeModel(Model *model);
+bool cookModel(std::string path, u32 lodCount);
+u64 cookedModelKey(std::string path);
+void processAssimpNode(Model *model, aiNode *node, const aiScene *scene, s32 parent, Model_Import *import);
+void processAssimpMesh(Model *model, aiMesh *mesh, Model_Import *import);
 void bindAssimpTexturesToMaterial(Material *material, aiMaterial *assimpMat, aiTextureType type, int intType, std::string modelDirectory);
+s32 findModelNode(Model *model, const char* name);
+void setModelNodeTransform(Model *model, u32 node, glm::mat4 localMatrix);
 void updateModel(Model *model);
+u32 selectModelLod(Model *model, Camera *camera);
+void drawModelBatch(Model *model, u32 batch);
 void drawModel(Model *model, Camera *camera, ShaderProgram *program);
+void drawModel(Model *model, Camera *camera, ShaderPermutations *permutations);
 
 #endif
\ No newline at end of file
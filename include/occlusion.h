@@ -0,0 +1,53 @@
+// software occlusion culling (header)
+
+#ifndef PRACTICE_OCCLUSION_H
+#define PRACTICE_OCCLUSION_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <graphics.h>
+#include <types.h>
+
+#define OCCLUSION_BAND_HEIGHT 16 // rows rasterized by one job
+
+// occluder triangle in buffer pixels, z is depth (0 near, 1 far)
+struct Occlusion_Triangle {
+	glm::vec3 vertices[3];
+};
+
+struct Occlusion_Stats {
+	u32 occluders;
+	u32 triangles; // after clipping/backface culling
+	u32 tested;
+	u32 occluded;
+	
+	double rasterizeTime; // ms
+};
+
+// low resolution depth buffer only the occluders are drawn into
+struct Occlusion_Buffer {
+	u32 width; // multiple of 4
+	u32 height;
+	std::vector<float> depth;
+	
+	glm::mat4 viewProjection;
+	std::vector<Occlusion_Triangle> triangles; // this frame's occluders
+	
+	Occlusion_Stats stats;
+};
+
+void initOcclusionBuffer(Occlusion_Buffer *buffer, u32 width, u32 height);
+
+void beginOcclusion(Occlusion_Buffer *buffer, glm::mat4 viewProjection);
+void addOccluder(Occlusion_Buffer *buffer, float *positions, u32 stride, u32 *indices, u32 triangleCount, glm::mat4 modelMatrix);
+void addOccluderBox(Occlusion_Buffer *buffer, Bounds bounds, glm::mat4 modelMatrix);
+void rasterizeOcclusion(Occlusion_Buffer *buffer);
+
+bool isOccluded(Occlusion_Buffer *buffer, Bounds bounds);
+
+Occlusion_Stats *getOcclusionStats(Occlusion_Buffer *buffer);
+void printOcclusionStats(Occlusion_Buffer *buffer);
+
+#endif
@@ -0,0 +1,120 @@
+// render queue (header)
+
+#ifndef PRACTICE_RENDERQUEUE_H
+#define PRACTICE_RENDERQUEUE_H
+
+#include <vector>
+
+#include <graphics.h>
+#include <shader.h>
+#include <camera.h>
+#include <model.h>
+#include <occlusion.h>
+#include <types.h>
+
+#define MAX_RENDER_PASSES 16 // pass is 4 bits of the sort key
+
+// sort key layout (high bits to low bits)
+// opaque: 			pass (4) | 0 | program (12) | material (16) | vertex array (12) | depth (19, front to back)
+// transparent: pass (4) | 1 | depth (24, back to front) | program (12) | material (16) | unused (7)
+// so passes run in order, opaque before transparent, and opaque draws are grouped by state
+#define RENDER_KEY_PASS_SHIFT 60
+#define RENDER_KEY_TRANSPARENT_SHIFT 59
+
+// target + fixed function setup applied when the queue reaches a pass
+struct Render_Pass {
+	bool used; // false = leave state alone
+	
+	u32 framebuffer;
+	s32 viewport[4]; // x, y, width, height
+	GLbitfield clear; // 0 to not clear
+	GLenum cullFace;
+	
+	bool culling; // drop items whose bounds are outside frustumPlanes
+	glm::vec4 frustumPlanes[6];
+	
+	Occlusion_Buffer *occlusion; // drop items hidden behind its occluders too (NULL = don't)
+};
+
+// one draw, everything needed is copied/pointed to at submit time so objects can be reused for several draws
+struct Render_Item {
+	u64 key;
+	
+	ShaderProgram *program;
+	Material *material; // has to stay alive until the queue is drawn
+	Vertex_Data *vertexData;
+	Instance_Data *instances; // instanced draw instead of vertexData (transforms come from the instance buffer)
+	Model *model; // or one batch of a model (multi draw)
+	u32 batch;
+	
+	glm::mat4 modelMatrix;
+	glm::mat3 normalMatrix;
+	
+	Bounds bounds; // world space, for culling
+};
+
+// key + item index, what actually gets sorted
+struct Render_Sort_Entry {
+	u64 key;
+	u32 index;
+};
+
+// state changes made by the queue vs what drawing in submission order would've made (last drawRenderQueue)
+struct Render_Queue_Stats {
+	u32 items;
+	u32 visible; // items left after frustum + occlusion culling
+	u32 culled; // outside the frustum
+	u32 occluded;
+	u32 instances; // objects drawn (instanced items count every instance)
+	u32 triangles; // drawn, after lod selection
+	u32 passChanges;
+	
+	u32 programChanges;
+	u32 materialChanges;
+	u32 vertexArrayChanges;
+	
+	u32 unsortedProgramChanges;
+	u32 unsortedMaterialChanges;
+	u32 unsortedVertexArrayChanges;
+	
+	double sortTime; // ms
+};
+
+struct Render_Queue {
+	std::vector<Render_Item> items;
+	
+	// radix sort buffers, kept between frames so they don't reallocate
+	std::vector<Render_Sort_Entry> entries;
+	std::vector<Render_Sort_Entry> scratch;
+	
+	// culling buffers, same
+	std::vector<u8> visible; // per item
+	std::vector<u32> cullItems; // items of the pass being culled
+	std::vector<float> cullBounds; // their boxes, one array per component
+	std::vector<u8> cullResults;
+	
+	Render_Pass passes[MAX_RENDER_PASSES];
+	
+	Render_Queue_Stats stats;
+};
+
+void initRenderQueue(Render_Queue *queue);
+void setRenderPass(Render_Queue *queue, u32 pass, u32 framebuffer, s32 x, s32 y, s32 width, s32 height, GLbitfield clear, GLenum cullFace);
+
+void setRenderPassFrustum(Render_Queue *queue, u32 pass, glm::vec4 *frustumPlanes);
+void setRenderPassOcclusion(Render_Queue *queue, u32 pass, Occlusion_Buffer *occlusion);
+
+void submitRenderItem(Render_Queue *queue, u32 pass, ShaderProgram *program, Material *material, Vertex_Data *vertexData, glm::mat4 modelMatrix, glm::mat3 normalMatrix, Camera *camera);
+void submitObject(Render_Queue *queue, u32 pass, Object_Data *object, ShaderProgram *program, Camera *camera);
+void submitObject(Render_Queue *queue, u32 pass, Object_Data *object, ShaderPermutations *permutations, Camera *camera);
+void submitModel(Render_Queue *queue, u32 pass, Model *model, ShaderProgram *program, Camera *camera);
+void submitModel(Render_Queue *queue, u32 pass, Model *model, ShaderPermutations *permutations, Camera *camera);
+void submitInstances(Render_Queue *queue, u32 pass, Instance_Data *instances, Material *material, ShaderProgram *program, Camera *camera);
+void submitInstances(Render_Queue *queue, u32 pass, Instance_Data *instances, Material *material, ShaderPermutations *permutations, Camera *camera);
+
+void drawRenderQueue(Render_Queue *queue);
+
+Render_Queue_Stats *getRenderQueueStats(Render_Queue *queue);
+void printRenderQueueStats(Render_Queue *queue);
+
+#endif
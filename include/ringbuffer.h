@@ -0,0 +1,43 @@
+// streaming ring buffer for per frame data (header)
+
+#ifndef PRACTICE_RINGBUFFER_H
+#define PRACTICE_RINGBUFFER_H
+
+#include <glad/glad.h>
+
+#include <types.h>
+
+#define RING_BUFFER_FRAMES 3 // frames the cpu can be ahead of the gpu before it has to wait
+
+// one buffer split into a region per frame in flight, data written in a frame stays untouched until the gpu is done with it
+// (fence per region), with ARB_buffer_storage the buffer stays mapped, otherwise it's orphaned every frame
+struct Ring_Buffer {
+	u32 buffer;
+	u32 generation; // bumped whenever the storage is recreated (buffer names get recycled, so compare this instead)
+	u32 frameSize; // bytes per region
+	
+	bool persistent; // false = orphaning fallback (one region, re-specified every frame)
+	u8 *mapped; // whole buffer while persistent
+	
+	u32 frame; // region being written
+	u32 head; // bytes used in it
+	GLsync fences[RING_BUFFER_FRAMES]; // when the gpu is done with each region (0 = never used)
+	
+	// stats
+	u32 stalls; // frames that had to wait on a fence
+	u32 peak; // most bytes used in one frame (or asked for when it had to grow)
+};
+
+void initRingBuffer(Ring_Buffer *ring, u32 frameSize);
+void freeRingBuffer(Ring_Buffer *ring);
+
+void beginRingFrame(Ring_Buffer *ring);
+void endRingFrame(Ring_Buffer *ring);
+
+// copy size bytes into this frame's region, returns the byte offset into ring->buffer (a multiple of alignment)
+// when the region is full the ring grows on the spot, ring->buffer (and generation) change then, so read them after pushing
+u32 pushRingBuffer(Ring_Buffer *ring, const void *data, u32 size, u32 alignment);
+
+void printRingBufferStats(Ring_Buffer *ring);
+
+#endif
@@ -3,6 +3,9 @@
 #ifndef PRACTICE_SHADER_H
 #define PRACTICE_SHADER_H
 
+#include <string>
+#include <unordered_map>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -16,21 +19,118 @@
 #define SHADER_GEOMETRY GL_GEOMETRY_SHADER
 #define SHADER_FRAGMENT	GL_FRAGMENT_SHADER
 
-typedef u32 ShaderProgram;
+#define MAX_MATERIAL_TEXTURES 8 // size of each sampler array in Material (shader and cpu side)
+
+// texture unit convention, samplers are pointed at these once when a program is linked so draws only bind textures
+#define TEXTURE_UNIT_DIFFUSE_MAPS 	0 // material.diffuseMaps[0..7]
+#define TEXTURE_UNIT_SPECULAR_MAPS 	(TEXTURE_UNIT_DIFFUSE_MAPS + MAX_MATERIAL_TEXTURES) // material.specularMaps[0..7]
+#define TEXTURE_UNIT_EMISSION_MAPS 	(TEXTURE_UNIT_SPECULAR_MAPS + MAX_MATERIAL_TEXTURES) // material.emissionMaps[0..7]
+#define TEXTURE_UNIT_NORMAL_MAP 		(TEXTURE_UNIT_EMISSION_MAPS + MAX_MATERIAL_TEXTURES) // material.normalMap
+#define TEXTURE_UNIT_SHADOW_MAP 		(TEXTURE_UNIT_NORMAL_MAP + 1) // shadowMap
+#define TEXTURE_UNIT_ENVIRONMENT 		(TEXTURE_UNIT_SHADOW_MAP + 1) // env (cubemap)
+
+// uniform block binding points, assigned to every program that declares the block when it's linked
+#define UNIFORM_BLOCK_LIGHTS 0 // "Lights", see updateLightBuffer
+#define UNIFORM_BLOCK_FRAME 1 // "Frame", see updateFrameBuffer
+#define UNIFORM_BLOCK_OBJECT 2 // "Object", a range of the streaming ring per draw (see setUniformTransform)
+
+// shader variants, a key packs the light counts, material features and shadow mode a program is specialized for
+#define VARIANT_LIGHT_BITS 5 // up to 31 of each light type (more than the light buffer holds)
+#define VARIANT_FEATURE_SHIFT 15
+#define VARIANT_SHADOW_SHIFT 24
+
+#define SHADER_FEATURE_DIFFUSE_MAP 	(1 << 0)
+#define SHADER_FEATURE_SPECULAR_MAP (1 << 1)
+#define SHADER_FEATURE_EMISSION_MAP (1 << 2)
+#define SHADER_FEATURE_INSTANCED 		(1 << 3) // transforms from per-instance attributes (see Instance_Data)
+
+// shadow modes (SHADOW_MODE in meshrenderer.fs)
+#define SHADOW_NONE 0
+#define SHADOW_HARD 1 // single tap
+#define SHADOW_PCF 	2 // 5x5 pcf
+
+// locations of the uniforms touched on every draw, resolved once when the program is linked (-1 if the program doesn't use it)
+struct UniformHandles {
+	s32 model;
+	s32 normalMatrix;
+	
+	s32 materialColor;
+	s32 materialShininess;
+	s32 materialSpecularStrength;
+	s32 materialDiffuseCount;
+	s32 materialSpecularCount;
+	s32 materialEmissionCount;
+	
+	// vertex format decoding (see setUniformVertexFormat)
+	s32 positionOffset;
+	s32 positionScale;
+	s32 normalEncoding;
+};
+
+// a linked program and every active uniform in it
+struct ShaderProgram {
+	u32 id; // opengl program id
+	bool ready; // link status collected + uniform table built (happens on first use)
+	
+	std::unordered_map<std::string, s32> uniforms; // uniform name -> location, built from glGetActiveUniform at link time
+	UniformHandles handles;
+	bool objectBlock; // transforms come from the "Object" block instead of the model/normalMatrix uniforms
+	
+	// vertex decode values last set (so switching between meshes of the same format costs nothing)
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+	s32 normalEncoding;
+};
+
+// every specialized program built from one vertex + fragment pair, keyed by makeShaderVariantKey
+struct ShaderPermutations {
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string name;
+	
+	u32 shadowMode; // shadow mode used when picking variants for draws
+	
+	std::unordered_map<u32, ShaderProgram> variants;
+};
+
+// program binary cache hits/misses since startup
+struct ShaderCacheStats {
+	u32 hits;
+	u32 misses;
+};
+
+void enableShaderCache(const char* directory);
+ShaderCacheStats *getShaderCacheStats();
 
 u32 createShader(char* shaderPath, GLenum shaderType);
+u32 createShader(char* shaderPath, GLenum shaderType, const char* defines);
 void deleteShader(u32 shader);
 ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader);
 ShaderProgram createShaderProgram(u32 vertexShader, u32 geometryShader, u32 fragmentShader);
 ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader, const char* shaderName, const char* vertexName, const char* fragmentName);
 ShaderProgram createShaderProgram(u32 vertexShader, u32 geometryShader, u32 fragmentShader, const char* shaderName, const char* vertexName, const char* geometryName, const char* fragmentName);
+void finishShaderProgram(ShaderProgram *program);
+bool shaderProgramReady(ShaderProgram *program);
 void useShader(ShaderProgram *program);
 
-void setUniformFloat(ShaderProgram program, const char* location, float data);
-void setUniformFloat(ShaderProgram program, const char* location, float *data, s32 num);
-void setUniformInt(ShaderProgram program, const char* location, int data);
-void setUniformInt(ShaderProgram program, const char* location, int *data, s32 num);
-void setUniformMat4(ShaderProgram program, const char* location, glm::mat4 matrix);
-void setUniformMat3(ShaderProgram program, const char* location, glm::mat3 matrix);
+u32 makeShaderVariantKey(u32 pointLights, u32 spotLights, u32 directionalLights, u32 features, u32 shadowMode);
+void createShaderPermutations(ShaderPermutations *permutations, const char* vertexPath, const char* fragmentPath, const char* name, u32 shadowMode);
+ShaderProgram *getShaderVariant(ShaderPermutations *permutations, u32 key);
+
+s32 getUniformLocation(ShaderProgram *program, const char* name);
+
+void setUniformFloat(ShaderProgram *program, const char* location, float data);
+void setUniformFloat(ShaderProgram *program, const char* location, float *data, s32 num);
+void setUniformInt(ShaderProgram *program, const char* location, int data);
+void setUniformInt(ShaderProgram *program, const char* location, int *data, s32 num);
+void setUniformMat4(ShaderProgram *program, const char* location, glm::mat4 matrix);
+void setUniformMat3(ShaderProgram *program, const char* location, glm::mat3 matrix);
+
+void setUniformFloat(ShaderProgram *program, s32 location, float data);
+void setUniformFloat(ShaderProgram *program, s32 location, float *data, s32 num);
+void setUniformInt(ShaderProgram *program, s32 location, int data);
+void setUniformInt(ShaderProgram *program, s32 location, int *data, s32 num);
+void setUniformMat4(ShaderProgram *program, s32 location, glm::mat4 matrix);
+void setUniformMat3(ShaderProgram *program, s32 location, glm::mat3 matrix);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+// mesh simplification (header)
+
+#ifndef PRACTICE_SIMPLIFY_H
+#define PRACTICE_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <types.h>
+
+// collapse edges (cheapest quadric error first) until there are at most targetIndexCount indices
+// or the next collapse would move the surface more than targetError (fraction of the mesh's size)
+// vertices are never moved or added, so the result indexes the same vertex buffer as the input
+// returns the new index count (destination needs room for indexCount), error gets the largest error introduced
+u32 simplifyIndices(u32 *destination, u32 *indices, u32 indexCount, glm::vec3 *positions, u32 vertexCount, u32 targetIndexCount, float targetError, float *error);
+
+#endif
@@ -0,0 +1,37 @@
+// batch transforms over structure-of-arrays (header)
+
+#ifndef PRACTICE_TRANSFORM_H
+#define PRACTICE_TRANSFORM_H
+
+#include <glm/glm.hpp>
+
+#include <types.h>
+
+// one array per component so 4 objects can be loaded into a register at once
+// arrays are 16 byte aligned and padded to a multiple of 4
+struct Transform_Arrays {
+	u32 count;
+	u32 capacity;
+	
+	float *position[3]; // x, y, z
+	float *rotation[4]; // euler x, y, z (radians, same order as updateObjectData) or quaternion x, y, z, w
+	float *scale[3];
+	
+	void *memory; // one allocation for all of the above
+};
+
+Transform_Arrays createTransformArrays(u32 count);
+void freeTransformArrays(Transform_Arrays *arrays);
+void setTransformEuler(Transform_Arrays *arrays, u32 index, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+void setTransformQuaternion(Transform_Arrays *arrays, u32 index, glm::vec3 position, glm::vec4 rotation, glm::vec3 scale);
+
+// write model + normal matrices for every transform, normalMatrices can be NULL
+// same results as updateTransform (within float rounding), the sse path is used when the compiler targets it
+void batchTransformsEuler(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices);
+void batchTransformsQuaternion(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices);
+
+// scalar versions (fallback, and for comparing in benchmarks)
+void batchTransformsEulerScalar(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices);
+void batchTransformsQuaternionScalar(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices);
+
+#endif
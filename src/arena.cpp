@@ -0,0 +1,92 @@
+// linear allocator for short lived scratch memory
+// allocating is a pointer bump, blocks are kept when rewinding so a loop that marks/rewinds reuses the same memory
+
+#include <arena.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+void initArena(Memory_Arena *arena, u64 blockSize){
+	arena->blocks.clear();
+	arena->current = 0;
+	arena->blockSize = blockSize;
+	arena->used = 0;
+	arena->peak = 0;
+	arena->reserved = 0;
+}
+
+void freeArena(Memory_Arena *arena){
+	for(u32 i = 0; i < arena->blocks.size(); i++)
+		free(arena->blocks[i].memory);
+	
+	arena->blocks.clear();
+	arena->current = 0;
+	arena->used = 0;
+	arena->reserved = 0;
+}
+
+// size bytes aligned to ARENA_ALIGNMENT, NULL if malloc fails
+void *arenaAlloc(Memory_Arena *arena, u64 size){
+	size = (size + ARENA_ALIGNMENT - 1) & ~(u64)(ARENA_ALIGNMENT - 1);
+	
+	// rest of the current block, or the next already allocated one that's big enough (left over from a rewind)
+	while(arena->current < arena->blocks.size()){
+		Arena_Block *block = &arena->blocks[arena->current];
+		
+		if(block->used + size <= block->size){
+			void *memory = block->memory + block->used;
+			
+			block->used += size;
+			arena->used += size;
+			
+			if(arena->used > arena->peak)
+				arena->peak = arena->used;
+			
+			return memory;
+		}
+		
+		// whatever is left in a block that's passed over counts as used until it's rewound
+		arena->used += block->size - block->used;
+		block->used = block->size;
+		
+		arena->current++;
+	}
+	
+	Arena_Block block;
+	block.size = size > arena->blockSize ? size : arena->blockSize;
+	block.used = 0;
+	block.memory = (u8*)malloc(block.size); // malloc is aligned to at least 16 on every 64 bit target
+	
+	if(!block.memory){
+		printf("arena: couldn't allocate %llu bytes\n", (unsigned long long)block.size);
+		return NULL;
+	}
+	
+	arena->blocks.push_back(block);
+	arena->current = arena->blocks.size() - 1;
+	arena->reserved += block.size;
+	
+	return arenaAlloc(arena, size);
+}
+
+Arena_Mark arenaMark(Memory_Arena *arena){
+	Arena_Mark mark;
+	
+	mark.block = arena->current;
+	mark.used = arena->current < arena->blocks.size() ? arena->blocks[arena->current].used : 0;
+	mark.arenaUsed = arena->used;
+	
+	return mark;
+}
+
+// free everything allocated since mark (blocks stay around for the next allocations)
+void arenaRewind(Memory_Arena *arena, Arena_Mark mark){
+	for(u32 i = mark.block + 1; i < arena->blocks.size(); i++)
+		arena->blocks[i].used = 0;
+	
+	if(mark.block < arena->blocks.size())
+		arena->blocks[mark.block].used = mark.used;
+	
+	arena->current = mark.block;
+	arena->used = mark.arenaUsed;
+}
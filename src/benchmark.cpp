@@ -0,0 +1,258 @@
+// microbenchmarks, run from main when RUN_BENCHMARKS is defined
+
+#include <benchmark.h>
+#include <glstate.h>
+#include <graphics.h>
+#include <transform.h>
+#include <model.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// print how many calls per second something managed
+static void reportBenchmark(const char* name, u32 iterations, double seconds){
+	printf("  %-32s %10.0f calls/s (%.3f ms total)\n", name, (double)iterations / seconds, seconds * 1000.0);
+}
+
+// compare the old glGetUniformLocation-per-call path with the uniform table and precomputed handles
+// needs a program with a "model" mat4 uniform (mainShader works, the mesh renderer takes it from the Object block)
+void benchmarkUniforms(ShaderProgram *program, u32 iterations){
+	glm::mat4 matrix = glm::mat4(1.0f);
+	
+	printf("uniform benchmark (%u iterations):\n", iterations);
+	
+	useShader(program); // make sure it's finished linking before timing anything
+	
+	// before: query the location by string on every call
+	glFinish();
+	double start = glfwGetTime();
+	for(u32 i = 0; i < iterations; i++){
+		matrix[3][0] = (float)i;
+		
+		int uniformLocation = glGetUniformLocation(program->id, "model");
+		glUseProgram(program->id);
+		glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(matrix));
+	}
+	glFinish();
+	reportBenchmark("glGetUniformLocation per call", iterations, glfwGetTime() - start);
+	
+	stateInvalidate(); // the loop above went around the state cache
+	
+	// after: name looked up in the program's table
+	start = glfwGetTime();
+	for(u32 i = 0; i < iterations; i++){
+		matrix[3][0] = (float)i;
+		
+		setUniformMat4(program, "model", matrix);
+	}
+	glFinish();
+	reportBenchmark("uniform table (by name)", iterations, glfwGetTime() - start);
+	
+	// after: precomputed handle, no string work at all
+	start = glfwGetTime();
+	for(u32 i = 0; i < iterations; i++){
+		matrix[3][0] = (float)i;
+		
+		setUniformMat4(program, program->handles.model, matrix);
+	}
+	glFinish();
+	reportBenchmark("precomputed handle", iterations, glfwGetTime() - start);
+}
+
+// per-draw transforms as plain uniforms (uniformProgram) vs ranges of the ring bound to the "Object" block (blockProgram)
+// the ring is cycled every OBJECT_BENCHMARK_FRAME transforms like a frame would
+#define OBJECT_BENCHMARK_FRAME 1000
+
+void benchmarkObjectTransforms(ShaderProgram *uniformProgram, ShaderProgram *blockProgram, Ring_Buffer *ring, u32 iterations){
+	glm::mat4 matrix = glm::mat4(1.0f);
+	glm::mat3 normalMatrix = glm::mat3(1.0f);
+	
+	printf("object transform benchmark (%u iterations):\n", iterations);
+	
+	useShader(uniformProgram);
+	
+	glFinish();
+	double start = glfwGetTime();
+	for(u32 i = 0; i < iterations; i++){
+		matrix[3][0] = (float)i;
+		
+		setUniformTransform(uniformProgram, matrix, normalMatrix);
+	}
+	glFinish();
+	reportBenchmark("model/normalMatrix uniforms", iterations, glfwGetTime() - start);
+	
+	useShader(blockProgram);
+	
+	start = glfwGetTime();
+	beginRingFrame(ring);
+	for(u32 i = 0; i < iterations; i++){
+		matrix[3][0] = (float)i;
+		
+		if(i > 0 && i % OBJECT_BENCHMARK_FRAME == 0){
+			endRingFrame(ring);
+			beginRingFrame(ring);
+		}
+		
+		setUniformTransform(blockProgram, matrix, normalMatrix);
+	}
+	endRingFrame(ring);
+	glFinish();
+	reportBenchmark("ring buffer ranges", iterations, glfwGetTime() - start);
+	
+	printRingBufferStats(ring);
+}
+
+// largest difference between a batch kernel's output and updateTransform's, relative to the reference for large elements
+#define TRANSFORM_TOLERANCE 1e-4f
+
+static float transformError(float value, float reference){
+	return fabsf(value - reference) / fmaxf(1.0f, fabsf(reference));
+}
+
+// check a batch kernel against the updateTransform results, returns whether every matrix was within TRANSFORM_TOLERANCE
+static bool compareTransforms(const char* name, u32 count, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices, glm::mat4 *referenceModels, glm::mat3 *referenceNormals){
+	u32 mismatches = 0;
+	u32 worstIndex = 0;
+	float worst = 0.0f;
+	
+	for(u32 i = 0; i < count; i++){
+		float error = 0.0f;
+		
+		for(u32 column = 0; column < 4; column++)
+			for(u32 row = 0; row < 4; row++)
+				error = fmaxf(error, transformError(modelMatrices[i][column][row], referenceModels[i][column][row]));
+		
+		for(u32 column = 0; column < 3; column++)
+			for(u32 row = 0; row < 3; row++)
+				error = fmaxf(error, transformError(normalMatrices[i][column][row], referenceNormals[i][column][row]));
+		
+		if(error > TRANSFORM_TOLERANCE)
+			mismatches++;
+		
+		if(error > worst){
+			worst = error;
+			worstIndex = i;
+		}
+	}
+	
+	if(mismatches > 0)
+		printf("  %-32s MISMATCH: %u of %u transforms differ from updateTransform (worst %g at %u)\n", name, mismatches, count, worst, worstIndex);
+	
+	return mismatches == 0;
+}
+
+// compare rebuilding transforms one object at a time (what updateObjectData does) with the batch kernels
+// every transform is treated as changed so the cache never skips work
+// the quaternions hold the same rotations as the euler angles, so every kernel is checked against updateTransform's results
+void benchmarkTransforms(){
+	u32 counts[] = {10000, 100000, 1000000};
+	
+	printf("transform benchmark:\n");
+	
+	for(u32 n = 0; n < 3; n++){
+		u32 count = counts[n];
+		
+		Transform_Arrays eulers = createTransformArrays(count);
+		Transform_Arrays quaternions = createTransformArrays(count);
+		std::vector<Transform_Cache> caches(count);
+		
+		for(u32 i = 0; i < count; i++){
+			glm::vec3 position = glm::vec3(i % 100, (i / 100) % 100, i / 10000);
+			glm::vec3 rotation = glm::vec3(i % 63 * 0.1f, i % 127 * -0.05f, i % 31 * 0.2f); // within a few turns, like real objects
+			glm::vec3 scale = (i & 1) ? glm::vec3(1.0f) : glm::vec3(1.0f, 2.0f, 0.5f);
+			
+			// Rx * Ry * Rz, same order as the euler path
+			glm::quat quaternion = glm::angleAxis(rotation.x, glm::vec3(1.0f, 0.0f, 0.0f)) * glm::angleAxis(rotation.y, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
+			
+			setTransformEuler(&eulers, i, position, rotation, scale);
+			setTransformQuaternion(&quaternions, i, position, glm::vec4(quaternion.x, quaternion.y, quaternion.z, quaternion.w), scale);
+		}
+		
+		std::vector<glm::mat4> modelMatrices(count);
+		std::vector<glm::mat3> normalMatrices(count);
+		std::vector<glm::mat4> referenceModels(count);
+		std::vector<glm::mat3> referenceNormals(count);
+		
+		printf(" %u objects:\n", count);
+		
+		// before: one updateTransform per object
+		double start = glfwGetTime();
+		for(u32 i = 0; i < count; i++){
+			caches[i].valid = false;
+			
+			glm::vec3 position = glm::vec3(eulers.position[0][i], eulers.position[1][i], eulers.position[2][i]);
+			glm::vec3 rotation = glm::vec3(eulers.rotation[0][i], eulers.rotation[1][i], eulers.rotation[2][i]);
+			glm::vec3 scale = glm::vec3(eulers.scale[0][i], eulers.scale[1][i], eulers.scale[2][i]);
+			
+			updateTransform(&caches[i], position, rotation, scale, &referenceModels[i], &referenceNormals[i]);
+		}
+		reportBenchmark("updateTransform per object", count, glfwGetTime() - start);
+		
+		bool matching = true;
+		
+		start = glfwGetTime();
+		batchTransformsEulerScalar(&eulers, modelMatrices.data(), normalMatrices.data());
+		reportBenchmark("batch euler (scalar)", count, glfwGetTime() - start);
+		matching &= compareTransforms("batch euler (scalar)", count, modelMatrices.data(), normalMatrices.data(), referenceModels.data(), referenceNormals.data());
+		
+		start = glfwGetTime();
+		batchTransformsEuler(&eulers, modelMatrices.data(), normalMatrices.data());
+		reportBenchmark("batch euler", count, glfwGetTime() - start);
+		matching &= compareTransforms("batch euler", count, modelMatrices.data(), normalMatrices.data(), referenceModels.data(), referenceNormals.data());
+		
+		start = glfwGetTime();
+		batchTransformsQuaternionScalar(&quaternions, modelMatrices.data(), normalMatrices.data());
+		reportBenchmark("batch quaternion (scalar)", count, glfwGetTime() - start);
+		matching &= compareTransforms("batch quaternion (scalar)", count, modelMatrices.data(), normalMatrices.data(), referenceModels.data(), referenceNormals.data());
+		
+		start = glfwGetTime();
+		batchTransformsQuaternion(&quaternions, modelMatrices.data(), normalMatrices.data());
+		reportBenchmark("batch quaternion", count, glfwGetTime() - start);
+		matching &= compareTransforms("batch quaternion", count, modelMatrices.data(), normalMatrices.data(), referenceModels.data(), referenceNormals.data());
+		
+		if(matching)
+			printf("  every batch kernel matches updateTransform (within %g)\n", TRANSFORM_TOLERANCE);
+		
+		freeTransformArrays(&eulers);
+		freeTransformArrays(&quaternions);
+	}
+	
+	resetTransformStats(); // don't leave the benchmark's rebuilds in the frame stats
+}
+
+// cold (assimp import, optimize, simplify, cook) vs warm (cooked file mapped and copied into the pool) loads
+// of the sample models, textures are loaded once beforehand so both only time the geometry
+void benchmarkModelLoading(){
+	const char* paths[] = {"./models/backpack/backpack.obj", "./models/nanosuit/nanosuit.obj"};
+	u32 lodCounts[] = {4, 1};
+	
+	printf("model loading benchmark:\n");
+	
+	for(u32 i = 0; i < 2; i++){
+		std::string cookedPath = std::string(paths[i]) + MODEL_COOKED_EXTENSION;
+		
+		Model model = loadModel(paths[i], lodCounts[i]);
+		freeModel(&model);
+		
+		remove(cookedPath.c_str());
+		
+		double start = glfwGetTime();
+		model = loadModel(paths[i], lodCounts[i]);
+		double cold = glfwGetTime() - start;
+		freeModel(&model);
+		
+		start = glfwGetTime();
+		model = loadModel(paths[i], lodCounts[i]);
+		double warm = glfwGetTime() - start;
+		freeModel(&model);
+		
+		printf(" %s: cold %.1f ms, warm %.1f ms (%.1fx)\n", paths[i], cold * 1000.0, warm * 1000.0, cold / warm);
+	}
+}
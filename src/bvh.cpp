@@ -0,0 +1,676 @@
+// dynamic bounding volume hierarchy, leaves are inserted next to the sibling that grows the tree's surface area least
+// and the tree is kept balanced with rotations (same approach as box2d's dynamic tree, in 3d)
+
+#include <bvh.h>
+
+#include <cstdio>
+#include <cmath>
+
+// BOXES //
+
+static float surfaceArea(glm::vec3 minimum, glm::vec3 maximum){
+	glm::vec3 size = maximum - minimum;
+	
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static float mergedArea(BVH_Node *a, BVH_Node *b){
+	return surfaceArea(glm::min(a->minimum, b->minimum), glm::max(a->maximum, b->maximum));
+}
+
+static void mergeNodeBoxes(BVH_Node *node, BVH_Node *a, BVH_Node *b){
+	node->minimum = glm::min(a->minimum, b->minimum);
+	node->maximum = glm::max(a->maximum, b->maximum);
+}
+
+static bool isLeaf(BVH_Node *node){
+	return node->children[0] == BVH_NULL;
+}
+
+// distance along the ray where it enters the box, -1 if it misses it (or only hits it beyond maxDistance)
+static float rayBox(glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance, glm::vec3 minimum, glm::vec3 maximum){
+	glm::vec3 t0 = (minimum - origin) * inverseDirection;
+	glm::vec3 t1 = (maximum - origin) * inverseDirection;
+	
+	glm::vec3 entries = glm::min(t0, t1);
+	glm::vec3 exits = glm::max(t0, t1);
+	
+	float enter = glm::max(glm::max(entries.x, entries.y), glm::max(entries.z, 0.0f));
+	float exit = glm::min(glm::min(exits.x, exits.y), glm::min(exits.z, maxDistance));
+	
+	return enter <= exit ? enter : -1.0f;
+}
+
+// NODES //
+
+void initBVH(BVH *bvh, float margin){
+	bvh->nodes.clear();
+	bvh->stack.clear();
+	bvh->root = BVH_NULL;
+	bvh->freeList = BVH_NULL;
+	bvh->margin = margin;
+	bvh->leafCount = 0;
+}
+
+static s32 allocateNode(BVH *bvh){
+	s32 index;
+	
+	if(bvh->freeList != BVH_NULL){
+		index = bvh->freeList;
+		bvh->freeList = bvh->nodes[index].parent;
+	} else {
+		index = bvh->nodes.size();
+		bvh->nodes.push_back(BVH_Node());
+	}
+	
+	BVH_Node *node = &bvh->nodes[index];
+	node->parent = BVH_NULL;
+	node->children[0] = BVH_NULL;
+	node->children[1] = BVH_NULL;
+	node->height = 0;
+	node->leaf.object = NULL;
+	node->leaf.model = NULL;
+	node->leaf.mesh = 0;
+	
+	return index;
+}
+
+static void freeNode(BVH *bvh, s32 index){
+	bvh->nodes[index].parent = bvh->freeList;
+	bvh->nodes[index].height = -1;
+	bvh->freeList = index;
+}
+
+// rotate a grandchild up if one side of index is more than one level taller than the other, returns the subtree's new root
+static s32 balanceNode(BVH *bvh, s32 indexA){
+	BVH_Node *nodes = bvh->nodes.data();
+	BVH_Node *a = &nodes[indexA];
+	
+	if(isLeaf(a) || a->height < 2)
+		return indexA;
+	
+	s32 indexB = a->children[0];
+	s32 indexC = a->children[1];
+	BVH_Node *b = &nodes[indexB];
+	BVH_Node *c = &nodes[indexC];
+	
+	s32 balance = c->height - b->height;
+	
+	// c is taller, c takes a's place and a takes one of c's children
+	if(balance > 1){
+		s32 indexF = c->children[0];
+		s32 indexG = c->children[1];
+		BVH_Node *f = &nodes[indexF];
+		BVH_Node *g = &nodes[indexG];
+		
+		c->children[0] = indexA;
+		c->parent = a->parent;
+		a->parent = indexC;
+		
+		if(c->parent != BVH_NULL){
+			BVH_Node *parent = &nodes[c->parent];
+			parent->children[parent->children[0] == indexA ? 0 : 1] = indexC;
+		} else {
+			bvh->root = indexC;
+		}
+		
+		// keep the taller of c's children next to a
+		if(f->height > g->height){
+			c->children[1] = indexF;
+			a->children[1] = indexG;
+			g->parent = indexA;
+			
+			mergeNodeBoxes(a, b, g);
+			mergeNodeBoxes(c, a, f);
+			a->height = 1 + glm::max(b->height, g->height);
+			c->height = 1 + glm::max(a->height, f->height);
+		} else {
+			c->children[1] = indexG;
+			a->children[1] = indexF;
+			f->parent = indexA;
+			
+			mergeNodeBoxes(a, b, f);
+			mergeNodeBoxes(c, a, g);
+			a->height = 1 + glm::max(b->height, f->height);
+			c->height = 1 + glm::max(a->height, g->height);
+		}
+		
+		return indexC;
+	}
+	
+	// b is taller, mirrored
+	if(balance < -1){
+		s32 indexD = b->children[0];
+		s32 indexE = b->children[1];
+		BVH_Node *d = &nodes[indexD];
+		BVH_Node *e = &nodes[indexE];
+		
+		b->children[0] = indexA;
+		b->parent = a->parent;
+		a->parent = indexB;
+		
+		if(b->parent != BVH_NULL){
+			BVH_Node *parent = &nodes[b->parent];
+			parent->children[parent->children[0] == indexA ? 0 : 1] = indexB;
+		} else {
+			bvh->root = indexB;
+		}
+		
+		if(d->height > e->height){
+			b->children[1] = indexD;
+			a->children[0] = indexE;
+			e->parent = indexA;
+			
+			mergeNodeBoxes(a, c, e);
+			mergeNodeBoxes(b, a, d);
+			a->height = 1 + glm::max(c->height, e->height);
+			b->height = 1 + glm::max(a->height, d->height);
+		} else {
+			b->children[1] = indexE;
+			a->children[0] = indexD;
+			d->parent = indexA;
+			
+			mergeNodeBoxes(a, c, d);
+			mergeNodeBoxes(b, a, e);
+			a->height = 1 + glm::max(c->height, d->height);
+			b->height = 1 + glm::max(a->height, e->height);
+		}
+		
+		return indexB;
+	}
+	
+	return indexA;
+}
+
+// fix boxes/heights from index up to the root, balancing on the way
+static void refitAncestors(BVH *bvh, s32 index){
+	while(index != BVH_NULL){
+		index = balanceNode(bvh, index);
+		
+		BVH_Node *node = &bvh->nodes[index];
+		BVH_Node *child0 = &bvh->nodes[node->children[0]];
+		BVH_Node *child1 = &bvh->nodes[node->children[1]];
+		
+		node->height = 1 + glm::max(child0->height, child1->height);
+		mergeNodeBoxes(node, child0, child1);
+		
+		index = node->parent;
+	}
+}
+
+static void insertLeaf(BVH *bvh, s32 leaf){
+	if(bvh->root == BVH_NULL){
+		bvh->root = leaf;
+		bvh->nodes[leaf].parent = BVH_NULL;
+		return;
+	}
+	
+	// walk down to the cheapest sibling: cost of a new parent there + what every ancestor grows by on the way
+	s32 index = bvh->root;
+	
+	while(!isLeaf(&bvh->nodes[index])){
+		BVH_Node *nodes = bvh->nodes.data();
+		BVH_Node *node = &nodes[index];
+		BVH_Node *leafNode = &nodes[leaf];
+		
+		float area = surfaceArea(node->minimum, node->maximum);
+		float combinedArea = mergedArea(node, leafNode);
+		
+		float cost = 2.0f * combinedArea; // sibling of this whole node
+		float inheritanceCost = 2.0f * (combinedArea - area); // every step further down grows this node anyway
+		
+		float childCost[2];
+		for(u32 i = 0; i < 2; i++){
+			BVH_Node *child = &nodes[node->children[i]];
+			
+			childCost[i] = mergedArea(child, leafNode) + inheritanceCost;
+			
+			if(!isLeaf(child))
+				childCost[i] -= surfaceArea(child->minimum, child->maximum);
+		}
+		
+		if(cost < childCost[0] && cost < childCost[1])
+			break;
+		
+		index = childCost[0] < childCost[1] ? node->children[0] : node->children[1];
+	}
+	
+	s32 sibling = index;
+	
+	// new parent for sibling + leaf
+	s32 oldParent = bvh->nodes[sibling].parent;
+	s32 newParent = allocateNode(bvh);
+	
+	BVH_Node *nodes = bvh->nodes.data();
+	
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	mergeNodeBoxes(&nodes[newParent], &nodes[sibling], &nodes[leaf]);
+	
+	if(oldParent != BVH_NULL){
+		BVH_Node *parent = &nodes[oldParent];
+		parent->children[parent->children[0] == sibling ? 0 : 1] = newParent;
+	} else {
+		bvh->root = newParent;
+	}
+	
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	
+	refitAncestors(bvh, newParent);
+}
+
+static void removeLeaf(BVH *bvh, s32 leaf){
+	if(leaf == bvh->root){
+		bvh->root = BVH_NULL;
+		return;
+	}
+	
+	BVH_Node *nodes = bvh->nodes.data();
+	
+	s32 parent = nodes[leaf].parent;
+	s32 grandParent = nodes[parent].parent;
+	s32 sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+	
+	// sibling takes the parent's place
+	if(grandParent != BVH_NULL){
+		BVH_Node *node = &nodes[grandParent];
+		node->children[node->children[0] == parent ? 0 : 1] = sibling;
+		nodes[sibling].parent = grandParent;
+		
+		freeNode(bvh, parent);
+		refitAncestors(bvh, grandParent);
+	} else {
+		bvh->root = sibling;
+		nodes[sibling].parent = BVH_NULL;
+		
+		freeNode(bvh, parent);
+	}
+}
+
+static void setFatBox(BVH *bvh, s32 proxy, Bounds bounds){
+	BVH_Node *node = &bvh->nodes[proxy];
+	
+	node->minimum = bounds.center - bounds.extents - glm::vec3(bvh->margin);
+	node->maximum = bounds.center + bounds.extents + glm::vec3(bvh->margin);
+}
+
+// add a leaf, returns its proxy
+s32 insertBVH(BVH *bvh, Bounds bounds, BVH_Leaf leaf){
+	s32 proxy = allocateNode(bvh);
+	
+	bvh->nodes[proxy].leaf = leaf;
+	setFatBox(bvh, proxy, bounds);
+	
+	insertLeaf(bvh, proxy);
+	bvh->leafCount++;
+	
+	return proxy;
+}
+
+void removeBVH(BVH *bvh, s32 proxy){
+	removeLeaf(bvh, proxy);
+	freeNode(bvh, proxy);
+	
+	bvh->leafCount--;
+}
+
+// refit a leaf to new bounds, only touches the tree if they left the leaf's fattened box (returns true then)
+bool moveBVH(BVH *bvh, s32 proxy, Bounds bounds){
+	BVH_Node *node = &bvh->nodes[proxy];
+	
+	glm::vec3 minimum = bounds.center - bounds.extents;
+	glm::vec3 maximum = bounds.center + bounds.extents;
+	
+	if(glm::all(glm::greaterThanEqual(minimum, node->minimum)) && glm::all(glm::lessThanEqual(maximum, node->maximum)))
+		return false;
+	
+	removeLeaf(bvh, proxy);
+	setFatBox(bvh, proxy, bounds);
+	insertLeaf(bvh, proxy);
+	
+	return true;
+}
+
+// OBJECTS //
+
+static Bounds objectBounds(Object_Data *object){
+	return transformBounds(object->vertexData.bounds, object->modelMatrix);
+}
+
+static Bounds modelMeshBounds(Model *model, u32 mesh){
+	return transformBounds(model->meshes[mesh].vertexData.bounds, model->nodeWorldMatrices[model->meshNodes[mesh]]);
+}
+
+void insertObjectBVH(BVH *bvh, Object_Data *object){
+	BVH_Leaf leaf;
+	leaf.object = object;
+	leaf.model = NULL;
+	leaf.mesh = 0;
+	
+	object->bvhProxy = insertBVH(bvh, objectBounds(object), leaf);
+}
+
+void updateObjectBVH(BVH *bvh, Object_Data *object){
+	moveBVH(bvh, object->bvhProxy, objectBounds(object));
+}
+
+void removeObjectBVH(BVH *bvh, Object_Data *object){
+	removeBVH(bvh, object->bvhProxy);
+	object->bvhProxy = BVH_NULL;
+}
+
+// one leaf per mesh, so queries/picking can tell which part of a model they found
+void insertModelBVH(BVH *bvh, Model *model){
+	model->meshProxies.resize(model->meshes.size());
+	
+	for(u32 i = 0; i < model->meshes.size(); i++){
+		BVH_Leaf leaf;
+		leaf.object = NULL;
+		leaf.model = model;
+		leaf.mesh = i;
+		
+		model->meshProxies[i] = insertBVH(bvh, modelMeshBounds(model, i), leaf);
+	}
+}
+
+void updateModelBVH(BVH *bvh, Model *model){
+	for(u32 i = 0; i < model->meshProxies.size(); i++)
+		moveBVH(bvh, model->meshProxies[i], modelMeshBounds(model, i));
+}
+
+void removeModelBVH(BVH *bvh, Model *model){
+	for(u32 i = 0; i < model->meshProxies.size(); i++)
+		removeBVH(bvh, model->meshProxies[i]);
+	
+	model->meshProxies.clear();
+}
+
+// QUERIES //
+
+// every leaf under index, no more tests needed
+static u32 collectLeaves(BVH *bvh, s32 index, std::vector<s32> *results){
+	BVH_Node *node = &bvh->nodes[index];
+	
+	if(isLeaf(node)){
+		results->push_back(index);
+		return 1;
+	}
+	
+	return collectLeaves(bvh, node->children[0], results) + collectLeaves(bvh, node->children[1], results);
+}
+
+// boxes completely inside the frustum take their whole subtree without testing it
+u32 queryBVHFrustum(BVH *bvh, glm::vec4 *frustumPlanes, std::vector<s32> *results){
+	if(bvh->root == BVH_NULL)
+		return 0;
+	
+	u32 found = 0;
+	
+	bvh->stack.clear();
+	bvh->stack.push_back(bvh->root);
+	
+	while(!bvh->stack.empty()){
+		s32 index = bvh->stack.back();
+		bvh->stack.pop_back();
+		
+		BVH_Node *node = &bvh->nodes[index];
+		
+		glm::vec3 center = (node->minimum + node->maximum) * 0.5f;
+		glm::vec3 extents = (node->maximum - node->minimum) * 0.5f;
+		
+		bool outside = false;
+		bool inside = true;
+		
+		for(u32 i = 0; i < 6; i++){
+			glm::vec3 normal = glm::vec3(frustumPlanes[i]);
+			
+			float distance = glm::dot(normal, center) + frustumPlanes[i].w;
+			float radius = glm::dot(glm::abs(normal), extents);
+			
+			if(distance + radius < 0.0f){
+				outside = true;
+				break;
+			}
+			
+			if(distance - radius < 0.0f)
+				inside = false;
+		}
+		
+		if(outside)
+			continue;
+		
+		if(inside || isLeaf(node)){
+			found += collectLeaves(bvh, index, results);
+			continue;
+		}
+		
+		bvh->stack.push_back(node->children[0]);
+		bvh->stack.push_back(node->children[1]);
+	}
+	
+	return found;
+}
+
+u32 queryBVHSphere(BVH *bvh, glm::vec3 center, float radius, std::vector<s32> *results){
+	if(bvh->root == BVH_NULL)
+		return 0;
+	
+	u32 found = 0;
+	float radiusSquared = radius * radius;
+	
+	bvh->stack.clear();
+	bvh->stack.push_back(bvh->root);
+	
+	while(!bvh->stack.empty()){
+		s32 index = bvh->stack.back();
+		bvh->stack.pop_back();
+		
+		BVH_Node *node = &bvh->nodes[index];
+		
+		// closest point of the box to the center
+		glm::vec3 offset = glm::clamp(center, node->minimum, node->maximum) - center;
+		
+		if(glm::dot(offset, offset) > radiusSquared)
+			continue;
+		
+		if(isLeaf(node)){
+			results->push_back(index);
+			found++;
+			continue;
+		}
+		
+		bvh->stack.push_back(node->children[0]);
+		bvh->stack.push_back(node->children[1]);
+	}
+	
+	return found;
+}
+
+u32 queryBVHBox(BVH *bvh, Bounds box, std::vector<s32> *results){
+	if(bvh->root == BVH_NULL)
+		return 0;
+	
+	u32 found = 0;
+	glm::vec3 minimum = box.center - box.extents;
+	glm::vec3 maximum = box.center + box.extents;
+	
+	bvh->stack.clear();
+	bvh->stack.push_back(bvh->root);
+	
+	while(!bvh->stack.empty()){
+		s32 index = bvh->stack.back();
+		bvh->stack.pop_back();
+		
+		BVH_Node *node = &bvh->nodes[index];
+		
+		if(glm::any(glm::lessThan(node->maximum, minimum)) || glm::any(glm::greaterThan(node->minimum, maximum)))
+			continue;
+		
+		if(isLeaf(node)){
+			results->push_back(index);
+			found++;
+			continue;
+		}
+		
+		bvh->stack.push_back(node->children[0]);
+		bvh->stack.push_back(node->children[1]);
+	}
+	
+	return found;
+}
+
+// RAYCASTING //
+
+// moller-trumbore, both sides, returns the distance or -1
+static float rayTriangle(glm::vec3 origin, glm::vec3 direction, glm::vec3 a, glm::vec3 b, glm::vec3 c){
+	glm::vec3 edge1 = b - a;
+	glm::vec3 edge2 = c - a;
+	
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	
+	if(fabsf(determinant) < 1e-12f)
+		return -1.0f;
+	
+	float inverseDeterminant = 1.0f / determinant;
+	
+	glm::vec3 s = origin - a;
+	float u = glm::dot(s, p) * inverseDeterminant;
+	if(u < 0.0f || u > 1.0f)
+		return -1.0f;
+	
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverseDeterminant;
+	if(v < 0.0f || u + v > 1.0f)
+		return -1.0f;
+	
+	return glm::dot(edge2, q) * inverseDeterminant;
+}
+
+// closest triangle of a leaf closer than hit->distance, the ray is moved into the mesh's space
+// (direction isn't renormalized so distances stay the same as in world space)
+static bool raycastLeaf(BVH_Leaf *leaf, glm::vec3 origin, glm::vec3 direction, BVH_Hit *hit){
+	glm::mat4 matrix;
+	float *positions;
+	u32 stride;
+	u32 *indices;
+	u32 firstIndex, triangleCount;
+	s32 baseVertex;
+	
+	if(leaf->object){
+		Vertex_Data *vertexData = &leaf->object->vertexData;
+		
+		matrix = leaf->object->modelMatrix;
+		positions = vertexData->vertexData;
+		stride = 8;
+		indices = vertexData->usingEBO ? vertexData->indices : NULL;
+		firstIndex = vertexData->firstIndex;
+		triangleCount = (vertexData->usingEBO ? vertexData->indicesCount : vertexData->vertexCount) / 3;
+		baseVertex = vertexData->baseVertex;
+	} else {
+		Model *model = leaf->model;
+		Vertex_Data *vertexData = &model->meshes[leaf->mesh].vertexData;
+		
+		matrix = model->nodeWorldMatrices[model->meshNodes[leaf->mesh]];
+		positions = model->positions.empty() ? NULL : (float*)model->positions.data();
+		stride = 3;
+		indices = model->indices.empty() ? NULL : model->indices.data();
+		firstIndex = vertexData->firstIndex;
+		triangleCount = vertexData->indicesCount / 3;
+		baseVertex = vertexData->baseVertex;
+	}
+	
+	// nothing to refine with
+	if(!positions || (leaf->model && !indices))
+		return false;
+	
+	glm::mat4 inverse = glm::inverse(matrix);
+	glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::mat3(inverse) * direction;
+	
+	bool found = false;
+	
+	for(u32 i = 0; i < triangleCount; i++){
+		glm::vec3 corners[3];
+		
+		for(u32 j = 0; j < 3; j++){
+			u32 vertex = indices ? indices[firstIndex + i * 3 + j] + baseVertex : i * 3 + j;
+			corners[j] = glm::make_vec3(positions + vertex * stride);
+		}
+		
+		float distance = rayTriangle(localOrigin, localDirection, corners[0], corners[1], corners[2]);
+		
+		if(distance >= 0.0f && distance < hit->distance){
+			hit->distance = distance;
+			hit->triangle = i;
+			found = true;
+		}
+	}
+	
+	return found;
+}
+
+// leaves without cpu side vertices (plain insertBVH leaves, objects without vertex arrays) count as hit where the ray enters their box
+BVH_Hit raycastBVH(BVH *bvh, glm::vec3 origin, glm::vec3 direction, float maxDistance){
+	BVH_Hit hit;
+	hit.hit = false;
+	hit.distance = maxDistance;
+	hit.position = glm::vec3(0.0f);
+	hit.proxy = BVH_NULL;
+	hit.triangle = 0;
+	
+	if(bvh->root == BVH_NULL)
+		return hit;
+	
+	direction = glm::normalize(direction);
+	glm::vec3 inverseDirection = 1.0f / direction; // infinities are fine for the slab test
+	
+	bvh->stack.clear();
+	bvh->stack.push_back(bvh->root);
+	
+	while(!bvh->stack.empty()){
+		s32 index = bvh->stack.back();
+		bvh->stack.pop_back();
+		
+		BVH_Node *node = &bvh->nodes[index];
+		
+		// hit.distance shrinks as hits are found, so far away subtrees get skipped
+		float enter = rayBox(origin, inverseDirection, hit.distance, node->minimum, node->maximum);
+		if(enter < 0.0f)
+			continue;
+		
+		if(isLeaf(node)){
+			BVH_Leaf *leaf = &node->leaf;
+			bool refinable = false;
+			
+			if(leaf->object)
+				refinable = leaf->object->vertexData.vertexData != NULL;
+			else if(leaf->model)
+				refinable = !leaf->model->positions.empty();
+			
+			if(refinable){
+				if(raycastLeaf(leaf, origin, direction, &hit)){
+					hit.hit = true;
+					hit.proxy = index;
+				}
+			} else if(enter < hit.distance){
+				hit.hit = true;
+				hit.distance = enter;
+				hit.proxy = index;
+				hit.triangle = 0;
+			}
+			
+			continue;
+		}
+		
+		bvh->stack.push_back(node->children[0]);
+		bvh->stack.push_back(node->children[1]);
+	}
+	
+	hit.position = origin + direction * hit.distance;
+	
+	return hit;
+}
@@ -1,6 +1,7 @@
 // camera thing
 
 #include <camera.h>
+#include <culling.h>
 
 #include <cstdio>
 
@@ -10,6 +11,8 @@ Camera createCamera(glm::vec3 position, glm::vec3 rotation, float fov, float asp
 	
 	// projection
 	camera.projection = glm::perspective( glm::radians(fov), aspect, near, far);
+	camera.nearPlane = near;
+	camera.farPlane = far;
 	
 	// view matrices and position
 	camera.position = position;
@@ -36,4 +39,7 @@ void updateCamera(Camera *camera){
 	
 	// update the view matrix
 	camera->view = glm::lookAt(camera->position, camera->position + camera->forward, camera->up);
+	camera->viewProjection = camera->projection * camera->view;
+	
+	extractFrustumPlanes(camera->viewProjection, camera->frustumPlanes);
 }
\ No newline at end of file
@@ -0,0 +1,379 @@
+// pre-mipmapped, block compressed textures written by the cooker (loaded by createTexture/createCubemap)
+// levels are box filtered down to 1x1, blocks are fit to the bounding box of their colors (endpoints at the
+// min/max, pulled in a little, every pixel takes the closest palette entry), fast and decent rather than the best S3TC can do
+
+#include <cookedtexture.h>
+#include <fileio.h>
+#include <hash.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+
+#include <stb/stb_image.h>
+
+// size + time of every source in order, 0 if one of them doesn't exist
+u64 cookedTextureKey(const char **paths, u32 count){
+	u32 version = COOKED_TEXTURE_VERSION;
+	u64 key = hashData(&version, sizeof(version));
+	
+	for(u32 i = 0; i < count; i++){
+		u64 size, modified;
+		if(!file_info(paths[i], &size, &modified))
+			return 0;
+		
+		key = hashData(&size, sizeof(size), key);
+		key = hashData(&modified, sizeof(modified), key);
+	}
+	
+	return key;
+}
+
+// bytes of one level (partial blocks at the edges are whole blocks)
+u32 getCookedLevelSize(u32 width, u32 height, u32 compression){
+	u32 blockSize = compression == COOKED_TEXTURE_BC1 ? 8 : 16;
+	
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+u64 getCookedTextureSize(Cooked_Texture_Header *header){
+	u64 size = 0;
+	
+	for(u32 level = 0; level < header->levels; level++){
+		u32 width = header->width >> level > 0 ? header->width >> level : 1;
+		u32 height = header->height >> level > 0 ? header->height >> level : 1;
+		
+		size += getCookedLevelSize(width, height, header->compression);
+	}
+	
+	return size * header->faces;
+}
+
+// BLOCK COMPRESSION //
+
+static u16 packColor565(const u8 *color){
+	return (u16)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | (color[2] * 31 + 127) / 255);
+}
+
+// what the gpu decodes a 565 color to
+static void unpackColor565(u16 packed, s32 *color){
+	s32 r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// the 8 byte color part of a block, pixels are 4x4 rgba
+static void compressColorBlock(u8 *destination, const u8 *pixels){
+	u8 minimum[3] = {255, 255, 255};
+	u8 maximum[3] = {0, 0, 0};
+	
+	for(u32 i = 0; i < 16; i++){
+		for(u32 c = 0; c < 3; c++){
+			minimum[c] = pixels[i * 4 + c] < minimum[c] ? pixels[i * 4 + c] : minimum[c];
+			maximum[c] = pixels[i * 4 + c] > maximum[c] ? pixels[i * 4 + c] : maximum[c];
+		}
+	}
+	
+	// a 16th in from each side, so a single outlier doesn't stretch the whole palette
+	for(u32 c = 0; c < 3; c++){
+		u8 inset = (maximum[c] - minimum[c]) >> 4;
+		
+		minimum[c] += inset;
+		maximum[c] -= inset;
+	}
+	
+	u16 color0 = packColor565(maximum);
+	u16 color1 = packColor565(minimum);
+	
+	// color0 > color1 is the 4 color mode (the other order has 3 colors + transparent black)
+	if(color0 < color1){
+		u16 swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+	
+	u32 indices = 0;
+	
+	if(color0 != color1){
+		s32 palette[4][3];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		
+		for(u32 c = 0; c < 3; c++){
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		
+		for(u32 i = 0; i < 16; i++){
+			u32 best = 0;
+			s32 bestDistance = 0x7FFFFFFF;
+			
+			for(u32 j = 0; j < 4; j++){
+				s32 distance = 0;
+				
+				for(u32 c = 0; c < 3; c++){
+					s32 difference = pixels[i * 4 + c] - palette[j][c];
+					distance += difference * difference;
+				}
+				
+				if(distance < bestDistance){
+					best = j;
+					bestDistance = distance;
+				}
+			}
+			
+			indices |= best << (i * 2);
+		}
+	}
+	
+	// little endian, like the gpu reads it
+	destination[0] = color0 & 0xFF;
+	destination[1] = color0 >> 8;
+	destination[2] = color1 & 0xFF;
+	destination[3] = color1 >> 8;
+	
+	for(u32 i = 0; i < 4; i++)
+		destination[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+// the 8 byte alpha part of a BC3 block, 8 values interpolated between the block's min/max alpha
+static void compressAlphaBlock(u8 *destination, const u8 *pixels){
+	u8 minimum = 255, maximum = 0;
+	
+	for(u32 i = 0; i < 16; i++){
+		minimum = pixels[i * 4 + 3] < minimum ? pixels[i * 4 + 3] : minimum;
+		maximum = pixels[i * 4 + 3] > maximum ? pixels[i * 4 + 3] : maximum;
+	}
+	
+	// alpha0 > alpha1 is the 8 value mode
+	destination[0] = maximum;
+	destination[1] = minimum;
+	
+	u64 indices = 0;
+	
+	if(maximum != minimum){
+		s32 palette[8];
+		palette[0] = maximum;
+		palette[1] = minimum;
+		
+		for(u32 j = 1; j < 7; j++)
+			palette[j + 1] = ((7 - j) * maximum + j * minimum) / 7;
+		
+		for(u32 i = 0; i < 16; i++){
+			u32 best = 0;
+			s32 bestDistance = 256;
+			
+			for(u32 j = 0; j < 8; j++){
+				s32 distance = pixels[i * 4 + 3] - palette[j];
+				distance = distance < 0 ? -distance : distance;
+				
+				if(distance < bestDistance){
+					best = j;
+					bestDistance = distance;
+				}
+			}
+			
+			indices |= (u64)best << (i * 3);
+		}
+	}
+	
+	for(u32 i = 0; i < 6; i++)
+		destination[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+void compressBlockBC1(u8 *destination, const u8 *pixels){
+	compressColorBlock(destination, pixels);
+}
+
+void compressBlockBC3(u8 *destination, const u8 *pixels){
+	compressAlphaBlock(destination, pixels);
+	compressColorBlock(destination + 8, pixels);
+}
+
+// COOKING //
+
+// levels from width x height down to 1x1
+static u32 levelCount(u32 width, u32 height){
+	u32 size = width > height ? width : height;
+	u32 levels = 1;
+	
+	while(size > 1){
+		size >>= 1;
+		levels++;
+	}
+	
+	return levels;
+}
+
+// half the size (at least 1) with a 2x2 box filter, rgba
+static void downsampleLevel(u8 *destination, const u8 *source, u32 width, u32 height){
+	u32 newWidth = width > 1 ? width / 2 : 1;
+	u32 newHeight = height > 1 ? height / 2 : 1;
+	
+	for(u32 y = 0; y < newHeight; y++){
+		u32 y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		
+		for(u32 x = 0; x < newWidth; x++){
+			u32 x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			
+			for(u32 c = 0; c < 4; c++){
+				u32 sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] + source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+				destination[(y * newWidth + x) * 4 + c] = (sum + 2) / 4;
+			}
+		}
+	}
+}
+
+// append one level's blocks to file (blocks hanging over the edge repeat the last row/column)
+static void compressLevel(std::vector<u8> *file, const u8 *pixels, u32 width, u32 height, u32 compression){
+	u32 blockSize = compression == COOKED_TEXTURE_BC1 ? 8 : 16;
+	u8 block[16 * 4];
+	
+	for(u32 blockY = 0; blockY < (height + 3) / 4; blockY++){
+		for(u32 blockX = 0; blockX < (width + 3) / 4; blockX++){
+			for(u32 y = 0; y < 4; y++){
+				u32 pixelY = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+				
+				for(u32 x = 0; x < 4; x++){
+					u32 pixelX = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+					memcpy(block + (y * 4 + x) * 4, pixels + (pixelY * width + pixelX) * 4, 4);
+				}
+			}
+			
+			u64 offset = file->size();
+			file->resize(offset + blockSize);
+			
+			if(compression == COOKED_TEXTURE_BC1)
+				compressBlockBC1(file->data() + offset, block);
+			else
+				compressBlockBC3(file->data() + offset, block);
+		}
+	}
+}
+
+// append every level of an rgba image to file
+static void compressLevels(std::vector<u8> *file, const u8 *pixels, u32 width, u32 height, u32 levels, u32 compression){
+	std::vector<u8> level(pixels, pixels + width * height * 4);
+	std::vector<u8> next;
+	
+	for(u32 i = 0; i < levels; i++){
+		compressLevel(file, level.data(), width, height, compression);
+		
+		if(i + 1 == levels)
+			break;
+		
+		next.resize((width > 1 ? width / 2 : 1) * (height > 1 ? height / 2 : 1) * 4);
+		downsampleLevel(next.data(), level.data(), width, height);
+		level.swap(next);
+		
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+}
+
+// write path + TEXTURE_COOKED_EXTENSION (flipped like createTexture does), images with alpha become BC3, the rest BC1
+// (safe to call from several threads at once)
+bool cookTexture(const char *path){
+	u64 key = cookedTextureKey(&path, 1);
+	
+	s32 width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(true);
+	u8 *pixels = key ? stbi_load(path, &width, &height, &channels, 4) : NULL;
+	
+	if(!pixels){
+		printf("couldn't cook texture %s: %s\n", path, key ? stbi_failure_reason() : "not found");
+		return false;
+	}
+	
+	Cooked_Texture_Header header;
+	header.magic = COOKED_TEXTURE_MAGIC;
+	header.version = COOKED_TEXTURE_VERSION;
+	header.key = key;
+	header.width = width;
+	header.height = height;
+	header.channels = channels;
+	header.compression = channels == 2 || channels == 4 ? COOKED_TEXTURE_BC3 : COOKED_TEXTURE_BC1;
+	header.faces = 1;
+	header.levels = levelCount(width, height);
+	
+	std::vector<u8> file(sizeof(header));
+	compressLevels(&file, pixels, width, height, header.levels, header.compression);
+	memcpy(file.data(), &header, sizeof(header));
+	
+	stbi_image_free(pixels);
+	
+	std::string cookedPath = std::string(path) + TEXTURE_COOKED_EXTENSION;
+	bool written = write_binary_file(cookedPath.c_str(), file.data(), file.size());
+	
+	if(written)
+		printf("cooked %s (%d x %d %s, %u levels, %.1f KB)\n", cookedPath.c_str(), width, height, header.compression == COOKED_TEXTURE_BC1 ? "BC1" : "BC3", header.levels, file.size() / 1024.0f);
+	else
+		printf("couldn't write cooked texture %s\n", cookedPath.c_str());
+	
+	return written;
+}
+
+// write the 6 faces (+x, -x, +y, -y, +z, -z, all the same size and not flipped, like createCubemap) to cookedPath
+bool cookCubemap(const char **paths, const char *cookedPath){
+	u64 key = cookedTextureKey(paths, 6);
+	
+	u8 *faces[6] = {NULL, NULL, NULL, NULL, NULL, NULL};
+	s32 width = 0, height = 0;
+	bool alpha = false;
+	bool loaded = key != 0;
+	
+	stbi_set_flip_vertically_on_load_thread(false);
+	
+	for(u32 i = 0; i < 6 && loaded; i++){
+		s32 faceWidth, faceHeight, channels;
+		faces[i] = stbi_load(paths[i], &faceWidth, &faceHeight, &channels, 4);
+		
+		if(i == 0){
+			width = faceWidth;
+			height = faceHeight;
+		}
+		
+		loaded = faces[i] && faceWidth == width && faceHeight == height;
+		alpha = alpha || channels == 2 || channels == 4;
+	}
+	
+	bool written = false;
+	
+	if(loaded){
+		Cooked_Texture_Header header;
+		header.magic = COOKED_TEXTURE_MAGIC;
+		header.version = COOKED_TEXTURE_VERSION;
+		header.key = key;
+		header.width = width;
+		header.height = height;
+		header.channels = alpha ? 4 : 3;
+		header.compression = alpha ? COOKED_TEXTURE_BC3 : COOKED_TEXTURE_BC1;
+		header.faces = 6;
+		header.levels = levelCount(width, height);
+		
+		std::vector<u8> file(sizeof(header));
+		for(u32 i = 0; i < 6; i++)
+			compressLevels(&file, faces[i], width, height, header.levels, header.compression);
+		
+		memcpy(file.data(), &header, sizeof(header));
+		
+		written = write_binary_file(cookedPath, file.data(), file.size());
+		
+		if(written)
+			printf("cooked %s (6 x %d x %d %s, %u levels, %.1f KB)\n", cookedPath, width, height, header.compression == COOKED_TEXTURE_BC1 ? "BC1" : "BC3", header.levels, file.size() / 1024.0f);
+		else
+			printf("couldn't write cooked cubemap %s\n", cookedPath);
+	} else {
+		printf("couldn't cook cubemap %s (missing faces or they aren't the same size)\n", cookedPath);
+	}
+	
+	for(u32 i = 0; i < 6; i++){
+		if(faces[i])
+			stbi_image_free(faces[i]);
+	}
+	
+	return written;
+}
@@ -0,0 +1,92 @@
+// frustum culling
+
+#include <culling.h>
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// rows of the matrix added/subtracted (gribb & hartmann), clip space is -w..w on every axis in gl
+void extractFrustumPlanes(glm::mat4 viewProjection, glm::vec4 *planes){
+	glm::vec4 row[4];
+	for(u32 i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	
+	planes[0] = row[3] + row[0]; // left
+	planes[1] = row[3] - row[0]; // right
+	planes[2] = row[3] + row[1]; // bottom
+	planes[3] = row[3] - row[1]; // top
+	planes[4] = row[3] + row[2]; // near
+	planes[5] = row[3] - row[2]; // far
+	
+	// normalized so w is an actual distance
+	for(u32 i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// a box is outside a plane when even its corner furthest along the normal is behind it:
+// dot(normal, center) + w + dot(abs(normal), extents) < 0
+static bool boxVisible(glm::vec4 *planes, glm::vec3 center, glm::vec3 extents){
+	for(u32 i = 0; i < 6; i++){
+		glm::vec3 normal = glm::vec3(planes[i]);
+		
+		if(glm::dot(normal, center) + planes[i].w + glm::dot(glm::abs(normal), extents) < 0.0f)
+			return false;
+	}
+	
+	return true;
+}
+
+u32 cullBoxes(glm::vec4 *planes, float *centers[3], float *extents[3], u32 count, u8 *visible){
+	u32 visibleCount = 0;
+	u32 i = 0;
+	
+#ifdef CULLING_SSE
+	__m128 zero = _mm_setzero_ps();
+	
+	for(; i + 4 <= count; i += 4){
+		__m128 centerX = _mm_loadu_ps(centers[0] + i);
+		__m128 centerY = _mm_loadu_ps(centers[1] + i);
+		__m128 centerZ = _mm_loadu_ps(centers[2] + i);
+		__m128 extentX = _mm_loadu_ps(extents[0] + i);
+		__m128 extentY = _mm_loadu_ps(extents[1] + i);
+		__m128 extentZ = _mm_loadu_ps(extents[2] + i);
+		
+		__m128 outside = zero;
+		
+		for(u32 p = 0; p < 6; p++){
+			__m128 distance = _mm_set1_ps(planes[p].w);
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerX, _mm_set1_ps(planes[p].x)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(planes[p].y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(planes[p].z)));
+			
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentX, _mm_set1_ps(fabsf(planes[p].x))));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentY, _mm_set1_ps(fabsf(planes[p].y))));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentZ, _mm_set1_ps(fabsf(planes[p].z))));
+			
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+		}
+		
+		int outsideMask = _mm_movemask_ps(outside);
+		
+		for(u32 j = 0; j < 4; j++){
+			visible[i + j] = !(outsideMask & (1 << j));
+			visibleCount += visible[i + j];
+		}
+	}
+#endif
+	
+	// leftovers (or everything without sse)
+	for(; i < count; i++){
+		glm::vec3 center = glm::vec3(centers[0][i], centers[1][i], centers[2][i]);
+		glm::vec3 extent = glm::vec3(extents[0][i], extents[1][i], extents[2][i]);
+		
+		visible[i] = boxVisible(planes, center, extent);
+		visibleCount += visible[i];
+	}
+	
+	return visibleCount;
+}
@@ -0,0 +1,82 @@
+// loads extension entry points by hand, glad only knows about 3.3 core
+
+#include <extensions.h>
+
+#include <cstdio>
+
+GLExtensions glExtensions;
+
+PFN_GETPROGRAMBINARY extGetProgramBinary;
+PFN_PROGRAMBINARY extProgramBinary;
+PFN_PROGRAMPARAMETERI extProgramParameteri;
+
+PFN_MAXSHADERCOMPILERTHREADS extMaxShaderCompilerThreads;
+
+PFN_MULTIDRAWELEMENTSINDIRECT extMultiDrawElementsIndirect;
+
+PFN_BUFFERSTORAGE extBufferStorage;
+
+// true if the context version is at least major.minor
+static bool versionAtLeast(s32 major, s32 minor){
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// check for and load everything (needs a current context)
+void loadExtensions(){
+	// program binaries
+	glExtensions.programBinary = false;
+	
+	if(versionAtLeast(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary")){
+		extGetProgramBinary = (PFN_GETPROGRAMBINARY)glfwGetProcAddress("glGetProgramBinary");
+		extProgramBinary = (PFN_PROGRAMBINARY)glfwGetProcAddress("glProgramBinary");
+		extProgramParameteri = (PFN_PROGRAMPARAMETERI)glfwGetProcAddress("glProgramParameteri");
+		
+		// drivers are allowed to support the extension with zero formats, which makes it useless
+		s32 formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		
+		glExtensions.programBinary = extGetProgramBinary && extProgramBinary && extProgramParameteri && formats > 0;
+	}
+	
+	// parallel shader compile (KHR and ARB versions are the same thing under different names)
+	glExtensions.parallelShaderCompile = false;
+	
+	if(glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+		extMaxShaderCompilerThreads = (PFN_MAXSHADERCOMPILERTHREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if(glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+		extMaxShaderCompilerThreads = (PFN_MAXSHADERCOMPILERTHREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	else
+		extMaxShaderCompilerThreads = NULL;
+	
+	if(extMaxShaderCompilerThreads){
+		extMaxShaderCompilerThreads(0xFFFFFFFF); // let the driver pick how many threads
+		glExtensions.parallelShaderCompile = true;
+	}
+	
+	// multi draw indirect (needs indirect buffers from draw_indirect too)
+	glExtensions.multiDrawIndirect = false;
+	
+	if(versionAtLeast(4, 3) || (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && (versionAtLeast(4, 0) || glfwExtensionSupported("GL_ARB_draw_indirect")))){
+		extMultiDrawElementsIndirect = (PFN_MULTIDRAWELEMENTSINDIRECT)glfwGetProcAddress("glMultiDrawElementsIndirect");
+		
+		glExtensions.multiDrawIndirect = extMultiDrawElementsIndirect != NULL;
+	}
+	
+	// base instance, only used through indirect commands so there's no entry point to load
+	glExtensions.baseInstance = versionAtLeast(4, 2) || glfwExtensionSupported("GL_ARB_base_instance");
+	
+	// immutable storage (persistent mapping)
+	glExtensions.bufferStorage = false;
+	
+	if(versionAtLeast(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage")){
+		extBufferStorage = (PFN_BUFFERSTORAGE)glfwGetProcAddress("glBufferStorage");
+		
+		glExtensions.bufferStorage = extBufferStorage != NULL;
+	}
+	
+	// S3TC compressed textures (cooked ones, see cookedtexture.h), patents kept it out of core
+	glExtensions.textureCompressionS3TC = glfwExtensionSupported("GL_EXT_texture_compression_s3tc");
+	glExtensions.textureSRGBS3TC = glExtensions.textureCompressionS3TC && (glfwExtensionSupported("GL_EXT_texture_sRGB") || glfwExtensionSupported("GL_EXT_texture_compression_s3tc_srgb"));
+	
+	printf("extensions: program binary %s, parallel shader compile %s, multi draw indirect %s, base instance %s, buffer storage %s, s3tc %s\n", glExtensions.programBinary ? "yes" : "no", glExtensions.parallelShaderCompile ? "yes" : "no", glExtensions.multiDrawIndirect ? "yes" : "no", glExtensions.baseInstance ? "yes" : "no", glExtensions.bufferStorage ? "yes" : "no", glExtensions.textureCompressionS3TC ? "yes" : "no");
+}
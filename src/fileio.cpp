@@ -4,6 +4,19 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 char* read_entire_file(char* file){
 	FILE* source_file = fopen(file, "rb");
@@ -21,3 +34,113 @@ char* read_entire_file(char* file){
 	buffer[src_size] = 0;
 	return buffer;
 }
+
+// read a whole file without null terminating it (returns NULL if it can't be opened, free when done)
+void* read_binary_file(const char* file, u64 *size){
+	FILE* source_file = fopen(file, "rb");
+	if (!source_file)
+		return 0;
+	
+	fseek(source_file, 0, SEEK_END);
+	long src_size = ftell(source_file);
+	fseek(source_file, 0, SEEK_SET);
+	
+	void* buffer = malloc(src_size > 0 ? src_size : 1);
+	*size = fread(buffer, 1, src_size, source_file);
+	fclose(source_file);
+	
+	return buffer;
+}
+
+// write (overwrite) a whole file, returns false if it couldn't be written completely
+bool write_binary_file(const char* file, const void* data, u64 size){
+	FILE* destination_file = fopen(file, "wb");
+	if (!destination_file)
+		return false;
+	
+	u64 written = fwrite(data, 1, size, destination_file);
+	fclose(destination_file);
+	
+	return written == size;
+}
+
+// create a directory, true if it exists afterwards (doesn't create parents)
+bool make_directory(const char* path){
+#ifdef _WIN32
+	return _mkdir(path) == 0 || errno == EEXIST;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// size and last modification time (seconds since the epoch) of a file, false if it doesn't exist
+bool file_info(const char* file, u64 *size, u64 *modified){
+	struct stat info;
+	if (stat(file, &info) != 0)
+		return false;
+	
+	*size = info.st_size;
+	*modified = info.st_mtime;
+	
+	return true;
+}
+
+// map a whole file read only instead of reading it, pages are only loaded when touched
+// (returns NULL if it can't be opened or is empty, unmap_file when done)
+void* map_file(const char* file, u64 *size){
+#ifdef _WIN32
+	HANDLE file_handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE)
+		return 0;
+	
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0){
+		CloseHandle(file_handle);
+		return 0;
+	}
+	
+	// the view keeps the mapping (and the file) alive, the handles aren't needed after this
+	HANDLE mapping = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file_handle);
+	
+	if (!mapping)
+		return 0;
+	
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	
+	if (!data)
+		return 0;
+	
+	*size = file_size.QuadPart;
+	return data;
+#else
+	int descriptor = open(file, O_RDONLY);
+	if (descriptor < 0)
+		return 0;
+	
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || info.st_size <= 0){
+		close(descriptor);
+		return 0;
+	}
+	
+	// the mapping keeps the file alive, the descriptor isn't needed after this
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	
+	if (data == MAP_FAILED)
+		return 0;
+	
+	*size = info.st_size;
+	return data;
+#endif
+}
+
+void unmap_file(void* data, u64 size){
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
@@ -0,0 +1,199 @@
+// gl state cache, skips binds that wouldn't change anything
+// everything that binds programs, vertex arrays, framebuffers or textures should go through here, otherwise the cache goes stale
+
+#include <glstate.h>
+
+#include <cstdio>
+#include <cstring>
+
+#define STATE_UNKNOWN 0xFFFFFFFF // forces the next call to be issued
+
+// last values sent to opengl
+struct StateCache {
+	u32 program;
+	u32 vertexArray;
+	u32 framebuffer;
+	
+	u32 activeTexture; // unit index, not GL_TEXTUREi
+	u32 textures2D[STATE_TEXTURE_UNITS];
+	u32 texturesCube[STATE_TEXTURE_UNITS];
+	
+	u32 cullFaceEnabled;
+	u32 blendEnabled;
+	
+	u32 cullFace;
+	u32 blendSource;
+	u32 blendDestination;
+};
+
+static StateCache cache;
+static StateStats stats;
+
+static const char* counterNames[STATE_COUNTER_COUNT] = {
+	"program",
+	"vertex array",
+	"framebuffer",
+	"active texture",
+	"texture",
+	"enable/disable",
+	"cull face",
+	"blend func"
+};
+
+// returns true (and counts it) if value differs from cached, updating the cache
+static bool stateChanged(u32 *cached, u32 value, StateCounter counter){
+	if(*cached == value){
+		stats.elided[counter]++;
+		return false;
+	}
+	
+	*cached = value;
+	stats.issued[counter]++;
+	
+	return true;
+}
+
+// forget everything, needed after a new context is made or after gl calls that bypass the cache
+void stateInvalidate(){
+	memset(&cache, 0xFF, sizeof(cache)); // STATE_UNKNOWN everywhere
+}
+
+void stateUseProgram(u32 program){
+	if(stateChanged(&cache.program, program, STATE_PROGRAM))
+		glUseProgram(program);
+}
+
+void stateBindVertexArray(u32 vertexArray){
+	if(stateChanged(&cache.vertexArray, vertexArray, STATE_VERTEX_ARRAY))
+		glBindVertexArray(vertexArray);
+}
+
+// gl falls back to 0 when the bound one is deleted, the cache has to as well or a recycled name never gets bound
+void stateDeleteVertexArray(u32 vertexArray){
+	glDeleteVertexArrays(1, &vertexArray);
+	
+	if(cache.vertexArray == vertexArray)
+		cache.vertexArray = 0;
+}
+
+// binds both draw and read framebuffers, same as glBindFramebuffer(GL_FRAMEBUFFER, ...)
+void stateBindFramebuffer(u32 framebuffer){
+	if(stateChanged(&cache.framebuffer, framebuffer, STATE_FRAMEBUFFER))
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void stateActiveTexture(u32 unit){
+	if(stateChanged(&cache.activeTexture, unit, STATE_ACTIVE_TEXTURE))
+		glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+// bind texture to the currently active unit
+void stateBindTexture(GLenum target, u32 texture){
+	u32 unit = cache.activeTexture;
+	
+	u32 *cached = NULL;
+	if(unit < STATE_TEXTURE_UNITS){
+		if(target == GL_TEXTURE_2D)
+			cached = &cache.textures2D[unit];
+		else if(target == GL_TEXTURE_CUBE_MAP)
+			cached = &cache.texturesCube[unit];
+	}
+	
+	// untracked unit/target, always bind
+	if(!cached){
+		stats.issued[STATE_TEXTURE]++;
+		glBindTexture(target, texture);
+		return;
+	}
+	
+	if(stateChanged(cached, texture, STATE_TEXTURE))
+		glBindTexture(target, texture);
+}
+
+// bind texture to a specific unit (only switches active unit if the bind actually happens)
+void stateBindTexture(u32 unit, GLenum target, u32 texture){
+	if(unit < STATE_TEXTURE_UNITS){
+		u32 cached = STATE_UNKNOWN;
+		
+		if(target == GL_TEXTURE_2D)
+			cached = cache.textures2D[unit];
+		else if(target == GL_TEXTURE_CUBE_MAP)
+			cached = cache.texturesCube[unit];
+		
+		if(cached == texture){
+			stats.elided[STATE_TEXTURE]++;
+			return;
+		}
+	}
+	
+	stateActiveTexture(unit);
+	stateBindTexture(target, texture);
+}
+
+// returns the cache slot for a tracked capability (or NULL)
+static u32 *capabilitySlot(GLenum capability){
+	if(capability == GL_CULL_FACE)
+		return &cache.cullFaceEnabled;
+	if(capability == GL_BLEND)
+		return &cache.blendEnabled;
+	
+	return NULL;
+}
+
+void stateEnable(GLenum capability){
+	u32 *slot = capabilitySlot(capability);
+	
+	if(!slot || stateChanged(slot, 1, STATE_CAPABILITY))
+		glEnable(capability);
+}
+
+void stateDisable(GLenum capability){
+	u32 *slot = capabilitySlot(capability);
+	
+	if(!slot || stateChanged(slot, 0, STATE_CAPABILITY))
+		glDisable(capability);
+}
+
+void stateCullFace(GLenum mode){
+	if(stateChanged(&cache.cullFace, mode, STATE_CULL_FACE))
+		glCullFace(mode);
+}
+
+void stateBlendFunc(GLenum source, GLenum destination){
+	bool changed = cache.blendSource != source || cache.blendDestination != destination;
+	
+	if(!changed){
+		stats.elided[STATE_BLEND_FUNC]++;
+		return;
+	}
+	
+	cache.blendSource = source;
+	cache.blendDestination = destination;
+	stats.issued[STATE_BLEND_FUNC]++;
+	
+	glBlendFunc(source, destination);
+}
+
+// STATS //
+
+StateStats *stateGetStats(){
+	return &stats;
+}
+
+void stateResetStats(){
+	memset(&stats, 0, sizeof(stats));
+}
+
+void statePrintStats(){
+	u32 totalIssued = 0;
+	u32 totalElided = 0;
+	
+	printf("gl state calls (issued / elided):\n");
+	for(u32 i = 0; i < STATE_COUNTER_COUNT; i++){
+		printf("  %-16s %6u / %6u\n", counterNames[i], stats.issued[i], stats.elided[i]);
+		
+		totalIssued += stats.issued[i];
+		totalElided += stats.elided[i];
+	}
+	printf("  %-16s %6u / %6u\n", "total", totalIssued, totalElided);
+}
@@ -1,9 +1,16 @@
 // main graphics functions
 
 #include <graphics.h>
+#include <glstate.h>
+#include <meshpool.h>
+#include <extensions.h>
+#include <cookedtexture.h>
+#include <fileio.h>
 
 #include <cstdio>
 #include <cstring>
+#include <cstddef>
+#include <atomic>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,127 +19,534 @@
 
 // VERTEX_DATA STUFF //
 
-// create vertex data
-Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize){
-	Vertex_Data data;
+// byte layout of a format (positionOffset/positionScale are filled in by packVertices)
+Vertex_Format createVertexFormat(u32 position, u32 uv, u32 normal){
+	Vertex_Format format;
+	format.position = position;
+	format.uv = uv;
+	format.normal = normal;
+	format.positionOffset = glm::vec3(0.0f);
+	format.positionScale = glm::vec3(1.0f);
+	
+	// 16 bit positions are padded to 4 components so every attribute stays 4 byte aligned
+	u32 positionSize = position == VERTEX_POSITION_FLOAT ? 3 * sizeof(float) : 4 * sizeof(u16);
+	u32 uvSize = uv == VERTEX_UV_FLOAT ? 2 * sizeof(float) : 2 * sizeof(u16);
+	u32 normalSize = normal == VERTEX_NORMAL_FLOAT ? 3 * sizeof(float) : sizeof(u32);
+	
+	format.uvOffset = positionSize;
+	format.normalOffset = positionSize + uvSize;
+	format.stride = positionSize + uvSize + normalSize;
+	
+	return format;
+}
+
+// octahedral mapping, the unit sphere folded onto the [-1, 1] square
+static glm::vec2 encodeOctahedral(glm::vec3 normal){
+	normal /= glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
 	
-	// no EBO
-	data.usingEBO = false;
+	glm::vec2 encoded = glm::vec2(normal.x, normal.y);
 	
-	// assign data
-	data.vertexData = vertexData;
-	data.vertexCount = vertexCount;
+	if(normal.z < 0.0f){
+		encoded.x = (1.0f - glm::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - glm::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+	}
 	
-	// generate VAO
-	glGenVertexArrays(1, &data.VAO);
+	return encoded;
+}
+
+static u32 packSnorm10(float value){
+	return (u32)(s32)roundf(glm::clamp(value, -1.0f, 1.0f) * 511.0f) & 0x3FF;
+}
+
+static u16 packSnorm16(float value){
+	return (u16)(s16)roundf(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static u16 packUnorm16(float value){
+	return (u16)roundf(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+// float to half float, rounded to nearest even (too big becomes infinity, too small becomes a denormal or 0)
+static u16 packHalf(float value){
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	
+	u32 sign = (bits >> 16) & 0x8000;
+	u32 magnitude = bits & 0x7FFFFFFF;
+	
+	// nan stays nan (quiet), infinity stays infinity
+	if(magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	
+	// 65520 and up round to infinity
+	if(magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+	
+	// below the smallest normal half (2^-14), denormal: shift the mantissa (with its implicit 1) into place
+	if(magnitude < 0x38800000){
+		u32 exponent = magnitude >> 23;
+		if(exponent < 102) // under half of the smallest denormal
+			return sign;
+		
+		u32 mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+		u32 shift = 126 - exponent;
+		u32 half = mantissa >> shift;
+		u32 rest = mantissa & ((1 << shift) - 1);
+		u32 halfway = 1 << (shift - 1);
+		
+		if(rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		
+		return sign | half;
+	}
 	
-	// generate VBO
-	glGenBuffers(1, &data.VBO);
+	// normal: rebias the exponent, round the 13 bits that fall off (a carry into the exponent is still correct)
+	u32 half = (magnitude - 0x38000000) >> 13;
+	u32 rest = magnitude & 0x1FFF;
 	
-	// assign vertex data to vbo
-	glBindBuffer(GL_ARRAY_BUFFER, data.VBO);
-	glBufferData(GL_ARRAY_BUFFER, dataSize, data.vertexData, GL_STATIC_DRAW);
+	if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	
+	return sign | half;
+}
+
+// convert vertices (8 floats: position, uv, normal) to format, positions are quantized relative to their bounds
+// returns the bytes written (vertexCount * format->stride)
+u32 packVertices(void *destination, float *vertexData, u32 vertexCount, Vertex_Format *format){
+	glm::vec3 minimum = glm::vec3(0.0f), maximum = glm::vec3(0.0f);
+	
+	for(u32 i = 0; i < vertexCount; i++){
+		glm::vec3 position = glm::make_vec3(vertexData + i * 8);
+		
+		minimum = i == 0 ? position : glm::min(minimum, position);
+		maximum = i == 0 ? position : glm::max(maximum, position);
+	}
+	
+	glm::vec3 size = maximum - minimum;
+	
+	switch(format->position){
+		case VERTEX_POSITION_HALF:
+			format->positionOffset = (minimum + maximum) * 0.5f;
+			format->positionScale = glm::vec3(1.0f);
+			break;
+		case VERTEX_POSITION_UNORM16:
+			format->positionOffset = minimum;
+			format->positionScale = size;
+			break;
+		default:
+			format->positionOffset = glm::vec3(0.0f);
+			format->positionScale = glm::vec3(1.0f);
+			break;
+	}
 	
-	// apply vertex attributes
-	glBindVertexArray(data.VAO);
+	u8 *bytes = (u8*)destination;
 	
+	for(u32 i = 0; i < vertexCount; i++){
+		float *source = vertexData + i * 8;
+		u8 *vertex = bytes + i * format->stride;
+		
+		glm::vec3 position = glm::make_vec3(source);
+		glm::vec2 uv = glm::make_vec2(source + 3);
+		glm::vec3 normal = glm::make_vec3(source + 5);
+		
+		if(format->position == VERTEX_POSITION_FLOAT){
+			memcpy(vertex, &position, 3 * sizeof(float));
+		} else {
+			u16 packed[4] = {0, 0, 0, 0};
+			
+			for(u32 j = 0; j < 3; j++){
+				if(format->position == VERTEX_POSITION_HALF)
+					packed[j] = packHalf(position[j] - format->positionOffset[j]);
+				else
+					packed[j] = size[j] > 0.0f ? packUnorm16((position[j] - minimum[j]) / size[j]) : 0;
+			}
+			
+			memcpy(vertex, packed, sizeof(packed));
+		}
+		
+		if(format->uv == VERTEX_UV_FLOAT){
+			memcpy(vertex + format->uvOffset, &uv, 2 * sizeof(float));
+		} else {
+			u16 packed[2] = {packHalf(uv.x), packHalf(uv.y)};
+			memcpy(vertex + format->uvOffset, packed, sizeof(packed));
+		}
+		
+		if(format->normal == VERTEX_NORMAL_FLOAT){
+			memcpy(vertex + format->normalOffset, &normal, 3 * sizeof(float));
+		} else {
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			
+			u32 packed;
+			
+			if(format->normal == VERTEX_NORMAL_OCT16){
+				glm::vec2 encoded = encodeOctahedral(normal);
+				packed = (u32)packSnorm16(encoded.x) | ((u32)packSnorm16(encoded.y) << 16);
+			} else {
+				packed = packSnorm10(normal.x) | (packSnorm10(normal.y) << 10) | (packSnorm10(normal.z) << 20);
+			}
+			
+			memcpy(vertex + format->normalOffset, &packed, sizeof(u32));
+		}
+	}
+	
+	return vertexCount * format->stride;
+}
+
+// point attributes 0-2 at the bound VBO (the bound VAO keeps them)
+void applyVertexFormat(Vertex_Format *format){
 	// vertex position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	if(format->position == VERTEX_POSITION_FLOAT)
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, format->stride, (void*)0);
+	else if(format->position == VERTEX_POSITION_HALF)
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, format->stride, (void*)0);
+	else
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, format->stride, (void*)0);
 	
 	// texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	if(format->uv == VERTEX_UV_FLOAT)
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, format->stride, (void*)(u64)format->uvOffset);
+	else
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, format->stride, (void*)(u64)format->uvOffset);
 	
-	// normals
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+	// normals (octahedral ones come in as (x, y, 0) and are unfolded in the shader)
+	if(format->normal == VERTEX_NORMAL_FLOAT)
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, format->stride, (void*)(u64)format->normalOffset);
+	else if(format->normal == VERTEX_NORMAL_OCT16)
+		glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, format->stride, (void*)(u64)format->normalOffset);
+	else
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, format->stride, (void*)(u64)format->normalOffset);
 	
 	// enable attributes
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glEnableVertexAttribArray(2);
+}
 
-	return data;
+// create vertex data
+Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize){
+	return createVertexData(vertexData, vertexCount, createVertexFormat(VERTEX_POSITION_FLOAT, VERTEX_UV_FLOAT, VERTEX_NORMAL_FLOAT), NULL, 0, GL_UNSIGNED_INT);
 }
 
 // overload which allows also for the specification of an EBO, which causes the Vertex_Data to be drawn using indices
 Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize, u32 *indices, u32 indicesCount, u32 indicesSize){
+	return createVertexData(vertexData, vertexCount, createVertexFormat(VERTEX_POSITION_FLOAT, VERTEX_UV_FLOAT, VERTEX_NORMAL_FLOAT), indices, indicesCount, GL_UNSIGNED_INT);
+}
+
+// same with 16 bit indices (half the index memory, for meshes with fewer than 65536 vertices)
+Vertex_Data createVertexData(float *vertexData, u32 vertexCount, u32 dataSize, u16 *indices, u32 indicesCount, u32 indicesSize){
+	return createVertexData(vertexData, vertexCount, createVertexFormat(VERTEX_POSITION_FLOAT, VERTEX_UV_FLOAT, VERTEX_NORMAL_FLOAT), indices, indicesCount, GL_UNSIGNED_SHORT);
+}
+
+// vertices (8 floats each) stored as format, indices can be NULL (drawn as arrays) or indexType (GL_UNSIGNED_INT/SHORT)
+// the data goes into the mesh pool, VBO/EBO/VAO are shared with every other mesh of the same format in its page
+Vertex_Data createVertexData(float *vertexData, u32 vertexCount, Vertex_Format format, void *indices, u32 indicesCount, GLenum indexType){
 	Vertex_Data data;
+	Bounds bounds = computeBounds(vertexData, vertexCount, 8);
 	
-	// using EBO
-	data.usingEBO = true;
+	// float vertices go in as they are
+	if(format.position == VERTEX_POSITION_FLOAT && format.uv == VERTEX_UV_FLOAT && format.normal == VERTEX_NORMAL_FLOAT){
+		data = createPackedVertexData(vertexData, vertexCount, format, indices, indicesCount, indexType, bounds);
+	} else {
+		// packing fills in the format's position decode values, the vertex data has to get those
+		std::vector<u8> packed(vertexCount * format.stride);
+		packVertices(packed.data(), vertexData, vertexCount, &format);
+		
+		data = createPackedVertexData(packed.data(), vertexCount, format, indices, indicesCount, indexType, bounds);
+	}
 	
 	// assign data
 	data.vertexData = vertexData;
+	data.indices = indexType == GL_UNSIGNED_INT ? (u32*)indices : NULL; // only u32 indices are kept
+	
+	return data;
+}
+
+// same with vertices already stored as format (positionOffset/positionScale included, see packVertices), copied into
+// the pool as they are, so they can come straight from a file mapping (there's no cpu side copy, vertexData is NULL)
+Vertex_Data createPackedVertexData(void *vertices, u32 vertexCount, Vertex_Format format, void *indices, u32 indicesCount, GLenum indexType, Bounds bounds){
+	Vertex_Data data;
+	
+	data.usingEBO = indices != NULL;
+	data.firstIndex = 0;
+	data.baseVertex = 0;
+	data.indexType = indexType;
+	data.indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+	
+	data.vertexData = NULL;
 	data.vertexCount = vertexCount;
 	
-	data.indices = indices;
-	data.indicesCount = indicesCount;
+	data.indices = NULL;
+	data.indicesCount = indices ? indicesCount : 0;
+	data.format = format;
 	
-	// generate buffers
-	glGenVertexArrays(1, &data.VAO); // generate VAO
-	glGenBuffers(1, &data.VBO); // generate VBO
-	glGenBuffers(1, &data.EBO); // generate EBO
+	data.allocation = allocateMesh(&data.format, vertices, vertexCount, indices, data.indicesCount * data.indexSize);
 	
-	// assign vertex data to vbo
-	glBindBuffer(GL_ARRAY_BUFFER, data.VBO);
-	glBufferData(GL_ARRAY_BUFFER, dataSize, data.vertexData, GL_STATIC_DRAW);
+	Mesh_Pool_Page *page = getMeshPage(data.allocation);
 	
-	// apply vertex attributes
-	glBindVertexArray(data.VAO);
+	data.VAO = page->VAO;
+	data.VBO = page->vertexBuffer;
+	data.EBO = data.usingEBO ? page->indexBuffer : 0;
 	
-	// assign indices values
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, data.indices, GL_STATIC_DRAW);
+	data.bounds = bounds;
 	
-	// vertex position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	return data;
+}
+
+// give the vertex data's buffers (or pool ranges) back, pooled copies of it (Object_Data) can't be drawn after this
+void freeVertexData(Vertex_Data *data){
+	if(data->allocation >= 0){
+		freeMesh(data->allocation);
+	} else if(data->VAO){
+		stateDeleteVertexArray(data->VAO);
+		
+		if(data->EBO)
+			glDeleteBuffers(1, &data->EBO);
+	}
 	
-	// texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	data->allocation = -1;
+	data->VAO = 0;
+	data->VBO = 0;
+	data->EBO = 0;
+}
+
+// vertex data for geometry that changes every frame, its vertices live in ring instead of a VBO of its own
+// (nothing to draw until updateDynamicVertexData), indices aren't supported
+Vertex_Data createDynamicVertexData(Ring_Buffer *ring, Vertex_Format format){
+	Vertex_Data data;
 	
-	// normals
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+	data.usingEBO = false;
+	data.firstIndex = 0;
+	data.baseVertex = 0;
+	data.indexType = GL_UNSIGNED_INT;
+	data.indexSize = sizeof(u32);
 	
-	// enable attributes
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	data.vertexData = NULL;
+	data.vertexCount = 0;
+	
+	data.indices = NULL;
+	data.indicesCount = 0;
+	data.EBO = 0;
+	data.allocation = -1;
+	
+	data.format = format;
+	data.bounds = computeBounds(NULL, 0, 8);
+	
+	// VBO is the ring's buffer (not owned), attributes are pointed at the start and draws offset with baseVertex
+	glGenVertexArrays(1, &data.VAO);
+	stateBindVertexArray(data.VAO);
+	
+	data.VBO = ring->buffer;
+	data.ringGeneration = ring->generation;
+	glBindBuffer(GL_ARRAY_BUFFER, data.VBO);
+	applyVertexFormat(&data.format);
 	
 	return data;
 }
 
+// copy this frame's vertices (8 floats each) into the ring, call after beginRingFrame and before drawing
+void updateDynamicVertexData(Vertex_Data *data, Ring_Buffer *ring, float *vertexData, u32 vertexCount){
+	Vertex_Format *format = &data->format;
+	
+	// stride aligned (in the whole buffer) so the offset is a whole number of vertices
+	u32 offset;
+	
+	if(format->position == VERTEX_POSITION_FLOAT && format->uv == VERTEX_UV_FLOAT && format->normal == VERTEX_NORMAL_FLOAT){
+		offset = pushRingBuffer(ring, vertexData, vertexCount * format->stride, format->stride);
+	} else {
+		std::vector<u8> packed(vertexCount * format->stride);
+		packVertices(packed.data(), vertexData, vertexCount, format);
+		
+		offset = pushRingBuffer(ring, packed.data(), packed.size(), format->stride);
+	}
+	
+	// the ring was recreated (grown, possibly by this push) since the attributes were set up
+	if(data->ringGeneration != ring->generation){
+		data->VBO = ring->buffer;
+		data->ringGeneration = ring->generation;
+		
+		stateBindVertexArray(data->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, data->VBO);
+		applyVertexFormat(format);
+	}
+	
+	data->vertexData = vertexData;
+	data->vertexCount = vertexCount;
+	data->baseVertex = offset / format->stride;
+	data->bounds = computeBounds(vertexData, vertexCount, 8);
+}
+
 // draw vertex data using shaderProgram assuming shader takes no matrices for transformations (generally unused)
 void drawVertexData(Vertex_Data *data, ShaderProgram *shaderProgram){
 	useShader(shaderProgram);
+	setUniformVertexFormat(shaderProgram, &data->format);
+	
+	stateBindVertexArray(data->VAO);
 	
-	glBindVertexArray(data->VAO);
+	// firstIndex/baseVertex are relative to the mesh's pool ranges
+	s32 baseVertex = data->baseVertex + getMeshBaseVertex(data->allocation);
 	
 	if(!data->usingEBO)
-		glDrawArrays(GL_TRIANGLES, 0, data->vertexCount);
+		glDrawArrays(GL_TRIANGLES, baseVertex, data->vertexCount);
 	else
-		glDrawElements(GL_TRIANGLES, data->indicesCount, GL_UNSIGNED_INT, 0);
+		glDrawElementsBaseVertex(GL_TRIANGLES, data->indicesCount, data->indexType, (void*)(getMeshIndexOffset(data->allocation) + data->firstIndex * data->indexSize), baseVertex);
+}
+
+// BOUNDS //
+
+// box around the positions (first 3 floats of every stride floats), sphere around the box's center
+Bounds computeBounds(float *vertexData, u32 vertexCount, u32 stride){
+	Bounds bounds;
+	bounds.center = glm::vec3(0.0f);
+	bounds.extents = glm::vec3(0.0f);
+	bounds.radius = 0.0f;
+	
+	if(!vertexData || vertexCount == 0)
+		return bounds;
+	
+	glm::vec3 minimum = glm::make_vec3(vertexData);
+	glm::vec3 maximum = minimum;
+	
+	for(u32 i = 1; i < vertexCount; i++){
+		glm::vec3 position = glm::make_vec3(vertexData + i * stride);
+		
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+	
+	bounds.center = (minimum + maximum) * 0.5f;
+	bounds.extents = (maximum - minimum) * 0.5f;
+	
+	// tighter than the box's half diagonal for anything that isn't a box
+	float radiusSquared = 0.0f;
+	for(u32 i = 0; i < vertexCount; i++){
+		glm::vec3 offset = glm::make_vec3(vertexData + i * stride) - bounds.center;
+		
+		radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+	}
+	
+	bounds.radius = sqrtf(radiusSquared);
+	
+	return bounds;
+}
+
+// bounds of the transformed box (box extents through the absolute matrix, sphere scaled by the largest axis scale)
+Bounds transformBounds(Bounds bounds, glm::mat4 matrix){
+	Bounds result;
+	
+	glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
 	
-	glBindVertexArray(0);
+	result.center = glm::vec3(matrix * glm::vec4(bounds.center, 1.0f));
+	result.extents = absolute * bounds.extents;
+	
+	float scale = glm::max(glm::length(glm::vec3(matrix[0])), glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	result.radius = bounds.radius * scale;
+	
+	return result;
+}
+
+// smallest box around both, and a sphere around that box's center containing both spheres
+Bounds mergeBounds(Bounds a, Bounds b){
+	Bounds result;
+	
+	glm::vec3 minimum = glm::min(a.center - a.extents, b.center - b.extents);
+	glm::vec3 maximum = glm::max(a.center + a.extents, b.center + b.extents);
+	
+	result.center = (minimum + maximum) * 0.5f;
+	result.extents = (maximum - minimum) * 0.5f;
+	result.radius = glm::max(glm::length(a.center - result.center) + a.radius, glm::length(b.center - result.center) + b.radius);
+	
+	return result;
 }
 
 // TEXTURE MANAGEMENT //
 
+// upload a cooked texture's levels to the bound texture, face i going to faceTarget + i
+// false if there's no usable one for sources (missing, stale, or no S3TC support), nothing's uploaded then
+static bool uploadCookedTexture(const char *cookedPath, const char **sources, u32 faces, GLenum faceTarget, bool sRGB, Cooked_Texture_Header *result){
+	if(!glExtensions.textureCompressionS3TC || (sRGB && !glExtensions.textureSRGBS3TC))
+		return false;
+	
+	u64 size;
+	u8 *file = (u8*)map_file(cookedPath, &size);
+	
+	if(!file)
+		return false;
+	
+	Cooked_Texture_Header *header = (Cooked_Texture_Header*)file;
+	
+	bool valid = size >= sizeof(Cooked_Texture_Header) && header->magic == COOKED_TEXTURE_MAGIC && header->version == COOKED_TEXTURE_VERSION &&
+		header->key == cookedTextureKey(sources, faces) && header->faces == faces && header->compression <= COOKED_TEXTURE_BC3 &&
+		header->levels > 0 && header->levels <= COOKED_TEXTURE_MAX_LEVELS && getCookedTextureSize(header) <= size - sizeof(Cooked_Texture_Header);
+	
+	if(!valid){
+		printf("stale cooked texture %s, loading the source\n", cookedPath);
+		unmap_file(file, size);
+		return false;
+	}
+	
+	GLenum format;
+	if(header->compression == COOKED_TEXTURE_BC1)
+		format = sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else
+		format = sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	
+	// straight from the mapping
+	u8 *data = file + sizeof(Cooked_Texture_Header);
+	
+	for(u32 face = 0; face < faces; face++){
+		for(u32 level = 0; level < header->levels; level++){
+			u32 width = header->width >> level > 0 ? header->width >> level : 1;
+			u32 height = header->height >> level > 0 ? header->height >> level : 1;
+			u32 levelSize = getCookedLevelSize(width, height, header->compression);
+			
+			glCompressedTexImage2D(faceTarget + face, level, format, width, height, 0, levelSize, data);
+			data += levelSize;
+		}
+	}
+	
+	*result = *header;
+	unmap_file(file, size);
+	
+	return true;
+}
+
 // create a texture
 Texture_Data createTexture(const char* path, bool sRGB){
 	Texture_Data textureData;
 	
 	textureData.path = std::string(path);
 	
+	// cooked version (see cookTexture), already mipmapped and compressed
+	std::string cookedPath = textureData.path + TEXTURE_COOKED_EXTENSION;
+	Cooked_Texture_Header cooked;
+	
+	glGenTextures(1, &textureData.texture);
+	stateBindTexture(GL_TEXTURE_2D, textureData.texture);
+	
+	if(uploadCookedTexture(cookedPath.c_str(), &path, 1, GL_TEXTURE_2D, sRGB, &cooked)){
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, cooked.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.levels - 1);
+		
+		stateBindTexture(GL_TEXTURE_2D, 0);
+		
+		textureData.width = cooked.width;
+		textureData.height = cooked.height;
+		textureData.channels = cooked.channels;
+		
+		return textureData;
+	}
+	
 	// load texture data
 	stbi_set_flip_vertically_on_load(true); // flip because opengl expects textures to start at end of buffer
 	
 	u8 *data = stbi_load(path, &textureData.width, &textureData.height, &textureData.channels, 0);
 	
 	if(data){
-		// create texture
-		glGenTextures(1, &textureData.texture);
-		
-		// bind texture
-		glBindTexture(GL_TEXTURE_2D, textureData.texture); // bind texture so function calls affect it
+		// texture is still bound from trying the cooked file
 		
 		// assign parameters
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
@@ -164,12 +578,12 @@ Texture_Data createTexture(const char* path, bool sRGB){
 		// generate mipmaps
 		glGenerateMipmap(GL_TEXTURE_2D);
 		
-		glBindTexture(GL_TEXTURE_2D, 0);
-		
 	} else {
 		printf("error loading texture %s\n", path);
 	}
 	
+	stateBindTexture(GL_TEXTURE_2D, 0);
+	
 	stbi_image_free(data);
 	
 	return textureData;
@@ -186,7 +600,7 @@ Texture_Data createTexture(s32 width, s32 height, GLenum format){
 	glGenTextures(1, &textureData.texture);
 	
 	// bind texture
-	glBindTexture(GL_TEXTURE_2D, textureData.texture); // bind texture so function calls affect it
+	stateBindTexture(GL_TEXTURE_2D, textureData.texture); // bind texture so function calls affect it
 	
 	// assign parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
@@ -197,7 +611,7 @@ Texture_Data createTexture(s32 width, s32 height, GLenum format){
 	// generate texture
 	glTexImage2D(GL_TEXTURE_2D, 0, format, textureData.width, textureData.height, 0, format, GL_UNSIGNED_BYTE, NULL);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	stateBindTexture(GL_TEXTURE_2D, 0);
 	
 	return textureData;
 }
@@ -206,32 +620,46 @@ u32 createCubemap(std::vector<std::string> paths){
 	u32 cubemap;
 	
 	glGenTextures(1, &cubemap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+	stateBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
 	
-	s32 width, height, channels;
-	u8 *data;
+	// every face packed into one cooked file next to them (see cookCubemap), with mipmaps
+	std::string cookedPath = paths[0].substr(0, paths[0].find_last_of('/') + 1) + CUBEMAP_COOKED_NAME;
+	const char *sources[6];
+	Cooked_Texture_Header cooked;
 	
-	stbi_set_flip_vertically_on_load(false); // flip because opengl expects textures to start at end of buffers
+	for(u32 i = 0; i < 6; i++)
+		sources[i] = i < paths.size() ? paths[i].c_str() : "";
 	
-	for(u32 i = 0; i < paths.size(); i++){
-		data = stbi_load(paths[i].c_str(), &width, &height, &channels, 0);
+	if(paths.size() == 6 && uploadCookedTexture(cookedPath.c_str(), sources, 6, GL_TEXTURE_CUBE_MAP_POSITIVE_X, false, &cooked)){
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, cooked.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, cooked.levels - 1);
+	} else {
+		s32 width, height, channels;
+		u8 *data;
 		
-		if(data){
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		} else {
-			printf("Error loading skybox: couldn't load texture data\n");
+		stbi_set_flip_vertically_on_load(false); // flip because opengl expects textures to start at end of buffers
+		
+		for(u32 i = 0; i < paths.size(); i++){
+			data = stbi_load(paths[i].c_str(), &width, &height, &channels, 0);
+			
+			if(data){
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			} else {
+				printf("Error loading skybox: couldn't load texture data\n");
+			}
+			
+			stbi_image_free(data);
 		}
 		
-		stbi_image_free(data);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	}
 	
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	stateBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	
 	return cubemap;
 }
@@ -245,7 +673,7 @@ DepthBuffer generateDepthMap(s32 width, s32 height){
 	
 	glGenTextures(1, &buffer.map);
 	
-	glBindTexture(GL_TEXTURE_2D, buffer.map);
+	stateBindTexture(GL_TEXTURE_2D, buffer.map);
 	
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -255,7 +683,7 @@ DepthBuffer generateDepthMap(s32 width, s32 height){
 	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, buffer.FBO);
+	stateBindFramebuffer(buffer.FBO);
 	
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, buffer.map, 0);
 	glDrawBuffer(GL_NONE);
@@ -280,7 +708,7 @@ DepthBuffer generateDepthMap(s32 width, s32 height){
 		}
 	}
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	stateBindFramebuffer(0);
 	
 	return buffer;
 }
@@ -292,7 +720,7 @@ DepthBuffer generateDepthCubemap(s32 width, s32 height){
 	
 	glGenTextures(1, &buffer.map);
 	
-	glBindTexture(GL_TEXTURE_CUBE_MAP, buffer.map);
+	stateBindTexture(GL_TEXTURE_CUBE_MAP, buffer.map);
 	
 	for(unsigned int i = 0; i < 6; i++)
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -304,7 +732,7 @@ DepthBuffer generateDepthCubemap(s32 width, s32 height){
 	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, buffer.FBO);
+	stateBindFramebuffer(buffer.FBO);
 	
 	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, buffer.map, 0);
 	glDrawBuffer(GL_NONE);
@@ -329,25 +757,19 @@ DepthBuffer generateDepthCubemap(s32 width, s32 height){
 		}
 	}
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	stateBindFramebuffer(0);
 	
 	return buffer;
 }
 
-void drawCubemap(u32 cubemap, Vertex_Data *cube_data, Camera *camera, ShaderProgram program){
-	glm::mat4 view = glm::mat4(glm::mat3(camera->view));
-	
-	useShader(&program);
-	
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);	
-	
-	setUniformMat4(program, "projection", camera->projection);
-	setUniformMat4(program, "view", view);
+// camera comes from the Frame block (the shader strips the translation)
+void drawCubemap(u32 cubemap, Vertex_Data *cube_data, Camera *camera, ShaderProgram *program){
+	useShader(program);
 	
-	glBindVertexArray(cube_data->VAO);
-	glDrawArrays(GL_TRIANGLES, 0, cube_data->vertexCount);
+	stateBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);	
 	
-	glBindVertexArray(0);
+	stateBindVertexArray(cube_data->VAO);
+	glDrawArrays(GL_TRIANGLES, cube_data->baseVertex + getMeshBaseVertex(cube_data->allocation), cube_data->vertexCount);
 }
 
 // create directional light shadow caster
@@ -396,7 +818,7 @@ RenderableBuffer createRenderableBuffer(s32 width, s32 height){
 	
 	// create framebuffer
 	glGenFramebuffers(1, &buffer.FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, buffer.FBO);
+	stateBindFramebuffer(buffer.FBO);
 	
 	// create/bind color buffer
 	buffer.colorBuffer = createTexture(width, height, GL_RGB);
@@ -431,7 +853,7 @@ RenderableBuffer createRenderableBuffer(s32 width, s32 height){
 		}
 	}
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	stateBindFramebuffer(0);
 	
 	return buffer;
 }
@@ -440,8 +862,13 @@ RenderableBuffer createRenderableBuffer(s32 width, s32 height){
 
 // create material
 Material createMaterial(glm::vec3 color, float shininess, float specularStrength){
+	static std::atomic<u32> nextMaterialId(0); // the cooker imports models on several threads
+	
 	Material material;
 	
+	material.id = nextMaterialId++;
+	material.transparent = false;
+	
 	material.color = color;
 	material.shininess = shininess;
 	material.specularStrength = specularStrength;
@@ -465,16 +892,37 @@ void bindTextureToMaterial(Material *material, Texture_Data *textureData, int ty
 }
 
 // TODO: change naming conventions and stuff
-void setUniformMaterial(Material *material, ShaderProgram program){
+void setUniformMaterial(Material *material, ShaderProgram *program){
 	float color[] = {material->color.x, material->color.y, material->color.z};
 	
-	setUniformFloat(program, "material.color", color, 3);
-	setUniformFloat(program, "material.shininess", &material->shininess, 1);
-	setUniformFloat(program, "material.specularStrength", &material->specularStrength, 1);
+	useShader(program); // handles are only valid once the program is finished
+	
+	UniformHandles *handles = &program->handles;
+	
+	setUniformFloat(program, handles->materialColor, color, 3);
+	setUniformFloat(program, handles->materialShininess, &material->shininess, 1);
+	setUniformFloat(program, handles->materialSpecularStrength, &material->specularStrength, 1);
+	
+	setUniformInt(program, handles->materialDiffuseCount, material->diffuseCount);
+	setUniformInt(program, handles->materialSpecularCount, material->specularCount);
+	setUniformInt(program, handles->materialEmissionCount, material->emissionCount);
+}
+
+// material uniforms + textures (samplers already point at these units, see TEXTURE_UNIT_*)
+void bindMaterial(Material *material, ShaderProgram *program){
+	setUniformMaterial(material, program);
+	
+	// bind diffuse maps
+	for(int i = 0; i < material->diffuseCount; i++)
+		stateBindTexture(TEXTURE_UNIT_DIFFUSE_MAPS + i, GL_TEXTURE_2D, material->diffuseMaps[i]);
+	
+	// bind specular maps
+	for(int i = 0; i < material->specularCount; i++)
+		stateBindTexture(TEXTURE_UNIT_SPECULAR_MAPS + i, GL_TEXTURE_2D, material->specularMaps[i]);
 	
-	setUniformInt(program, "material.diffuseCount", material->diffuseCount);
-	setUniformInt(program, "material.specularCount", material->specularCount);
-	setUniformInt(program, "material.emissionCount", material->emissionCount);
+	// bind emission maps
+	for(int i = 0; i < material->emissionCount; i++)
+		stateBindTexture(TEXTURE_UNIT_EMISSION_MAPS + i, GL_TEXTURE_2D, material->emissionMaps[i]);
 }
 
 // LIGHTS //
@@ -496,7 +944,7 @@ Light createLight(glm::vec3 position, glm::vec3 color, float ambient, float diff
 }
 
 // TODO: change naming conventions and stuff
-void setUniformLight(Light *light, ShaderProgram program){
+void setUniformLight(Light *light, ShaderProgram *program){
 	float position[] = {light->position.x, light->position.y, light->position.z};
 	float color[] = {light->color.x, light->color.y, light->color.z};
 	
@@ -522,7 +970,7 @@ DirectionalLight createDirectionalLight(glm::vec3 direction, glm::vec3 color, fl
 	return light;
 }
 
-void setUniformDirectionalLight(DirectionalLight *light, ShaderProgram program, const char* buffer){
+void setUniformDirectionalLight(DirectionalLight *light, ShaderProgram *program, const char* buffer){
 	float direction[] = {light->direction.x, light->direction.y, light->direction.z};
 	float color[] = {light->color.x, light->color.y, light->color.z};
 	
@@ -542,9 +990,6 @@ void setUniformDirectionalLight(DirectionalLight *light, ShaderProgram program,
 	
 	strcpy(location, buffer);
 	setUniformFloat(program, strcat(location, ".specular"), &light->specular, 1);
-	
-	strcpy(location, buffer);
-	setUniformInt(program, strcat(location, ".exists"), 1);
 }
 
 // point lights
@@ -566,7 +1011,7 @@ PointLight createPointLight(glm::vec3 position, float constant, float linear, fl
 	return light;
 }
 
-void setUniformPointLight(PointLight *light, ShaderProgram program, const char* buffer){
+void setUniformPointLight(PointLight *light, ShaderProgram *program, const char* buffer){
 	float position[] = {light->position.x, light->position.y, light->position.z};
 	float color[] = {light->color.x, light->color.y, light->color.z};
 	
@@ -597,9 +1042,6 @@ void setUniformPointLight(PointLight *light, ShaderProgram program, const char*
 	
 	strcpy(location, buffer);
 	setUniformFloat(program, strcat(location, ".specular"), &light->specular, 1);
-	
-	strcpy(location, buffer);
-	setUniformInt(program, strcat(location, ".exists"), 1);
 }
 
 SpotLight createSpotLight(glm::vec3 position, glm::vec3 direction, float angle, float outerAngle, float constant, float linear, float quadratic, glm::vec3 color, float ambient, float diffuse, float specular){
@@ -623,7 +1065,7 @@ SpotLight createSpotLight(glm::vec3 position, glm::vec3 direction, float angle,
 	return light;
 }
 
-void setUniformSpotLight(SpotLight *light, ShaderProgram program, const char* buffer){
+void setUniformSpotLight(SpotLight *light, ShaderProgram *program, const char* buffer){
 	float position[] = {light->position.x, light->position.y, light->position.z};
 	float direction[] = {light->direction.x, light->direction.y, light->direction.z};
 	float color[] = {light->color.x, light->color.y, light->color.z};
@@ -655,32 +1097,213 @@ void setUniformSpotLight(SpotLight *light, ShaderProgram program, const char* bu
 	setUniformFloat(program, strcat(location, ".diffuse"), &light->diffuse, 1);
 	strcpy(location, buffer);
 	setUniformFloat(program, strcat(location, ".specular"), &light->specular, 1);
+}
+
+// FRAME UNIFORMS //
+
+// per-frame camera data shared by every program through the "Frame" block (std140, glm matrices are already tightly packed columns)
+struct FrameBlock_Std140 {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::mat4 lightSpace;
+	
+	glm::vec4 cameraPos; // w unused
+};
+
+static u32 frameUBO;
+
+// create the frame buffer and bind it to its block binding (needs a context)
+void initFrameBuffer(){
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock_Std140), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	
+	glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_FRAME, frameUBO);
+}
+
+// fill the frame block from a camera (call once per frame, after updateCamera)
+void updateFrameBuffer(Camera *camera, glm::mat4 lightSpace){
+	FrameBlock_Std140 block;
+	
+	block.view = camera->view;
+	block.projection = camera->projection;
+	block.viewProjection = camera->viewProjection;
+	block.lightSpace = lightSpace;
+	block.cameraPos = glm::vec4(camera->position, 1.0f);
+	
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// OBJECT UNIFORMS //
+
+// per-draw transform ("Object" block), mat3 columns are padded to vec4 in std140
+struct ObjectBlock_Std140 {
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];
+};
+
+static Ring_Buffer *objectRing = NULL;
+static u32 objectAlignment;
+
+// per-draw transforms are pushed into ring and bound with glBindBufferRange from now on (needs a context)
+void initObjectBuffer(Ring_Buffer *ring){
+	s32 alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
 	
-	strcpy(location, buffer);
-	setUniformInt(program, strcat(location, ".exists"), 1);
+	objectRing = ring;
+	objectAlignment = alignment > 0 ? alignment : 256;
 }
 
 // SHADER LIGHT MANAGEMENT //
 
-static u16 MAX_POINT_LIGHTS = 16;
-static u16 MAX_SPOT_LIGHTS = 16;
-static u16 MAX_DIRECTIONAL_LIGHTS = 16;
+// all lights live in one std140 uniform buffer ("Lights" block) shared by every lit program
+// these mirror the structs in the shaders, member order and padding has to match std140 exactly
+
+struct PointLight_Std140 {
+	float position[3];
+	float constant;
+	
+	float color[3];
+	float linear;
+	
+	float quadratic;
+	float ambient;
+	float diffuse;
+	float specular;
+};
+
+struct SpotLight_Std140 {
+	float position[3];
+	float angle;
+	
+	float direction[3];
+	float outerAngle;
+	
+	float color[3];
+	float constant;
+	
+	float linear;
+	float quadratic;
+	float ambient;
+	float diffuse;
+	
+	float specular;
+	float padding[3];
+};
+
+struct DirectionalLight_Std140 {
+	float direction[3];
+	float ambient;
+	
+	float color[3];
+	float diffuse;
+	
+	float specular;
+	float padding[3];
+};
+
+struct LightBlock_Std140 {
+	s32 pointLightCount;
+	s32 spotLightCount;
+	s32 directionalLightCount;
+	s32 padding;
+	
+	PointLight_Std140 pointLights[MAX_POINT_LIGHTS];
+	SpotLight_Std140 spotLights[MAX_SPOT_LIGHTS];
+	DirectionalLight_Std140 directionalLights[MAX_DIRECTIONAL_LIGHTS];
+};
+
+static_assert(sizeof(PointLight_Std140) == 48, "PointLight_Std140 doesn't match std140 layout");
+static_assert(sizeof(SpotLight_Std140) == 80, "SpotLight_Std140 doesn't match std140 layout");
+static_assert(sizeof(DirectionalLight_Std140) == 48, "DirectionalLight_Std140 doesn't match std140 layout");
+
+static u32 lightUBO;
+static LightBlock_Std140 lightBlock; // cpu copy of what's in lightUBO
+
+// byte range of lightBlock that changed since the last upload
+static u32 lightDirtyStart = 0xFFFFFFFF;
+static u32 lightDirtyEnd = 0;
 
 static s32 currentPointLight = 0;
 static s32 currentSpotLight = 0;
 static s32 currentDirectionalLight = 0;
 
+// copy into the cpu block, growing the dirty range only if the bytes actually differ
+static void writeLightBlock(void *destination, const void *source, u32 size){
+	if(memcmp(destination, source, size) == 0)
+		return;
+	
+	memcpy(destination, source, size);
+	
+	u32 offset = (u32)((u8*)destination - (u8*)&lightBlock);
+	
+	if(offset < lightDirtyStart)
+		lightDirtyStart = offset;
+	if(offset + size > lightDirtyEnd)
+		lightDirtyEnd = offset + size;
+}
+
+static void copyVec3(float *destination, glm::vec3 v){
+	destination[0] = v.x;
+	destination[1] = v.y;
+	destination[2] = v.z;
+}
+
+// create the light buffer and bind it to its block binding (needs a context)
+void initLightBuffer(){
+	memset(&lightBlock, 0, sizeof(lightBlock));
+	
+	glGenBuffers(1, &lightUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(lightBlock), &lightBlock, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	
+	glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS, lightUBO);
+	
+	lightDirtyStart = 0xFFFFFFFF;
+	lightDirtyEnd = 0;
+}
+
+// upload whatever changed since last call (once per frame, after pushing lights)
+void updateLightBuffer(){
+	writeLightBlock(&lightBlock.pointLightCount, &currentPointLight, sizeof(s32));
+	writeLightBlock(&lightBlock.spotLightCount, &currentSpotLight, sizeof(s32));
+	writeLightBlock(&lightBlock.directionalLightCount, &currentDirectionalLight, sizeof(s32));
+	
+	if(lightDirtyStart >= lightDirtyEnd)
+		return;
+	
+	glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, lightDirtyStart, lightDirtyEnd - lightDirtyStart, (u8*)&lightBlock + lightDirtyStart);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	
+	lightDirtyStart = 0xFFFFFFFF;
+	lightDirtyEnd = 0;
+}
+
 // push a point light
-void pushPointLight(ShaderProgram program, PointLight *light){
+void pushPointLight(PointLight *light){
 	if(currentPointLight >= MAX_POINT_LIGHTS){
 		printf("Attempted to push PointLight when max (%d) was reached\n", MAX_POINT_LIGHTS);
 		return;
 	}
 	
-	char buffer[64];
+	PointLight_Std140 data;
 	
-	sprintf(buffer, "pointLights[%d]", currentPointLight);
-  setUniformPointLight(light, program, buffer);
+	copyVec3(data.position, light->position);
+	copyVec3(data.color, light->color);
+	data.constant = light->constant;
+	data.linear = light->linear;
+	data.quadratic = light->quadratic;
+	data.ambient = light->ambient;
+	data.diffuse = light->diffuse;
+	data.specular = light->specular;
+	
+	writeLightBlock(&lightBlock.pointLights[currentPointLight], &data, sizeof(data));
 	
 	currentPointLight++;
 }
@@ -690,16 +1313,28 @@ void resetPointLights(){
 	currentPointLight = 0;
 }
 
-void pushSpotLight(ShaderProgram program, SpotLight *light){
+void pushSpotLight(SpotLight *light){
 	if(currentSpotLight >= MAX_SPOT_LIGHTS){
 		printf("Attempted to push SpotLight when max (%d) was reached\n", MAX_SPOT_LIGHTS);
 		return;
 	}
 	
-	char buffer[64];
+	SpotLight_Std140 data;
+	memset(&data, 0, sizeof(data)); // padding gets compared too
+	
+	copyVec3(data.position, light->position);
+	copyVec3(data.direction, light->direction);
+	copyVec3(data.color, light->color);
+	data.angle = light->angle;
+	data.outerAngle = light->outerAngle;
+	data.constant = light->constant;
+	data.linear = light->linear;
+	data.quadratic = light->quadratic;
+	data.ambient = light->ambient;
+	data.diffuse = light->diffuse;
+	data.specular = light->specular;
 	
-	sprintf(buffer, "spotLights[%d]", currentSpotLight);
-  setUniformSpotLight(light, program, buffer);
+	writeLightBlock(&lightBlock.spotLights[currentSpotLight], &data, sizeof(data));
 	
 	currentSpotLight++;
 }
@@ -708,16 +1343,22 @@ void resetSpotLights(){
 	currentSpotLight = 0;
 }
 
-void pushDirectionalLight(ShaderProgram program, DirectionalLight *light){
+void pushDirectionalLight(DirectionalLight *light){
 	if(currentDirectionalLight >= MAX_DIRECTIONAL_LIGHTS){
 		printf("Attempted to push DirectionalLight when max (%d) was reached\n", MAX_DIRECTIONAL_LIGHTS);
 		return;
 	}
 	
-	char buffer[64];
+	DirectionalLight_Std140 data;
+	memset(&data, 0, sizeof(data)); // padding gets compared too
 	
-	sprintf(buffer, "directionalLights[%d]", currentDirectionalLight);
-  setUniformDirectionalLight(light, program, buffer);
+	copyVec3(data.direction, light->direction);
+	copyVec3(data.color, light->color);
+	data.ambient = light->ambient;
+	data.diffuse = light->diffuse;
+	data.specular = light->specular;
+	
+	writeLightBlock(&lightBlock.directionalLights[currentDirectionalLight], &data, sizeof(data));
 	
 	currentDirectionalLight++;
 }
@@ -726,6 +1367,80 @@ void resetDirectionalLights(){
 	currentDirectionalLight = 0;
 }
 
+// variant of a lit shader for material with the lights currently pushed
+u32 getShaderVariantKey(Material *material, u32 shadowMode){
+	return getShaderVariantKey(material, shadowMode, 0);
+}
+
+// same with extra SHADER_FEATURE_* bits that don't come from the material (instancing etc)
+u32 getShaderVariantKey(Material *material, u32 shadowMode, u32 features){
+	if(material->diffuseCount > 0)
+		features |= SHADER_FEATURE_DIFFUSE_MAP;
+	if(material->specularCount > 0)
+		features |= SHADER_FEATURE_SPECULAR_MAP;
+	if(material->emissionCount > 0)
+		features |= SHADER_FEATURE_EMISSION_MAP;
+	
+	return makeShaderVariantKey(currentPointLight, currentSpotLight, currentDirectionalLight, features, shadowMode);
+}
+
+// TRANSFORMS //
+
+static TransformStats transformStats;
+
+// build model = translate * rotateX * rotateY * rotateZ * scale (same as chaining glm::translate/rotate/scale)
+// and its normal matrix, but only if position/rotation/scale differ from what cache last saw, returns true if it rebuilt
+// the normal matrix is transpose(inverse(R * S)) = R * S^-1 since R is orthogonal, so no general inverse is ever needed,
+// and with uniform scale it's just R (the shaders normalize normals anyway)
+bool updateTransform(Transform_Cache *cache, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix){
+	if(cache->valid && cache->position == position && cache->rotation == rotation && cache->scale == scale){
+		transformStats.unchanged++;
+		return false;
+	}
+	
+	cache->position = position;
+	cache->rotation = rotation;
+	cache->scale = scale;
+	cache->valid = true;
+	
+	transformStats.rebuilt++;
+	
+	float sx = sin(rotation.x), cx = cos(rotation.x);
+	float sy = sin(rotation.y), cy = cos(rotation.y);
+	float sz = sin(rotation.z), cz = cos(rotation.z);
+	
+	// rotation columns (Rx * Ry * Rz)
+	glm::vec3 right = glm::vec3(cy*cz, sx*sy*cz + cx*sz, -cx*sy*cz + sx*sz);
+	glm::vec3 up = glm::vec3(-cy*sz, -sx*sy*sz + cx*cz, cx*sy*sz + sx*cz);
+	glm::vec3 forward = glm::vec3(sy, -sx*cy, cx*cy);
+	
+	glm::mat4 *m = modelMatrix;
+	(*m)[0] = glm::vec4(right * scale.x, 0.0f);
+	(*m)[1] = glm::vec4(up * scale.y, 0.0f);
+	(*m)[2] = glm::vec4(forward * scale.z, 0.0f);
+	(*m)[3] = glm::vec4(position, 1.0f);
+	
+	bool uniformScale = scale.x == scale.y && scale.y == scale.z;
+	
+	if(uniformScale || scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f){
+		float flip = scale.x < 0.0f ? -1.0f : 1.0f; // mirrored, normals point the other way
+		*normalMatrix = glm::mat3(right * flip, up * flip, forward * flip);
+	} else {
+		*normalMatrix = glm::mat3(right / scale.x, up / scale.y, forward / scale.z);
+	}
+	
+	return true;
+}
+
+TransformStats *getTransformStats(){
+	return &transformStats;
+}
+
+void resetTransformStats(){
+	transformStats.rebuilt = 0;
+	transformStats.unchanged = 0;
+}
+
 // 3D OBJECTS //
 
 // create a 3d object
@@ -742,84 +1457,227 @@ Object_Data createObjectData(Vertex_Data *vertexData, glm::vec3 position, glm::v
 	
 	// create model matrix (stays as an identity matrix until updated)
 	object.modelMatrix = glm::mat4(1.0f);
+	object.normalMatrix = glm::mat3(1.0f);
+	object.transformCache.valid = false;
 	
 	object.material = *material;
+	object.bvhProxy = -1;
 	
 	return object;
 }
 
-// updates Object_Data model matrix according to position and rotation (for efficiency, only call if the position/rotation of Object changes)
+// updates Object_Data model matrix according to position and rotation (does nothing if they haven't changed since the last call)
 void updateObjectData(Object_Data *object){
-	// TODO: probably a more efficient way to do this than creating a new matrix each time
-	
-	// revert to identity matrix
-	object->modelMatrix = glm::mat4(1.0f);
+	updateTransform(&object->transformCache, object->position, object->rotation, object->scale, &object->modelMatrix, &object->normalMatrix);
+}
+
+// per object matrices (program has to be in use)
+// programs with the "Object" block get a fresh range of the object ring, others the plain uniforms
+void setUniformTransform(ShaderProgram *program, glm::mat4 modelMatrix, glm::mat3 normalMatrix){
+	if(program->objectBlock && objectRing){
+		ObjectBlock_Std140 block;
+		
+		block.model = modelMatrix;
+		for(u32 i = 0; i < 3; i++)
+			block.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
 		
-	// update position
-	object->modelMatrix = glm::translate(object->modelMatrix, object->position);
+		u32 offset = pushRingBuffer(objectRing, &block, sizeof(block), objectAlignment);
+		glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_OBJECT, objectRing->buffer, offset, sizeof(block));
+		return;
+	}
+	
+	setUniformMat4(program, program->handles.model, modelMatrix);
+	setUniformMat3(program, program->handles.normalMatrix, normalMatrix);
+}
+
+// decode parameters of the vertices about to be drawn, only touches the uniforms if they differ from the last ones
+void setUniformVertexFormat(ShaderProgram *program, Vertex_Format *format){
+	UniformHandles *handles = &program->handles;
+	
+	if(program->positionOffset != format->positionOffset){
+		setUniformFloat(program, handles->positionOffset, &format->positionOffset.x, 3);
+		program->positionOffset = format->positionOffset;
+	}
 	
-	// update rotation
-	object->modelMatrix = glm::rotate(object->modelMatrix, object->rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-	object->modelMatrix = glm::rotate(object->modelMatrix, object->rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-	object->modelMatrix = glm::rotate(object->modelMatrix, object->rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
+	if(program->positionScale != format->positionScale){
+		setUniformFloat(program, handles->positionScale, &format->positionScale.x, 3);
+		program->positionScale = format->positionScale;
+	}
 	
-	object->modelMatrix = glm::scale(object->modelMatrix, object->scale);
+	if(program->normalEncoding != format->normal){
+		setUniformInt(program, handles->normalEncoding, format->normal);
+		program->normalEncoding = format->normal;
+	}
 }
 
 // draw object from the perspective of camera with shaderProgram
-// assumes shader program has a uniform for projection, view, and model matrices
+// view/projection come from the Frame block (updateFrameBuffer), only the model matrix is per object
 void drawObjectData(Object_Data *object, Camera *camera, ShaderProgram *program){
 	// assign matrices to shader
 	useShader(program);
 	
-	setUniformMat4(*program, "projection", camera->projection);
-	setUniformMat4(*program, "view", camera->view);
-	setUniformMat4(*program, "model", object->modelMatrix);
+	setUniformTransform(program, object->modelMatrix, object->normalMatrix);
 	
-	setUniformMat3(*program, "normalMatrix", glm::mat3(glm::transpose(glm::inverse(object->modelMatrix))) );
+	bindMaterial(&object->material, program);
 	
-	float color[] = {object->material.color.x, object->material.color.y, object->material.color.z};
+	drawVertexData(&object->vertexData, program);
+}
+
+// draw object with the variant of permutations that matches its material and the current lights
+void drawObjectData(Object_Data *object, Camera *camera, ShaderPermutations *permutations){
+	ShaderProgram *program = getShaderVariant(permutations, getShaderVariantKey(&object->material, permutations->shadowMode));
 	
-	setUniformMaterial(&object->material, *program);
+	drawObjectData(object, camera, program);
+}
+
+// INSTANCING //
+
+// point the per-instance attributes (one per matrix column) at instanceVBO, starting from instance first
+// (VAO has to be bound, first > 0 stands in for a base instance where there isn't one)
+static void applyInstanceAttributes(u32 instanceVBO, u32 first){
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
 	
-	char locationBuffer[64];
-	int currentTexture = 0;
+	u64 base = first * sizeof(Instance_Transform);
 	
-	// bind textures
-	for(int i = 0; i < object->material.diffuseCount || 0; i++){
-		glActiveTexture(GL_TEXTURE0 + currentTexture);
-		glBindTexture(GL_TEXTURE_2D, object->material.diffuseMaps[i]);
+	for(u32 i = 0; i < 4; i++){
+		u32 attribute = INSTANCE_ATTRIBUTE_MODEL + i;
 		
-		strcpy(locationBuffer, "");
-		sprintf(locationBuffer, "material.diffuseMaps[%d]", i);
-		setUniformInt(*program, locationBuffer, currentTexture);
-		
-		currentTexture++;
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance_Transform), (void*)(base + offsetof(Instance_Transform, modelMatrix) + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+		glEnableVertexAttribArray(attribute);
 	}
 	
-	// bind specular maps
-	for(int i = 0; i < object->material.specularCount; i++){
-		glActiveTexture(GL_TEXTURE0 + currentTexture);
-		glBindTexture(GL_TEXTURE_2D, object->material.specularMaps[i]);
+	for(u32 i = 0; i < 3; i++){
+		u32 attribute = INSTANCE_ATTRIBUTE_NORMAL + i;
 		
-		strcpy(locationBuffer, "");
-		sprintf(locationBuffer, "material.specularMaps[%d]", i);
-		setUniformInt(*program, locationBuffer, currentTexture);
-		
-		currentTexture++;
+		glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, sizeof(Instance_Transform), (void*)(base + offsetof(Instance_Transform, normalMatrix) + i * sizeof(glm::vec3)));
+		glVertexAttribDivisor(attribute, 1);
+		glEnableVertexAttribArray(attribute);
 	}
+}
+
+// make an instanced version of vertexData, capacity is just the starting size (grows as needed)
+Instance_Data createInstanceData(Vertex_Data *vertexData, u32 capacity){
+	Instance_Data instances;
 	
-	// bind emission maps
-	for(int i = 0; i < object->material.emissionCount || 0; i++){
-		glActiveTexture(GL_TEXTURE0 + currentTexture);
-		glBindTexture(GL_TEXTURE_2D, object->material.emissionMaps[i]);
-		
-		strcpy(locationBuffer, "");
-		sprintf(locationBuffer, "material.emissionMaps[%d]", i);
-		setUniformInt(*program, locationBuffer, currentTexture);
+	instances.vertexData = *vertexData;
+	instances.capacity = capacity > 0 ? capacity : 1;
+	instances.uploadedCount = 0;
+	instances.bounds = vertexData->bounds;
+	
+	glGenVertexArrays(1, &instances.VAO);
+	glGenBuffers(1, &instances.instanceVBO);
+	
+	stateBindVertexArray(instances.VAO);
+	
+	// same mesh attributes as createVertexData, pointing at the mesh's buffers
+	glBindBuffer(GL_ARRAY_BUFFER, vertexData->VBO);
+	
+	if(vertexData->usingEBO)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexData->EBO);
+	
+	applyVertexFormat(&instances.vertexData.format);
+	
+	// per-instance matrices
+	glBindBuffer(GL_ARRAY_BUFFER, instances.instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.capacity * sizeof(Instance_Transform), NULL, GL_DYNAMIC_DRAW);
+	
+	applyInstanceAttributes(instances.instanceVBO, 0);
+	
+	instances.transforms.reserve(instances.capacity);
+	
+	return instances;
+}
+
+void freeInstanceData(Instance_Data *instances){
+	if(instances->VAO)
+		stateDeleteVertexArray(instances->VAO);
+	if(instances->instanceVBO)
+		glDeleteBuffers(1, &instances->instanceVBO);
+	
+	instances->VAO = 0;
+	instances->instanceVBO = 0;
+	instances->capacity = 0;
+	instances->uploadedCount = 0;
+	instances->transforms.clear();
+}
+
+// draws made from now on start at instance first (binds the instances' VAO)
+// for draw calls that can't take a base instance, indirect commands should use theirs instead
+void setInstanceBase(Instance_Data *instances, u32 first){
+	stateBindVertexArray(instances->VAO);
+	
+	applyInstanceAttributes(instances->instanceVBO, first);
+}
+
+// start over (nothing changes on the gpu until updateInstanceData)
+void clearInstances(Instance_Data *instances){
+	instances->transforms.clear();
+}
+
+void pushInstance(Instance_Data *instances, glm::mat4 modelMatrix){
+	Instance_Transform transform;
+	transform.modelMatrix = modelMatrix;
+	transform.normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+	
+	instances->transforms.push_back(transform);
+}
+
+// upload the pushed transforms, only call when they changed (static instances can be uploaded once)
+void updateInstanceData(Instance_Data *instances){
+	u32 count = instances->transforms.size();
+	
+	glBindBuffer(GL_ARRAY_BUFFER, instances->instanceVBO);
+	
+	while(instances->capacity < count)
+		instances->capacity *= 2;
+	
+	// orphan the old storage so the upload doesn't wait on draws still reading it
+	glBufferData(GL_ARRAY_BUFFER, instances->capacity * sizeof(Instance_Transform), NULL, GL_DYNAMIC_DRAW);
+	
+	if(count > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Instance_Transform), instances->transforms.data());
+	
+	instances->uploadedCount = count;
+	
+	// world space bounds of everything just uploaded, so the whole draw can be culled at once
+	for(u32 i = 0; i < count; i++){
+		Bounds bounds = transformBounds(instances->vertexData.bounds, instances->transforms[i].modelMatrix);
 		
-		currentTexture++;
+		instances->bounds = i == 0 ? bounds : mergeBounds(instances->bounds, bounds);
 	}
+}
+
+// draw every uploaded instance with whatever program/material is already set up
+void drawInstances(Instance_Data *instances, ShaderProgram *program){
+	if(instances->uploadedCount == 0)
+		return;
 	
-	drawVertexData(&object->vertexData, program);
+	useShader(program);
+	setUniformVertexFormat(program, &instances->vertexData.format);
+	
+	stateBindVertexArray(instances->VAO);
+	
+	Vertex_Data *data = &instances->vertexData;
+	s32 baseVertex = data->baseVertex + getMeshBaseVertex(data->allocation);
+	
+	if(!data->usingEBO)
+		glDrawArraysInstanced(GL_TRIANGLES, baseVertex, data->vertexCount, instances->uploadedCount);
+	else
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, data->indicesCount, data->indexType, (void*)(getMeshIndexOffset(data->allocation) + data->firstIndex * data->indexSize), instances->uploadedCount, baseVertex);
+}
+
+// program has to be an INSTANCED variant (matrices come from the instance buffer, not uniforms)
+void drawInstanceData(Instance_Data *instances, Material *material, ShaderProgram *program){
+	useShader(program);
+	
+	bindMaterial(material, program);
+	
+	drawInstances(instances, program);
+}
+
+void drawInstanceData(Instance_Data *instances, Material *material, ShaderPermutations *permutations){
+	ShaderProgram *program = getShaderVariant(permutations, getShaderVariantKey(material, permutations->shadowMode, SHADER_FEATURE_INSTANCED));
+	
+	drawInstanceData(instances, material, program);
 }
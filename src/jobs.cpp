@@ -0,0 +1,139 @@
+// worker threads, runJobs hands out indices to the workers and the calling thread until every one is done
+// (one batch at a time, it's meant for splitting up a single expensive step, not for queuing up work)
+
+#include <jobs.h>
+
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+static std::vector<std::thread> workers;
+static std::mutex mutex;
+static std::condition_variable wakeCondition;
+static std::condition_variable doneCondition;
+
+// current batch (only changed while no worker is active)
+static Job_Function jobFunction;
+static void *jobData;
+static u32 jobCount;
+static std::atomic<u32> nextJob;
+static std::atomic<u32> finishedJobs;
+
+static u32 generation; // bumped for every batch so sleeping workers know there's something new
+static u32 activeWorkers;
+static bool quitting;
+
+static void workOnJobs(){
+	u32 index;
+	
+	while((index = nextJob++) < jobCount){
+		jobFunction(jobData, index);
+		
+		if(++finishedJobs == jobCount){
+			std::lock_guard<std::mutex> lock(mutex);
+			doneCondition.notify_all();
+		}
+	}
+}
+
+static void workerLoop(){
+	u32 seenGeneration = 0;
+	
+	while(true){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [&]{ return quitting || generation != seenGeneration; });
+			
+			if(quitting)
+				return;
+			
+			seenGeneration = generation;
+			activeWorkers++;
+		}
+		
+		workOnJobs();
+		
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		doneCondition.notify_all();
+	}
+}
+
+// start threads workers (0 = one less than the hardware threads, the caller of runJobs works too)
+void initJobs(u32 threads){
+	if(!workers.empty())
+		return;
+	
+	if(threads == 0){
+		u32 hardwareThreads = std::thread::hardware_concurrency();
+		threads = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+	
+	quitting = false;
+	generation = 0;
+	activeWorkers = 0;
+	jobCount = 0;
+	nextJob = 0;
+	finishedJobs = 0;
+	
+	for(u32 i = 0; i < threads; i++)
+		workers.push_back(std::thread(workerLoop));
+	
+	printf("jobs: %u worker threads\n", threads);
+}
+
+void shutdownJobs(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	wakeCondition.notify_all();
+	
+	for(u32 i = 0; i < workers.size(); i++)
+		workers[i].join();
+	
+	workers.clear();
+}
+
+u32 getJobThreadCount(){
+	return workers.size();
+}
+
+// call function(data, i) for every i below count spread over the workers, returns once they've all finished
+void runJobs(Job_Function function, void *data, u32 count){
+	if(count == 0)
+		return;
+	
+	// nothing to share it with
+	if(workers.empty() || count == 1){
+		for(u32 i = 0; i < count; i++)
+			function(data, i);
+		
+		return;
+	}
+	
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		
+		// a worker that woke up late for the last batch could still be looking at it
+		doneCondition.wait(lock, []{ return activeWorkers == 0; });
+		
+		jobFunction = function;
+		jobData = data;
+		jobCount = count;
+		nextJob = 0;
+		finishedJobs = 0;
+		generation++;
+	}
+	wakeCondition.notify_all();
+	
+	workOnJobs();
+	
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [&]{ return finishedJobs == count; });
+}
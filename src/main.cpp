@@ -6,10 +6,19 @@
 #include <graphics.h>
 #include <camera.h>
 #include <model.h>
+#include <benchmark.h>
+#include <glstate.h>
+#include <renderqueue.h>
+#include <culling.h>
+#include <bvh.h>
+#include <occlusion.h>
+#include <jobs.h>
+#include <meshpool.h>
 
 #include <ctgmath>
 
 #include <cstdio>
+#include <cstring>
 
 // helpful macros
 #define EXIT_SUCCESS 0
@@ -22,9 +31,52 @@
 //#define WIDTH 1366
 //#define HEIGHT 768
 
+// run microbenchmarks after loading and exit
+//#define RUN_BENCHMARKS
+
+// print gl state calls issued/elided, render queue state changes/culling and transforms rebuilt (every 60 frames)
+//#define PRINT_STATE_STATS
+
+// draw a ~100k cube grid as instances instead of the scene cubes
+//#define INSTANCING_STRESS_TEST
+
+// render queue passes (drawn in this order)
+#define PASS_SHADOW 0
+#define PASS_MAIN 1
+
 #define WIDTHF (float)WIDTH
 #define HEIGHTF (float)HEIGHT
 
+// streaming memory per frame (per-draw transforms + dynamic vertices), grows if a frame needs more
+#define STREAM_RING_SIZE (4 * 1024 * 1024)
+
+#define FLAG_RESOLUTION 32 // quads per side of the waving flag (rebuilt every frame)
+#define FLAG_VERTEX_COUNT (FLAG_RESOLUTION * FLAG_RESOLUTION * 6)
+
+// flag in the xy plane (-0.5 to 0.5) waving along z, pinned at the left edge, 8 floats per vertex
+static void buildFlagVertices(float *vertices, float time){
+	u32 corners[6][2] = {{0, 0}, {1, 0}, {1, 1}, {1, 1}, {0, 1}, {0, 0}};
+	
+	for(u32 y = 0; y < FLAG_RESOLUTION; y++){
+		for(u32 x = 0; x < FLAG_RESOLUTION; x++){
+			for(u32 i = 0; i < 6; i++){
+				float u = (float)(x + corners[i][0]) / FLAG_RESOLUTION;
+				float v = (float)(y + corners[i][1]) / FLAG_RESOLUTION;
+				
+				float phase = u * 6.0f - time * 3.0f;
+				float z = 0.1f * u * sinf(phase);
+				float slope = 0.1f * (sinf(phase) + 6.0f * u * cosf(phase)); // dz/du
+				
+				glm::vec3 normal = glm::normalize(glm::vec3(-slope, 0.0f, 1.0f));
+				
+				float vertex[8] = {u - 0.5f, v - 0.5f, z, u, v, normal.x, normal.y, normal.z};
+				memcpy(vertices, vertex, sizeof(vertex));
+				vertices += 8;
+			}
+		}
+	}
+}
+
 int main(){
 	// init glfw and stuff
 	if( windowInit() != WINDOW_SUCCESS){
@@ -36,17 +88,22 @@ int main(){
 	windowEnableMSAA(4); // make sure to enable in opengl
 	Window mainWindow = windowCreate("OpenGL Practice", WIDTH, HEIGHT, true);
 	
+	// reuse linked programs from previous runs when the driver supports it
+	enableShaderCache("./shaders/cache");
+	
 	// start loading screen now that textures/shaders are loaded)
 	u32 loadingVs = createShader("./shaders/loading.vs", SHADER_VERTEX);
 	u32 loadingFs = createShader("./shaders/loading.fs", SHADER_FRAGMENT);
 	ShaderProgram loadingShader = createShaderProgram(loadingVs, loadingFs, "loadingShader", "loadingVs", "loadingFs");
 	Texture_Data loadingScreen = createTexture("./textures/loading.png", false);
 	Vertex_Data planeVertices = createVertexData(plane_vertices, 6, sizeof(plane_vertices));
-	glBindTexture(GL_TEXTURE_2D, loadingScreen.texture);
+	stateBindTexture(0, GL_TEXTURE_2D, loadingScreen.texture);
 	drawVertexData(&planeVertices, &loadingShader);
 	windowUpdate(&mainWindow);
 	
 	// create shaders
+	double shaderStart = glfwGetTime();
+	
 	u32 vertexShader = createShader("./shaders/vertex.glsl", SHADER_VERTEX);
 	u32 fragmentShader = createShader("./shaders/fragment.glsl", SHADER_FRAGMENT);
 	u32 untexturedVs = createShader("./shaders/untexturedvs.glsl", SHADER_VERTEX);
@@ -59,6 +116,7 @@ int main(){
 	u32 skyboxFs = createShader("./shaders/skybox.fs", SHADER_FRAGMENT);
 	u32 shadowVs = createShader("./shaders/shadowmapping.vs", SHADER_VERTEX);
 	u32 shadowFs = createShader("./shaders/shadowmapping.fs", SHADER_FRAGMENT);
+	u32 shadowInstancedVs = createShader("./shaders/shadowmapping.vs", SHADER_VERTEX, "#define INSTANCED\n");
 	u32 lightSpaceVs = createShader("./shaders/lightspace.vs", SHADER_VERTEX);
 	u32 lightSpaceGs = createShader("./shaders/lightspace.gs", SHADER_GEOMETRY);
 	u32 lightSpaceFs = createShader("./shaders/lightspace.fs", SHADER_FRAGMENT);
@@ -71,8 +129,13 @@ int main(){
 	ShaderProgram depthShader = createShaderProgram(meshRendererVs, depthVisualizerFs, "depthShader", "meshRendererVs", "depthVisualizerFs");
 	ShaderProgram skyboxShader = createShaderProgram(skyboxVs, skyboxFs, "skyboxShader", "skyboxVs", "skyboxFs");
 	ShaderProgram shadowShader = createShaderProgram(shadowVs, shadowFs, "shadowShader", "shadowVs", "shadowFs");
+	ShaderProgram shadowInstancedShader = createShaderProgram(shadowInstancedVs, shadowFs, "shadowInstancedShader", "shadowInstancedVs", "shadowFs");
 	ShaderProgram lightSpaceShader = createShaderProgram(lightSpaceVs, lightSpaceGs, lightSpaceFs, "lightSpaceShader", "lightSpaceVs", "lightSpaceGs", "lightSpaceFs");
 	
+	// mesh renderer specialized per material/light setup, variants compile the first time they're drawn
+	ShaderPermutations meshPermutations;
+	createShaderPermutations(&meshPermutations, "./shaders/meshrenderer.vs", "./shaders/meshrenderer.fs", "meshShader", SHADOW_PCF);
+	
 	// delete shaders
 	deleteShader(vertexShader);
 	deleteShader(fragmentShader);
@@ -88,10 +151,32 @@ int main(){
 	deleteShader(loadingFs);
 	deleteShader(shadowVs);
 	deleteShader(shadowFs);
+	deleteShader(shadowInstancedVs);
 	deleteShader(lightSpaceVs);
 	deleteShader(lightSpaceGs);
 	deleteShader(lightSpaceFs);
 	
+	// startup cost of shaders (compare a cold run with a cached one)
+	// compiles/links are only submitted here, the driver keeps working on them while textures and models load
+	// and each program's status is collected the first time it's used
+	ShaderCacheStats *shaderCache = getShaderCacheStats();
+	printf("shaders submitted in %.1f ms (%u programs from cache, %u linked from source)\n", (glfwGetTime() - shaderStart) * 1000.0, shaderCache->hits, shaderCache->misses);
+	
+	// per-draw transforms go through the ring ("Object" block), the cpu can be RING_BUFFER_FRAMES frames ahead of the gpu
+	Ring_Buffer streamRing;
+	initRingBuffer(&streamRing, STREAM_RING_SIZE);
+	initObjectBuffer(&streamRing);
+	
+#ifdef RUN_BENCHMARKS
+	benchmarkUniforms(&mainShader, 1000000);
+	benchmarkObjectTransforms(&mainShader, &meshShader, &streamRing, 1000000);
+	benchmarkTransforms();
+	benchmarkModelLoading();
+	
+	windowTerminate();
+	return EXIT_SUCCESS;
+#endif
+	
 	// textures
 	Texture_Data texture1 = createTexture("./textures/container.png", true);
 	Texture_Data texture1_specular = createTexture("./textures/container_specular.png", false); // ./textures/container_specular.png
@@ -109,6 +194,13 @@ int main(){
 	
 	u32 skybox = createCubemap(skybox_paths);
 	
+	// shared uniform buffers
+	initFrameBuffer();
+	initLightBuffer();
+	
+	// worker threads (occlusion rasterization)
+	initJobs(0);
+	
 	// materials
 	Material pinkMaterial = createMaterial(glm::vec3(1.0f, 0.0f, 0.5f), 64, 0.5);
 	//Material redMaterial = createMaterial(glm::vec3(1.0f, 0.0f, 0.0f), 64, 0.5);
@@ -116,6 +208,7 @@ int main(){
 	Material whiteMaterial = createMaterial(glm::vec3(1.0, 1.0, 1.0), 64, 1.0);
 	Material magentaMaterial = createMaterial(glm::vec3(0.67578125, 0.07421875, 0.4453125), 128, 1.0);
 	Material alphaTestMaterial = createMaterial(glm::vec3(1.0, 1.0, 1.0), 64, 1.0);
+	alphaTestMaterial.transparent = true;
 	Material mirrorMaterial = createMaterial(glm::vec3(1.0, 1.0, 1.0), 64, 1.0);
 	
 	// create triangle vertex data
@@ -136,8 +229,18 @@ int main(){
 	Object_Data windowPane = createObjectData(&quadVertices, glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1), &alphaTestMaterial);
 	Object_Data sceneCube = createObjectData(&quadVertices, glm::vec3(1.0f, 0.f, -1.0f), glm::vec3(0, 0, 0), glm::vec3(2.0f, 2.0f, 2.0f), &mirrorMaterial);
 	
-	Model survivalBackpack = loadModel("./models/backpack/backpack.obj", glm::vec3(-1.5, 1, -4), glm::vec3(0, 0, 0), glm::vec3(0.4f, 0.4f, 0.4f));
-	//Model sphinx = loadModel("./models/sphinx/HatshepsutSphinx.obj", glm::vec3(5, 10, 0), glm::vec3(0, 0, 0), glm::vec3(0.25f, 0.25f, 0.25f));
+	// vertices change every frame so they're streamed through the ring instead of living in their own VBO
+	std::vector<float> flagVertices(FLAG_VERTEX_COUNT * 8);
+	Vertex_Data flagData = createDynamicVertexData(&streamRing, createVertexFormat(VERTEX_POSITION_FLOAT, VERTEX_UV_FLOAT, VERTEX_NORMAL_FLOAT));
+	Object_Data flag = createObjectData(&flagData, glm::vec3(3.0f, 1.0f, -3.0f), glm::vec3(0, 0, 0), glm::vec3(2.0f, 1.5f, 1.0f), &whiteMaterial);
+	
+	// picking raycasts the backpack's triangles, so it keeps a cpu copy of its positions/indices
+	setModelCpuData(MODEL_CPU_PICKING);
+	Model survivalBackpack = loadModel("./models/backpack/backpack.obj", glm::vec3(-1.5, 1, -4), glm::vec3(0, 0, 0), glm::vec3(0.4f, 0.4f, 0.4f), 4);
+	//Model sphinx = loadModel("./models/sphinx/HatshepsutSphinx.obj", glm::vec3(5, 10, 0), glm::vec3(0, 0, 0), glm::vec3(0.25f, 0.25f, 0.25f), 5);
+	
+	// every mesh so far lives in a handful of pooled buffers
+	printMeshPoolStats();
 	
 	// lights and stuff
 	//Light light = createLight(cube3D.position, glm::vec3(1.0f, 1.0f, 1.0f), 0.1, 1.0, 0.5);
@@ -159,11 +262,11 @@ int main(){
 	glEnable(GL_DEPTH_TEST); // enable depth testing
 	glDepthFunc(GL_LEQUAL);
 	
-	glEnable(GL_CULL_FACE); // enable culling
-	glCullFace(GL_BACK);		// set to backface
+	stateEnable(GL_CULL_FACE); // enable culling
+	stateCullFace(GL_BACK);		// set to backface
 	
-	glEnable(GL_BLEND); // enable blending
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  
+	stateEnable(GL_BLEND); // enable blending
+	stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  
 	
 	glEnable(GL_MULTISAMPLE); // enable MSAA
 	
@@ -192,6 +295,31 @@ int main(){
 		glm::vec3(0.0f, -45.0f,	0.0f)
 	};
 	
+	// the cubes all share one mesh so they're drawn as instances, transforms never change so they're uploaded once
+#ifdef INSTANCING_STRESS_TEST
+	Instance_Data cubeInstances = createInstanceData(&cubeVertices, 317 * 317);
+	
+	for(int x = 0; x < 317; x++){
+		for(int z = 0; z < 317; z++){
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((x - 158) * 1.5f, -3.5f, (z - 158) * 1.5f));
+			
+			pushInstance(&cubeInstances, glm::scale(model, glm::vec3(0.5f)));
+		}
+	}
+#else
+	Instance_Data cubeInstances = createInstanceData(&cubeVertices, sizeof(cubePositions)/sizeof(glm::vec3));
+	
+	for(int i = 0; i < sizeof(cubePositions)/sizeof(glm::vec3); i++){
+		litCube.position = cubePositions[i];
+		litCube.rotation = cubeRotations[i];
+		
+		updateObjectData(&litCube);
+		pushInstance(&cubeInstances, litCube.modelMatrix);
+	}
+#endif
+	
+	updateInstanceData(&cubeInstances);
+	
 	PointLight pointLights[] = {
 		createPointLight(glm::vec3(0.0f, 2.0f, 0.0f), 1.0f, 0.045f, 0.0075f, glm::vec3(1.0f, 1.0f, 1.0f), 0.1f, 1.0f, 1.0f)
 		//createPointLight(glm::vec3(10.0f, 2.0f, 4.0f), 1.0f, 0.045f, 0.0075f, glm::vec3(1.0f, 1.0f, 1.0f), 0.1f, 1.0f, 1.0f),
@@ -199,16 +327,44 @@ int main(){
 	};
 	
 	//DirectionalLight sun = createDirectionalLight(glm::vec3(0, -1, 1), glm::vec3(1, 1, 1), 0.08, 1.0, 1.0);
-	//pushDirectionalLight(meshShader, &sun);
+	//pushDirectionalLight(&sun);
 	PointLight light = createPointLight(glm::vec3(0, 1, 0), 1.0f, 0.045f, 0.0075f, glm::vec3(1, 1, 1), 0.1f, 1, 1);
-	pushPointLight(meshShader, &light);
+	pushPointLight(&light);
 	
 	ShadowCaster shadows = createShadowCaster(&light);
 	
+	// render queue, shadow map pass then the main pass into the screen buffer
+	Render_Queue renderQueue;
+	initRenderQueue(&renderQueue);
+	setRenderPass(&renderQueue, PASS_SHADOW, shadows.depthBuffer.FBO, 0, 0, 1024, 1024, GL_DEPTH_BUFFER_BIT, GL_FRONT);
+	setRenderPass(&renderQueue, PASS_MAIN, screen.FBO, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_BACK);
+	
+	// the shadow pass draws from the light (which doesn't move), the main pass' frustum is updated every frame
+	glm::vec4 shadowFrustum[6];
+	extractFrustumPlanes(shadows.lightSpace, shadowFrustum);
+	setRenderPassFrustum(&renderQueue, PASS_SHADOW, shadowFrustum);
+	
+	// software depth buffer the big occluders (floor) are drawn into, main pass items behind them are skipped
+	Occlusion_Buffer occlusion;
+	initOcclusionBuffer(&occlusion, 256, 144);
+	setRenderPassOcclusion(&renderQueue, PASS_MAIN, &occlusion);
+	
+	// spatial index for picking (whatever is under the crosshair gets printed on left click)
+	BVH sceneBVH;
+	initBVH(&sceneBVH, 0.1f);
+	
+	updateObjectData(&windowPane);
+	insertObjectBVH(&sceneBVH, &windowPane);
+	
+	updateModel(&survivalBackpack);
+	insertModelBVH(&sceneBVH, &survivalBackpack);
+	
+	bool picking = false;
+	
 	SpotLight flashlight = createSpotLight(mainCamera.position, glm::vec3(-0.2f, -1.0f, -0.3f), glm::radians(12.0f), glm::radians(15.0f), 1.0f, 0.09f, 0.032f, glm::vec3(1.0f, 1.0f, 1.0f), 0.1, 1.0, 1.0);
 	
 	/*for(int i = 0; i < sizeof(pointLights)/sizeof(PointLight); i++){
-		pushPointLight(meshShader, &(pointLights[i]));
+		pushPointLight(&(pointLights[i]));
 	}*/
 	
 	int thing;
@@ -218,7 +374,12 @@ int main(){
 	
 	float delta = 1.0f;
 	float lastFrame = 0.0f;
+	u32 frame = 0;
 	while(!windowShouldClose(&mainWindow)){
+		stateResetStats();
+		resetTransformStats();
+		beginRingFrame(&streamRing);
+		
 		// delta
 		delta = glfwGetTime() - lastFrame;
 		lastFrame = glfwGetTime();
@@ -266,6 +427,26 @@ int main(){
 
 		// update camera
 		updateCamera(&mainCamera);
+		setRenderPassFrustum(&renderQueue, PASS_MAIN, mainCamera.frustumPlanes);
+		beginOcclusion(&occlusion, mainCamera.viewProjection);
+		
+		// pick (once per click)
+		bool mouseDown = glfwGetMouseButton(mainWindow.glfwWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+		
+		if(mouseDown && !picking){
+			BVH_Hit hit = raycastBVH(&sceneBVH, mainCamera.position, mainCamera.forward, mainCamera.farPlane);
+			
+			if(hit.hit){
+				BVH_Leaf *leaf = &sceneBVH.nodes[hit.proxy].leaf;
+				
+				if(leaf->model)
+					printf("picked mesh %u of %s (triangle %u) at %.2f\n", leaf->mesh, leaf->model->path.c_str(), hit.triangle, hit.distance);
+				else
+					printf("picked object (triangle %u) at %.2f\n", hit.triangle, hit.distance);
+			}
+		}
+		
+		picking = mouseDown;
 		
 		if (glfwGetKey(mainWindow.glfwWindow, GLFW_KEY_UP) == GLFW_PRESS)
 			orbitalCamera.position += cameraSpeed * orbitalCamera.forward;
@@ -278,11 +459,8 @@ int main(){
 		
 		updateCamera(&orbitalCamera);
 		
-		// set camera pos in uniform
-		float pos[] = {mainCamera.position.x, mainCamera.position.y, mainCamera.position.z};
-		float orbitalPos[] = {orbitalCamera.position.x, orbitalCamera.position.y, orbitalCamera.position.z};
-		
-		setUniformFloat(meshShader, "cameraPos", pos, 3);
+		// camera matrices + position for every shader this frame
+		updateFrameBuffer(&mainCamera, shadows.lightSpace);
 		
 		// rotate camera
 		float sensitivity = 0.1f;
@@ -299,17 +477,15 @@ int main(){
 		flashlight.direction = mainCamera.direction;
 		
 		resetSpotLights();
-		//pushSpotLight(meshShader, &flashlight);
+		//pushSpotLight(&flashlight);
 		
-		// rendering
+		// upload lights that changed this frame (shared by every lit shader)
+		updateLightBuffer();
 		
-		// render shadow depth map first
-		glViewport(0, 0, 1024, 1024);
-		glBindFramebuffer(GL_FRAMEBUFFER, shadows.depthBuffer.FBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		glCullFace(GL_FRONT);
+		// rendering
 		
-		setUniformMat4(shadowShader, "lightSpace", shadows.lightSpace);
+		// everything is submitted to the queue and drawn sorted by pass/program/material/mesh at the end
+		// shadow depth map first, then the scene into the screen buffer
 		
 		// draw floor
 		litCube.position = glm::vec3(0, -5, 0);
@@ -317,70 +493,45 @@ int main(){
 		litCube.scale = glm::vec3(40, 1, 40);
 		
 		updateObjectData(&litCube);
-		drawObjectData(&litCube, &mainCamera, &meshShader);
+		addOccluderBox(&occlusion, litCube.vertexData.bounds, litCube.modelMatrix);
+		submitObject(&renderQueue, PASS_SHADOW, &litCube, &shadowShader, &mainCamera);
+		submitObject(&renderQueue, PASS_MAIN, &litCube, &meshPermutations, &mainCamera);
 		
 		litCube.scale = glm::vec3(1, 1, 1);
 		
-		// first pass (shadow depth map)
-		for(int i = 0; i < sizeof(cubePositions)/sizeof(glm::vec3); i++){
-			litCube.position = cubePositions[i];
-			litCube.rotation = cubeRotations[i];
-			
-			updateObjectData(&litCube);
-			drawObjectData(&litCube, &mainCamera, &shadowShader);
-		}
+		// cubes (one instanced draw per pass)
+		submitInstances(&renderQueue, PASS_SHADOW, &cubeInstances, &litCube.material, &shadowInstancedShader, &mainCamera);
+		submitInstances(&renderQueue, PASS_MAIN, &cubeInstances, &litCube.material, &meshPermutations, &mainCamera);
 		
 		updateObjectData(&windowPane);
-		drawObjectData(&windowPane, &mainCamera, &shadowShader);
-		
-		//updateModel(&survivalBackpack);
-		//drawModel(&survivalBackpack, &mainCamera, &shadowShader);
-		
-		// assign the map to the mesh renderer
-		// TODO: bad way to do this but should work for now
-		setUniformInt(meshShader, "shadowMap", 16);
-		glActiveTexture(GL_TEXTURE16);
-		glBindTexture(GL_TEXTURE_2D, shadows.depthBuffer.map); // shadows.depthBuffer
-		setUniformMat4(meshShader, "lightSpace", shadows.lightSpace);
-		//setUniformDirectionalLight(&sun, meshShader, "shadowCaster");
-		glCullFace(GL_BACK);
-		
-		// second pass (rendering)
-		glBindFramebuffer(GL_FRAMEBUFFER, screen.FBO);
-		glViewport(0, 0, WIDTH, HEIGHT);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		
-		setUniformMaterial(&pinkMaterial, meshShader);
-		
+		updateObjectBVH(&sceneBVH, &windowPane);
+		submitObject(&renderQueue, PASS_SHADOW, &windowPane, &shadowShader, &mainCamera);
+		submitObject(&renderQueue, PASS_MAIN, &windowPane, &meshPermutations, &mainCamera);
 		
-		// draw floor
-		litCube.position = glm::vec3(0, -5, 0);
-		litCube.rotation = glm::vec3(0, 0, 0);
-		litCube.scale = glm::vec3(40, 1, 40);
-		
-		updateObjectData(&litCube);
-		drawObjectData(&litCube, &mainCamera, &meshShader);
-		
-		litCube.scale = glm::vec3(1, 1, 1);
-
-		// update objects
-		for(int i = 0; i < sizeof(cubePositions)/sizeof(glm::vec3); i++){
-			litCube.position = cubePositions[i];
-			litCube.rotation = cubeRotations[i];
-			
-			updateObjectData(&litCube);
-			drawObjectData(&litCube, &mainCamera, &meshShader);
-		}
-		
-		updateObjectData(&windowPane);
-		drawObjectData(&windowPane, &mainCamera, &meshShader);
+		buildFlagVertices(flagVertices.data(), lastFrame);
+		updateDynamicVertexData(&flag.vertexData, &streamRing, flagVertices.data(), FLAG_VERTEX_COUNT);
+		updateObjectData(&flag);
+		submitObject(&renderQueue, PASS_SHADOW, &flag, &shadowShader, &mainCamera);
+		submitObject(&renderQueue, PASS_MAIN, &flag, &meshPermutations, &mainCamera);
 		
 		//updateModel(&sphinx);
-		//drawModel(&sphinx, &mainCamera, &meshShader);
+		//selectModelLod(&sphinx, &mainCamera);
+		//submitModel(&renderQueue, PASS_MAIN, &sphinx, &meshPermutations, &mainCamera);
 		
+		// the lod is picked from the main camera, the shadow pass draws the same one
 		updateModel(&survivalBackpack);
-		drawModel(&survivalBackpack, &mainCamera, &meshShader);
+		updateModelBVH(&sceneBVH, &survivalBackpack);
+		selectModelLod(&survivalBackpack, &mainCamera);
+		submitModel(&renderQueue, PASS_SHADOW, &survivalBackpack, &shadowInstancedShader, &mainCamera);
+		submitModel(&renderQueue, PASS_MAIN, &survivalBackpack, &meshPermutations, &mainCamera);
+		
+		// assign the map to the mesh renderer ("shadowMap" samples TEXTURE_UNIT_SHADOW_MAP in every program)
+		// fine to have bound while the shadow pass writes it since the shadow shader doesn't sample anything
+		stateBindTexture(TEXTURE_UNIT_SHADOW_MAP, GL_TEXTURE_2D, shadows.depthBuffer.map); // shadows.depthBuffer
+		//setUniformDirectionalLight(&sun, &meshShader, "shadowCaster");
+		
+		rasterizeOcclusion(&occlusion);
+		drawRenderQueue(&renderQueue);
 		
 		// draw lights
 		/*for(int i = 0; i < sizeof(pointLights)/sizeof(PointLight); i++){
@@ -390,31 +541,45 @@ int main(){
 			
 			float col[] = {pointLights[i].color.x, pointLights[i].color.y, pointLights[i].color.z};
 			
-			setUniformFloat(lightSourceShader, "lightColor", col, 3);	
+			setUniformFloat(&lightSourceShader, "lightColor", col, 3);	
 			drawObjectData(&cube3D, &mainCamera, &lightSourceShader);
 		}*/
 		
 		// skybox
-		//glDisable(GL_CULL_FACE);
-		//drawCubemap(skybox, &cubeVertices, &mainCamera, skyboxShader);
-		//glEnable(GL_CULL_FACE);
+		//stateDisable(GL_CULL_FACE);
+		//drawCubemap(skybox, &cubeVertices, &mainCamera, &skyboxShader);
+		//stateEnable(GL_CULL_FACE);
 		
 		//drawObjectData(&cube3D, &mainCamera, &lightSourceShader);
 		//drawObjectData(&litCube, &mainCamera, &texturelessShader);
 		
 		// draw and do post process
-		glBindFramebuffer(GL_FRAMEBUFFER, 0); // bind default framebuffer
+		stateBindFramebuffer(0); // bind default framebuffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
-		glActiveTexture(GL_TEXTURE0);
-		setUniformInt(loadingShader, "tex", 0);
-		glBindTexture(GL_TEXTURE_2D, screen.colorBuffer.texture);
+		stateBindTexture(0, GL_TEXTURE_2D, screen.colorBuffer.texture);
 		drawVertexData(&planeVertices, &loadingShader);
 		
+		// everything this frame pushed into the ring has been drawn
+		endRingFrame(&streamRing);
+		
+#ifdef PRINT_STATE_STATS
+		if(frame % 60 == 0){
+			statePrintStats();
+			printRenderQueueStats(&renderQueue);
+			printOcclusionStats(&occlusion);
+			printRingBufferStats(&streamRing);
+			printf("transforms: %u rebuilt, %u unchanged\n", getTransformStats()->rebuilt, getTransformStats()->unchanged);
+		}
+#endif
+		frame++;
+		
 		// swap buffers, poll events
 		windowUpdate(&mainWindow);
 	}
 	
+	freeRingBuffer(&streamRing);
+	shutdownJobs();
 	windowTerminate();
 	
 	return EXIT_SUCCESS;
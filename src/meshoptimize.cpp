@@ -0,0 +1,376 @@
+// load time mesh optimization
+// welding, triangle order for the post-transform cache (forsyth) and overdraw (sander et al. clustering),
+// vertex order for fetch locality
+
+#include <meshoptimize.h>
+#include <hash.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#define FORSYTH_CACHE_SIZE 32 // lru cache the scores are modeled on (bigger than the real fifo is fine)
+#define EMPTY_SLOT 0xFFFFFFFF
+
+// WELDING //
+
+u32 weldVertices(u32 *remap, float *vertices, u32 vertexCount, u32 stride){
+	// open addressing table of first occurrences, at most half full
+	u32 tableSize = 1;
+	while(tableSize < vertexCount * 2)
+		tableSize *= 2;
+	
+	std::vector<u32> table(tableSize, EMPTY_SLOT);
+	u32 unique = 0;
+	
+	for(u32 i = 0; i < vertexCount; i++){
+		float *vertex = vertices + i * stride;
+		u32 slot = (u32)hashData(vertex, stride * sizeof(float)) & (tableSize - 1);
+		
+		while(table[slot] != EMPTY_SLOT && memcmp(vertices + table[slot] * stride, vertex, stride * sizeof(float)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+		
+		if(table[slot] == EMPTY_SLOT){
+			table[slot] = i;
+			remap[i] = unique++;
+		} else {
+			remap[i] = remap[table[slot]];
+		}
+	}
+	
+	return unique;
+}
+
+void remapVertices(float *destination, float *vertices, u32 vertexCount, u32 stride, u32 *remap){
+	for(u32 i = 0; i < vertexCount; i++)
+		memcpy(destination + remap[i] * stride, vertices + i * stride, stride * sizeof(float));
+}
+
+void remapIndices(u32 *destination, u32 *indices, u32 indexCount, u32 *remap){
+	for(u32 i = 0; i < indexCount; i++)
+		destination[i] = remap[indices[i]];
+}
+
+// VERTEX CACHE //
+
+// vertices in the cache score higher the more recently they were used (except the last triangle's, so strips
+// don't just keep going), vertices with few triangles left score higher so they're finished off and leave no holes
+static float vertexScore(s32 cachePosition, u32 remaining){
+	if(remaining == 0)
+		return -1.0f;
+	
+	float score = 0.0f;
+	
+	if(cachePosition >= 0){
+		if(cachePosition < 3)
+			score = 0.75f;
+		else
+			score = powf(1.0f - (cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+	
+	return score + 2.0f / sqrtf((float)remaining);
+}
+
+void optimizeVertexCache(u32 *destination, u32 *indices, u32 indexCount, u32 vertexCount){
+	u32 triangleCount = indexCount / 3;
+	
+	if(triangleCount == 0)
+		return;
+	
+	// triangles of every vertex, the first remaining[v] of its list are the ones not emitted yet
+	std::vector<u32> remaining(vertexCount, 0);
+	std::vector<u32> offsets(vertexCount + 1, 0);
+	std::vector<u32> adjacency(indexCount);
+	
+	for(u32 i = 0; i < indexCount; i++)
+		remaining[indices[i]]++;
+	for(u32 i = 0; i < vertexCount; i++)
+		offsets[i + 1] = offsets[i] + remaining[i];
+	
+	std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+	for(u32 i = 0; i < indexCount; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+	
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<float> triangleScores(triangleCount, 0.0f);
+	std::vector<u8> emitted(triangleCount, 0);
+	
+	for(u32 i = 0; i < vertexCount; i++)
+		vertexScores[i] = vertexScore(-1, remaining[i]);
+	
+	for(u32 i = 0; i < triangleCount; i++)
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+	
+	u32 cache[FORSYTH_CACHE_SIZE + 3];
+	u32 cacheCount = 0;
+	
+	// start with the best triangle anywhere
+	s32 best = 0;
+	for(u32 i = 1; i < triangleCount; i++){
+		if(triangleScores[i] > triangleScores[best])
+			best = i;
+	}
+	
+	u32 cursor = 0; // every triangle before this one is emitted
+	u32 written = 0;
+	
+	while(best >= 0){
+		u32 *triangle = indices + best * 3;
+		
+		destination[written++] = triangle[0];
+		destination[written++] = triangle[1];
+		destination[written++] = triangle[2];
+		emitted[best] = 1;
+		
+		// the triangle's vertices move to the front of the cache
+		u32 newCache[FORSYTH_CACHE_SIZE + 3];
+		u32 newCacheCount = 0;
+		
+		for(u32 i = 0; i < 3; i++)
+			newCache[newCacheCount++] = triangle[i];
+		
+		for(u32 i = 0; i < cacheCount; i++){
+			if(cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+				newCache[newCacheCount++] = cache[i];
+		}
+		
+		// take the triangle out of its vertices' lists
+		for(u32 i = 0; i < 3; i++){
+			u32 vertex = triangle[i];
+			u32 *list = adjacency.data() + offsets[vertex];
+			
+			for(u32 j = 0; j < remaining[vertex]; j++){
+				if(list[j] == (u32)best){
+					list[j] = list[remaining[vertex] - 1];
+					list[remaining[vertex] - 1] = best;
+					remaining[vertex]--;
+					break;
+				}
+			}
+		}
+		
+		// rescore everything that was or is in the cache (the last few fall out of it here)
+		for(u32 i = 0; i < newCacheCount; i++){
+			u32 vertex = newCache[i];
+			s32 position = i < FORSYTH_CACHE_SIZE ? i : -1;
+			
+			float score = vertexScore(position, remaining[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			
+			u32 *list = adjacency.data() + offsets[vertex];
+			for(u32 j = 0; j < remaining[vertex]; j++)
+				triangleScores[list[j]] += delta;
+		}
+		
+		cacheCount = glm::min(newCacheCount, (u32)FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(u32));
+		
+		// next is the best triangle using a cached vertex
+		best = -1;
+		float bestScore = -1.0f;
+		
+		for(u32 i = 0; i < cacheCount; i++){
+			u32 *list = adjacency.data() + offsets[cache[i]];
+			
+			for(u32 j = 0; j < remaining[cache[i]]; j++){
+				if(triangleScores[list[j]] > bestScore){
+					bestScore = triangleScores[list[j]];
+					best = list[j];
+				}
+			}
+		}
+		
+		// nothing around the cache left, carry on with the first triangle not drawn yet
+		if(best < 0){
+			while(cursor < triangleCount && emitted[cursor])
+				cursor++;
+			
+			if(cursor < triangleCount)
+				best = cursor;
+		}
+	}
+}
+
+float analyzeVertexCache(u32 *indices, u32 indexCount, u32 vertexCount, u32 cacheSize, u32 *misses){
+	// a vertex is in the fifo if fewer than cacheSize misses happened since it was last loaded
+	std::vector<u32> loadedAt(vertexCount, 0);
+	u32 count = 0;
+	
+	for(u32 i = 0; i < indexCount; i++){
+		u32 vertex = indices[i];
+		
+		if(loadedAt[vertex] == 0 || count + 1 - loadedAt[vertex] > cacheSize){
+			count++;
+			loadedAt[vertex] = count;
+		}
+	}
+	
+	if(misses)
+		*misses = count;
+	
+	return indexCount ? count / (float)(indexCount / 3) : 0.0f;
+}
+
+// OVERDRAW //
+
+struct Overdraw_Cluster {
+	u32 start; // first triangle
+	u32 count;
+	float sortKey;
+};
+
+void optimizeOverdraw(u32 *destination, u32 *indices, u32 indexCount, float *vertices, u32 vertexCount, u32 stride, float threshold){
+	u32 triangleCount = indexCount / 3;
+	
+	if(triangleCount == 0)
+		return;
+	
+	// misses of every triangle in the given order
+	std::vector<u32> loadedAt(vertexCount, 0);
+	std::vector<u8> triangleMisses(triangleCount);
+	u32 loads = 0;
+	
+	for(u32 i = 0; i < triangleCount; i++){
+		u32 misses = 0;
+		
+		for(u32 j = 0; j < 3; j++){
+			u32 vertex = indices[i * 3 + j];
+			
+			if(loadedAt[vertex] == 0 || loads + 1 - loadedAt[vertex] > VERTEX_CACHE_SIZE){
+				loads++;
+				loadedAt[vertex] = loads;
+				misses++;
+			}
+		}
+		
+		triangleMisses[i] = misses;
+	}
+	
+	// hard boundaries are where the cache starts over anyway (all 3 vertices missed), moving those clusters around costs nothing
+	// they're split further where the part so far, starting from an empty cache, is already within threshold of the cluster's ACMR
+	std::vector<Overdraw_Cluster> clusters;
+	std::vector<u32> subLoadedAt(vertexCount, 0);
+	u32 subLoads = 0;
+	
+	for(u32 start = 0; start < triangleCount;){
+		u32 end = start + 1;
+		u32 clusterMisses = triangleMisses[start];
+		
+		while(end < triangleCount && triangleMisses[end] != 3)
+			clusterMisses += triangleMisses[end++];
+		
+		float clusterACMR = clusterMisses / (float)(end - start);
+		
+		u32 subStart = start;
+		u32 subBase = subLoads; // loads before this are from earlier clusters, so not in its cache
+		
+		for(u32 i = start; i < end; i++){
+			for(u32 j = 0; j < 3; j++){
+				u32 vertex = indices[i * 3 + j];
+				
+				if(subLoadedAt[vertex] <= subBase || subLoads + 1 - subLoadedAt[vertex] > VERTEX_CACHE_SIZE){
+					subLoads++;
+					subLoadedAt[vertex] = subLoads;
+				}
+			}
+			
+			bool split = i + 1 < end && (subLoads - subBase) / (float)(i + 1 - subStart) <= clusterACMR * threshold;
+			
+			if(split || i + 1 == end){
+				Overdraw_Cluster cluster;
+				cluster.start = subStart;
+				cluster.count = i + 1 - subStart;
+				cluster.sortKey = 0.0f;
+				
+				clusters.push_back(cluster);
+				
+				subStart = i + 1;
+				subBase = subLoads;
+			}
+		}
+		
+		start = end;
+	}
+	
+	// clusters facing away from the mesh center (area weighted) are likely in front of the rest, draw those first
+	glm::vec3 meshCenter = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	
+	std::vector<glm::vec3> clusterCenters(clusters.size());
+	std::vector<glm::vec3> clusterNormals(clusters.size());
+	
+	for(u32 i = 0; i < clusters.size(); i++){
+		glm::vec3 center = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float clusterArea = 0.0f;
+		
+		for(u32 j = clusters[i].start; j < clusters[i].start + clusters[i].count; j++){
+			glm::vec3 a = glm::vec3(vertices[indices[j * 3] * stride], vertices[indices[j * 3] * stride + 1], vertices[indices[j * 3] * stride + 2]);
+			glm::vec3 b = glm::vec3(vertices[indices[j * 3 + 1] * stride], vertices[indices[j * 3 + 1] * stride + 1], vertices[indices[j * 3 + 1] * stride + 2]);
+			glm::vec3 c = glm::vec3(vertices[indices[j * 3 + 2] * stride], vertices[indices[j * 3 + 2] * stride + 1], vertices[indices[j * 3 + 2] * stride + 2]);
+			
+			glm::vec3 triangleNormal = glm::cross(b - a, c - a);
+			float area = glm::length(triangleNormal);
+			
+			center += (a + b + c) * (area / 3.0f);
+			normal += triangleNormal;
+			clusterArea += area;
+		}
+		
+		meshCenter += center;
+		meshArea += clusterArea;
+		
+		clusterCenters[i] = clusterArea > 0.0f ? center / clusterArea : center;
+		clusterNormals[i] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+	}
+	
+	if(meshArea > 0.0f)
+		meshCenter /= meshArea;
+	
+	for(u32 i = 0; i < clusters.size(); i++)
+		clusters[i].sortKey = glm::dot(clusterCenters[i] - meshCenter, clusterNormals[i]);
+	
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Overdraw_Cluster &a, const Overdraw_Cluster &b){ return a.sortKey > b.sortKey; });
+	
+	std::vector<u32> sorted(indexCount);
+	u32 written = 0;
+	
+	for(u32 i = 0; i < clusters.size(); i++){
+		memcpy(sorted.data() + written, indices + clusters[i].start * 3, clusters[i].count * 3 * sizeof(u32));
+		written += clusters[i].count * 3;
+	}
+	
+	// keep the input order if the clusters' cold starts cost too much
+	float before = analyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, NULL);
+	float after = analyzeVertexCache(sorted.data(), indexCount, vertexCount, VERTEX_CACHE_SIZE, NULL);
+	
+	if(after <= before * threshold)
+		memcpy(destination, sorted.data(), indexCount * sizeof(u32));
+	else
+		memmove(destination, indices, indexCount * sizeof(u32));
+}
+
+// VERTEX FETCH //
+
+u32 optimizeVertexFetch(float *destination, u32 *indices, u32 indexCount, float *vertices, u32 vertexCount, u32 stride){
+	std::vector<u32> remap(vertexCount, EMPTY_SLOT);
+	u32 used = 0;
+	
+	for(u32 i = 0; i < indexCount; i++){
+		u32 vertex = indices[i];
+		
+		if(remap[vertex] == EMPTY_SLOT){
+			remap[vertex] = used;
+			memcpy(destination + used * stride, vertices + vertex * stride, stride * sizeof(float));
+			used++;
+		}
+		
+		indices[i] = remap[vertex];
+	}
+	
+	return used;
+}
@@ -0,0 +1,400 @@
+// pooled vertex/index buffers for mesh data
+// meshes are ranges of a few big buffers instead of a VBO/EBO/VAO each, meshes with the same vertex layout share a page
+// (and its VAO) until it's full, so draws of different meshes don't need any buffer or vertex array changes in between
+// ranges come from a best fit free list per buffer, freeing merges neighbours and compacts the page once it gets too fragmented
+
+#include <meshpool.h>
+#include <extensions.h>
+#include <glstate.h>
+
+#include <cstdio>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+static std::vector<Mesh_Pool_Page> pages;
+static std::vector<Mesh_Pool_Allocation> allocations;
+static std::vector<s32> freeHandles; // unused slots in allocations
+
+static u32 generation = 0;
+static u32 defragmentations = 0;
+static u64 bytesMoved = 0;
+
+// RANGE ALLOCATOR //
+
+static void initRangeAllocator(Range_Allocator *allocator, u32 capacity){
+	allocator->capacity = capacity;
+	allocator->used = 0;
+	allocator->free.clear();
+	
+	if(capacity > 0)
+		allocator->free.push_back({0, capacity});
+}
+
+// smallest free range that fits (keeps the big ones for big meshes), taken from its start
+static bool allocateRange(Range_Allocator *allocator, u32 size, u32 *offset){
+	if(size == 0){
+		*offset = 0;
+		return true;
+	}
+	
+	s32 best = -1;
+	for(u32 i = 0; i < allocator->free.size(); i++){
+		if(allocator->free[i].size >= size && (best < 0 || allocator->free[i].size < allocator->free[best].size))
+			best = i;
+	}
+	
+	if(best < 0)
+		return false;
+	
+	Pool_Range *range = &allocator->free[best];
+	*offset = range->offset;
+	
+	if(range->size == size){
+		allocator->free.erase(allocator->free.begin() + best);
+	} else {
+		range->offset += size;
+		range->size -= size;
+	}
+	
+	allocator->used += size;
+	return true;
+}
+
+// give a range back, merged with the free ranges right before/after it
+static void freeRange(Range_Allocator *allocator, u32 offset, u32 size){
+	if(size == 0)
+		return;
+	
+	std::vector<Pool_Range> *free = &allocator->free;
+	
+	u32 index = 0;
+	while(index < free->size() && (*free)[index].offset < offset)
+		index++;
+	
+	free->insert(free->begin() + index, {offset, size});
+	
+	// next one starts where this ends
+	if(index + 1 < free->size() && offset + size == (*free)[index + 1].offset){
+		(*free)[index].size += (*free)[index + 1].size;
+		free->erase(free->begin() + index + 1);
+	}
+	
+	// previous one ends where this starts
+	if(index > 0 && (*free)[index - 1].offset + (*free)[index - 1].size == offset){
+		(*free)[index - 1].size += (*free)[index].size;
+		free->erase(free->begin() + index);
+	}
+	
+	allocator->used -= size;
+}
+
+// 1 - largest free range / all free space
+static float rangeFragmentation(Range_Allocator *allocator, u32 *largest){
+	u32 total = 0;
+	*largest = 0;
+	
+	for(u32 i = 0; i < allocator->free.size(); i++){
+		total += allocator->free[i].size;
+		*largest = glm::max(*largest, allocator->free[i].size);
+	}
+	
+	return total > 0 ? 1.0f - (float)*largest / total : 0.0f;
+}
+
+// PAGES //
+
+static u32 layoutKey(Vertex_Format *format){
+	return format->position | (format->uv << 8) | (format->normal << 16);
+}
+
+// fixed size storage, contents only change through glBufferSubData/copies
+static u32 createPoolBuffer(GLenum target, u64 size){
+	u32 buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+	
+	if(glExtensions.bufferStorage)
+		extBufferStorage(target, size, NULL, GL_DYNAMIC_STORAGE_BIT);
+	else
+		glBufferData(target, size, NULL, GL_STATIC_DRAW);
+	
+	return buffer;
+}
+
+static u32 createPage(Vertex_Format *format, u32 vertexCount, u32 indexUnits){
+	Mesh_Pool_Page page;
+	
+	page.layout = layoutKey(format);
+	page.format = *format;
+	
+	initRangeAllocator(&page.vertices, glm::max((u32)(MESH_POOL_VERTEX_BYTES / format->stride), vertexCount));
+	initRangeAllocator(&page.indices, glm::max((u32)(MESH_POOL_INDEX_BYTES / MESH_POOL_INDEX_UNIT), indexUnits));
+	
+	// the element buffer binding is part of the VAO, so both buffers are created with it bound
+	glGenVertexArrays(1, &page.VAO);
+	stateBindVertexArray(page.VAO);
+	
+	page.vertexBuffer = createPoolBuffer(GL_ARRAY_BUFFER, (u64)page.vertices.capacity * format->stride);
+	applyVertexFormat(format);
+	
+	page.indexBuffer = createPoolBuffer(GL_ELEMENT_ARRAY_BUFFER, (u64)page.indices.capacity * MESH_POOL_INDEX_UNIT);
+	
+	pages.push_back(page);
+	
+	return pages.size() - 1;
+}
+
+// slide the ranges (sorted by offset) down to the start of buffer, ones already packed at the start stay put
+// goes through a scratch buffer since a range can overlap where it's moving to, returns the bytes moved
+static u64 compactRanges(Range_Allocator *allocator, u32 buffer, u32 unitSize, std::vector<u32*> *offsets, std::vector<u32> *sizes){
+	u32 packed = 0;
+	u32 first = 0;
+	
+	while(first < offsets->size() && *(*offsets)[first] == packed){
+		packed += (*sizes)[first];
+		first++;
+	}
+	
+	u32 start = packed;
+	
+	if(first < offsets->size()){
+		u64 movedSize = (u64)(allocator->used - start) * unitSize;
+		
+		u32 scratch;
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, movedSize, NULL, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		
+		for(u32 i = first; i < offsets->size(); i++){
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (u64)*(*offsets)[i] * unitSize, (u64)(packed - start) * unitSize, (u64)(*sizes)[i] * unitSize);
+			
+			*(*offsets)[i] = packed;
+			packed += (*sizes)[i];
+		}
+		
+		glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (u64)start * unitSize, movedSize);
+		
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &scratch);
+	}
+	
+	// everything used is at the start now, the rest is one free range
+	allocator->free.clear();
+	if(packed < allocator->capacity)
+		allocator->free.push_back({packed, allocator->capacity - packed});
+	
+	return (u64)(packed - start) * unitSize;
+}
+
+// move every mesh in a page to the start of its buffers (GL orders the copies after draws already issued)
+static u64 defragmentPage(u32 pageIndex){
+	Mesh_Pool_Page *page = &pages[pageIndex];
+	
+	std::vector<Mesh_Pool_Allocation*> live;
+	for(u32 i = 0; i < allocations.size(); i++){
+		if(allocations[i].page == (s32)pageIndex)
+			live.push_back(&allocations[i]);
+	}
+	
+	std::vector<u32*> offsets(live.size());
+	std::vector<u32> sizes(live.size());
+	
+	// vertices
+	std::sort(live.begin(), live.end(), [](const Mesh_Pool_Allocation *a, const Mesh_Pool_Allocation *b){ return a->firstVertex < b->firstVertex; });
+	
+	for(u32 i = 0; i < live.size(); i++){
+		offsets[i] = &live[i]->firstVertex;
+		sizes[i] = live[i]->vertexCount;
+	}
+	
+	u64 moved = compactRanges(&page->vertices, page->vertexBuffer, page->format.stride, &offsets, &sizes);
+	
+	// indices
+	std::sort(live.begin(), live.end(), [](const Mesh_Pool_Allocation *a, const Mesh_Pool_Allocation *b){ return a->indexUnit < b->indexUnit; });
+	
+	for(u32 i = 0; i < live.size(); i++){
+		offsets[i] = &live[i]->indexUnit;
+		sizes[i] = live[i]->indexUnits;
+	}
+	
+	moved += compactRanges(&page->indices, page->indexBuffer, MESH_POOL_INDEX_UNIT, &offsets, &sizes);
+	
+	if(moved > 0){
+		generation++;
+		defragmentations++;
+		bytesMoved += moved;
+	}
+	
+	return moved;
+}
+
+// ALLOCATIONS //
+
+s32 allocateMesh(Vertex_Format *format, void *vertices, u32 vertexCount, void *indices, u32 indexBytes){
+	u32 layout = layoutKey(format);
+	u32 indexUnits = (indexBytes + MESH_POOL_INDEX_UNIT - 1) / MESH_POOL_INDEX_UNIT;
+	
+	s32 pageIndex = -1;
+	u32 firstVertex, indexUnit;
+	
+	// first page of this layout with room for both
+	for(u32 i = 0; i < pages.size() && pageIndex < 0; i++){
+		if(pages[i].layout != layout)
+			continue;
+		
+		if(!allocateRange(&pages[i].vertices, vertexCount, &firstVertex))
+			continue;
+		
+		if(!allocateRange(&pages[i].indices, indexUnits, &indexUnit)){
+			freeRange(&pages[i].vertices, firstVertex, vertexCount);
+			continue;
+		}
+		
+		pageIndex = i;
+	}
+	
+	if(pageIndex < 0){
+		pageIndex = createPage(format, vertexCount, indexUnits);
+		
+		allocateRange(&pages[pageIndex].vertices, vertexCount, &firstVertex);
+		allocateRange(&pages[pageIndex].indices, indexUnits, &indexUnit);
+	}
+	
+	Mesh_Pool_Page *page = &pages[pageIndex];
+	
+	// copy targets so the upload doesn't touch vertex array state
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page->vertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (u64)firstVertex * format->stride, (u64)vertexCount * format->stride, vertices);
+	
+	if(indices && indexBytes > 0){
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page->indexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (u64)indexUnit * MESH_POOL_INDEX_UNIT, indexBytes, indices);
+	}
+	
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	
+	Mesh_Pool_Allocation allocation;
+	allocation.page = pageIndex;
+	allocation.firstVertex = firstVertex;
+	allocation.vertexCount = vertexCount;
+	allocation.indexUnit = indexUnit;
+	allocation.indexUnits = indexUnits;
+	
+	if(!freeHandles.empty()){
+		s32 handle = freeHandles.back();
+		freeHandles.pop_back();
+		
+		allocations[handle] = allocation;
+		return handle;
+	}
+	
+	allocations.push_back(allocation);
+	return allocations.size() - 1;
+}
+
+void freeMesh(s32 handle){
+	if(handle < 0 || allocations[handle].page < 0)
+		return;
+	
+	Mesh_Pool_Allocation *allocation = &allocations[handle];
+	u32 pageIndex = allocation->page;
+	Mesh_Pool_Page *page = &pages[pageIndex];
+	
+	freeRange(&page->vertices, allocation->firstVertex, allocation->vertexCount);
+	freeRange(&page->indices, allocation->indexUnit, allocation->indexUnits);
+	
+	allocation->page = -1;
+	freeHandles.push_back(handle);
+	
+	// holes between meshes, pack what's left
+	u32 largestVertices, largestIndices;
+	float fragmentation = glm::max(rangeFragmentation(&page->vertices, &largestVertices), rangeFragmentation(&page->indices, &largestIndices));
+	
+	if(fragmentation > MESH_POOL_DEFRAGMENT_THRESHOLD && (page->vertices.used > 0 || page->indices.used > 0))
+		defragmentPage(pageIndex);
+}
+
+Mesh_Pool_Page *getMeshPage(s32 handle){
+	return &pages[allocations[handle].page];
+}
+
+s32 getMeshBaseVertex(s32 handle){
+	return handle < 0 ? 0 : allocations[handle].firstVertex;
+}
+
+u64 getMeshIndexOffset(s32 handle){
+	return handle < 0 ? 0 : (u64)allocations[handle].indexUnit * MESH_POOL_INDEX_UNIT;
+}
+
+u32 getMeshPoolGeneration(){
+	return generation;
+}
+
+// compact every page, returns the bytes moved
+u64 defragmentMeshPool(){
+	u64 moved = 0;
+	
+	for(u32 i = 0; i < pages.size(); i++)
+		moved += defragmentPage(i);
+	
+	return moved;
+}
+
+// STATS //
+
+Mesh_Pool_Stats getMeshPoolStats(){
+	Mesh_Pool_Stats stats;
+	
+	stats.pages = pages.size();
+	stats.allocations = allocations.size() - freeHandles.size();
+	stats.vertexCapacity = 0;
+	stats.vertexUsed = 0;
+	stats.indexCapacity = 0;
+	stats.indexUsed = 0;
+	stats.freeRanges = 0;
+	stats.defragmentations = defragmentations;
+	stats.bytesMoved = bytesMoved;
+	
+	// fragmentation over all pages (a mesh can only use one page's free space)
+	u64 vertexFree = 0, indexFree = 0;
+	u64 vertexLargest = 0, indexLargest = 0;
+	
+	for(u32 i = 0; i < pages.size(); i++){
+		Mesh_Pool_Page *page = &pages[i];
+		u32 stride = page->format.stride;
+		u32 largest;
+		
+		stats.vertexCapacity += (u64)page->vertices.capacity * stride;
+		stats.vertexUsed += (u64)page->vertices.used * stride;
+		stats.indexCapacity += (u64)page->indices.capacity * MESH_POOL_INDEX_UNIT;
+		stats.indexUsed += (u64)page->indices.used * MESH_POOL_INDEX_UNIT;
+		stats.freeRanges += page->vertices.free.size() + page->indices.free.size();
+		
+		rangeFragmentation(&page->vertices, &largest);
+		vertexFree += (u64)(page->vertices.capacity - page->vertices.used) * stride;
+		vertexLargest = glm::max(vertexLargest, (u64)largest * stride);
+		
+		rangeFragmentation(&page->indices, &largest);
+		indexFree += (u64)(page->indices.capacity - page->indices.used) * MESH_POOL_INDEX_UNIT;
+		indexLargest = glm::max(indexLargest, (u64)largest * MESH_POOL_INDEX_UNIT);
+	}
+	
+	stats.vertexFragmentation = vertexFree > 0 ? 1.0f - (float)vertexLargest / vertexFree : 0.0f;
+	stats.indexFragmentation = indexFree > 0 ? 1.0f - (float)indexLargest / indexFree : 0.0f;
+	
+	return stats;
+}
+
+void printMeshPoolStats(){
+	Mesh_Pool_Stats stats = getMeshPoolStats();
+	
+	printf("mesh pool: %u meshes in %u pages, %u free ranges\n", stats.allocations, stats.pages, stats.freeRanges);
+	printf("  vertices: %.1f / %.1f KB (%.0f%%), fragmentation %.2f\n", stats.vertexUsed / 1024.0f, stats.vertexCapacity / 1024.0f, stats.vertexCapacity > 0 ? 100.0f * stats.vertexUsed / stats.vertexCapacity : 0.0f, stats.vertexFragmentation);
+	printf("  indices:  %.1f / %.1f KB (%.0f%%), fragmentation %.2f\n", stats.indexUsed / 1024.0f, stats.indexCapacity / 1024.0f, stats.indexCapacity > 0 ? 100.0f * stats.indexUsed / stats.indexCapacity : 0.0f, stats.indexFragmentation);
+	printf("  %u defragmentations, %.1f KB moved\n", stats.defragmentations, stats.bytesMoved / 1024.0f);
+}
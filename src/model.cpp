@@ -1,251 +1,1224 @@
 // models (collection of meshes)
 
 #include <model.h>
+#include <glstate.h>
+#include <extensions.h>
+#include <simplify.h>
+#include <meshoptimize.h>
+#include <meshpool.h>
+#include <fileio.h>
+#include <hash.h>
+
+#include <GLFW/glfw3.h>
+
+#include <cstdio>
+#include <cstring>
 
 // internal texture cache
 static std::vector<Texture_Data> textureCache;
 
+// how models loaded from now on store their vertices (see setModelVertexFormat)
+static u32 modelPositionFormat = VERTEX_POSITION_UNORM16;
+static u32 modelUVFormat = VERTEX_UV_HALF;
+static u32 modelNormalFormat = VERTEX_NORMAL_OCT16;
+
+// cpu copies models loaded from now on keep (see setModelCpuData)
+static u32 modelCpuData = MODEL_CPU_NONE;
+
+// COOKED MODEL FORMAT //
+// everything loadModel builds from an import, stored as it's uploaded so a load is a mapping + a copy into the pool:
+// header, then sections (each aligned to COOKED_MODEL_ALIGNMENT from the page aligned start of the mapping)
+
+#define COOKED_MODEL_MAGIC 0x4C444F4D // "MODL"
+#define COOKED_MODEL_VERSION 2 // also part of the key, bumped when the import changes
+#define COOKED_MODEL_ALIGNMENT 64
+
+// where a section is in the file (bytes)
+struct Cooked_Section {
+	u64 offset;
+	u64 size;
+};
+
+struct Cooked_Model_Header {
+	u32 magic;
+	u32 version;
+	u64 key; // source file + import settings (see cookedModelKey), anything else is stale
+	
+	u32 vertexCount;
+	u32 indexCount;
+	u32 indexType; // GL_UNSIGNED_SHORT/INT
+	u32 meshCount;
+	u32 nodeCount;
+	u32 materialCount;
+	u32 textureCount;
+	u32 lodCount; // loads with fewer levels than this only draw the first ones
+	
+	// vertex format the vertices are stored as (with packVertices' position decode values)
+	u32 positionFormat;
+	u32 uvFormat;
+	u32 normalFormat;
+	float positionOffset[3];
+	float positionScale[3];
+	
+	Bounds bounds; // every vertex
+	
+	Cooked_Section vertices; // packed, vertexCount * stride
+	Cooked_Section indices; // indexType, every level of every mesh
+	Cooked_Section positions; // 3 floats per vertex (only read for MODEL_CPU_PICKING)
+	Cooked_Section meshes; // Cooked_Mesh
+	Cooked_Section lodFirstIndices; // u32, mesh * lodCount + level
+	Cooked_Section lodIndexCounts; // u32, same
+	Cooked_Section lodErrors; // float per level
+	Cooked_Section nodes; // Cooked_Node, depth first like Model::nodeParents
+	Cooked_Section textures; // Cooked_Texture, in the order they're bound
+	Cooked_Section strings; // null terminated, node names and texture paths point into it
+};
+
+struct Cooked_Mesh {
+	u32 baseVertex;
+	u32 vertexCount;
+	u32 firstIndex;
+	u32 indexCount;
+	u32 material;
+	u32 node;
+	Bounds bounds;
+};
+
+struct Cooked_Node {
+	s32 parent;
+	u32 subtreeSize;
+	u32 name; // offset into strings
+	float localMatrix[16];
+};
+
+// texture of a material, materials themselves are all createMaterial defaults
+struct Cooked_Texture {
+	u32 material;
+	s32 type; // DIFFUSE_MAP/SPECULAR_MAP
+	u32 path; // offset into strings, relative to the model's directory
+};
+
+static void initModel(Model *model, std::string path, u32 lodCount);
+static bool importModel(Model *model, std::string path, u64 cookedKey, bool upload);
+static void countAssimpNode(aiNode *node, const aiScene *scene, u32 *vertexCount, u32 *indexCount);
+static void optimizeModelMesh(Model_Import *import, u32 baseVertex, u32 firstIndex);
+static void buildModelGeometry(Model *model, Model_Import *import, u64 cookedKey, std::string cookedPath, bool upload);
+static void buildModelLods(Model *model, Model_Import *import, glm::vec3 *positions, u32 *lodFirstIndices, u32 *lodIndexCounts);
+static void uploadModelGeometry(Model *model, void *vertices, u32 vertexCount, Vertex_Format format, void *indices, u32 indexCount, GLenum indexType, Bounds bounds, u32 *lodFirstIndices, u32 *lodIndexCounts);
+static bool loadCookedModel(Model *model, std::string cookedPath, u64 key);
+static void writeCookedModel(Model *model, Model_Import *import, std::string cookedPath, u64 key, void *vertices, void *indices, glm::vec3 *positions, u32 *lodFirstIndices, u32 *lodIndexCounts);
+static void importAssimpTextures(Model_Import *import, Material *material, u32 materialIndex, aiMaterial *assimpMat, aiTextureType type, int intType, std::string modelDirectory, bool load);
+static void bindModelTexture(Material *material, std::string path, int intType);
+static void uploadModelCommands(Model *model);
+static void rebaseModelBatches(Model *model);
+
+// vertex format of every model loaded after this, the default (16 bit positions across the model's bounds,
+// half float uvs, octahedral normals) is 16 bytes per vertex instead of 32
+void setModelVertexFormat(u32 position, u32 uv, u32 normal){
+	modelPositionFormat = position;
+	modelUVFormat = uv;
+	modelNormalFormat = normal;
+}
+
+// which cpu side copies of the geometry models loaded after this keep (MODEL_CPU_* flags), the default is none:
+// the imported arrays are released as soon as everything is uploaded
+void setModelCpuData(u32 flags){
+	modelCpuData = flags;
+}
+
+// drop cpu copies nothing needs anymore (flags that weren't kept are ignored)
+void releaseModelCpuData(Model *model, u32 flags){
+	if(flags & MODEL_CPU_PICKING){
+		std::vector<glm::vec3>().swap(model->positions);
+		std::vector<u32>().swap(model->indices);
+	}
+	
+	if(flags & MODEL_CPU_VERTICES)
+		std::vector<float>().swap(model->vertices);
+	
+	model->cpuData &= ~flags;
+}
+
+// system memory the model's geometry copies hold
+u64 getModelCpuBytes(Model *model){
+	return model->positions.capacity() * sizeof(glm::vec3) + model->indices.capacity() * sizeof(u32) + model->vertices.capacity() * sizeof(float);
+}
+
 // load a model from a path
 Model loadModel(std::string path){
-	Model model;
-	
-	model.position = glm::vec3(0, 0, 0);
-	model.rotation = glm::vec3(0, 0, 0);
-	model.scale = glm::vec3(1, 1, 1);
+	return loadModel(path, 1);
+}
+
+Model loadModel(std::string path, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale){
+	return loadModel(path, position, rotation, scale, 1);
+}
+
+// same, with lodCount - 1 simplified versions of every mesh (each about half the triangles of the one before)
+// the first load of a model imports it and writes path + MODEL_COOKED_EXTENSION next to it, later loads map that instead
+// (until the source file or the import settings change, see also cookModel)
+Model loadModel(std::string path, u32 lodCount){
+	double start = glfwGetTime();
 	
-	Assimp::Importer importer;
+	Model model;
+	initModel(&model, path, lodCount);
 	
-	printf("loading model %s...\n", path.c_str());
-	const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	// full float vertices aren't cooked, a model that wants them has to be imported
+	std::string cookedPath = path + MODEL_COOKED_EXTENSION;
+	u64 cookedKey = cookedModelKey(path);
 	
-	if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode){
-		printf("error (assimp): %s\n", importer.GetErrorString());
+	if(cookedKey && !(model.cpuData & MODEL_CPU_VERTICES) && loadCookedModel(&model, cookedPath, cookedKey)){
+		printf("model %s loaded from %s in %.1f ms (warm, %u meshes, %u draw calls)\n", path.c_str(), cookedPath.c_str(), (glfwGetTime() - start) * 1000.0, (u32)model.meshes.size(), (u32)model.batches.size());
 		return model;
 	}
 	
-	printf("model loaded\n");
+	if(importModel(&model, path, cookedKey, true))
+		printf("model %s imported in %.1f ms (cold)\n", path.c_str(), (glfwGetTime() - start) * 1000.0);
 	
-	model.path = path.substr(0, path.find_last_of('/'));
+	return model;
+}
+
+Model loadModel(std::string path, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, u32 lodCount){
+	Model model = loadModel(path, lodCount);
 	
-	printf("parsing model %s...\n", path.c_str());
-	processAssimpNode(&model, scene->mRootNode, scene);
-	printf("parsed.\n");
+	model.position = position;
+	model.rotation = rotation;
+	model.scale = scale;
 	
 	return model;
 }
 
-Model loadModel(std::string path, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale){
+// import path and write its cooked file without uploading anything or loading its textures (no context needed,
+// models can be cooked on several threads at once), loads with up to lodCount levels use it
+// returns false if the model couldn't be imported
+bool cookModel(std::string path, u32 lodCount){
 	Model model;
+	initModel(&model, path, lodCount);
+	model.cpuData = MODEL_CPU_NONE;
 	
-	model.position = glm::vec3(0, 0, 0);
-	model.rotation = glm::vec3(0, 0, 0);
-	model.scale = glm::vec3(1, 1, 1);
+	u64 cookedKey = cookedModelKey(path);
 	
+	return cookedKey && importModel(&model, path, cookedKey, false);
+}
+
+static void initModel(Model *model, std::string path, u32 lodCount){
+	model->position = glm::vec3(0, 0, 0);
+	model->rotation = glm::vec3(0, 0, 0);
+	model->scale = glm::vec3(1, 1, 1);
+	model->modelMatrix = glm::mat4(1.0f);
+	model->normalMatrix = glm::mat3(1.0f);
+	model->transformCache.valid = false;
+	model->indirectBuffer = 0;
+	model->nodeInstances.VAO = 0;
+	model->nodeInstances.instanceVBO = 0;
+	model->nodeInstances.capacity = 0;
+	model->nodeInstances.uploadedCount = 0;
+	model->poolGeneration = 0;
+	model->poolBaseVertex = 0;
+	model->poolIndexOffset = 0;
+	model->cpuData = modelCpuData;
+	model->dirtyNodes = 0;
+	model->lodCount = lodCount > 0 ? lodCount : 1;
+	model->lod = 0;
+	model->path = path.substr(0, path.find_last_of('/'));
+	
+	model->geometry = Vertex_Data();
+	model->geometry.allocation = -1;
+}
+
+// run path through assimp, optimize and simplify every mesh and cook the result (if cookedKey isn't 0)
+// upload = false only builds what the cooked file needs, nothing touches the gpu or the texture cache then
+static bool importModel(Model *model, std::string path, u64 cookedKey, bool upload){
 	Assimp::Importer importer;
 	
 	printf("loading model %s...\n", path.c_str());
-	const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	// obj faces come in with a vertex per corner, joined so triangles share edges (simplifying needs that to do anything)
+	const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
 	
 	if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode){
 		printf("error (assimp): %s\n", importer.GetErrorString());
-		return model;
+		return false;
 	}
 	
 	printf("model loaded\n");
 	
-	model.path = path.substr(0, path.find_last_of('/'));
-	
 	printf("parsing model %s...\n", path.c_str());
-	processAssimpNode(&model, scene->mRootNode, scene);
-	printf("parsed.\n");
 	
-	model.position = position;
-	model.rotation = rotation;
-	model.scale = scale;
+	Model_Import import;
+	initArena(&import.arena, MODEL_IMPORT_BLOCK_SIZE);
 	
-	return model;
+	// materials first so meshes sharing one also share its id (and get batched together)
+	for(unsigned int i = 0; i < scene->mNumMaterials; i++){
+		Material material = createMaterial(glm::vec3(1.0f, 1.0f, 1.0f), 64, 1.0);
+		
+		// diffuse textures
+		importAssimpTextures(&import, &material, i, scene->mMaterials[i], aiTextureType_DIFFUSE, DIFFUSE_MAP, model->path, upload);
+		
+		// specular textures
+		importAssimpTextures(&import, &material, i, scene->mMaterials[i], aiTextureType_SPECULAR, SPECULAR_MAP, model->path, upload);
+		
+		model->materials.push_back(material);
+	}
+	
+	// scratch for the whole import, sized up front (a mesh referenced by several nodes is added once per node)
+	// simplified levels are at most as big as the level before, so lodCount times the full indices always fits
+	u32 vertexCount = 0, indexCount = 0;
+	countAssimpNode(scene->mRootNode, scene, &vertexCount, &indexCount);
+	
+	import.vertexCapacity = vertexCount;
+	import.indexCapacity = indexCount * model->lodCount;
+	import.vertices = arenaPush(&import.arena, float, import.vertexCapacity * 8);
+	import.indices = arenaPush(&import.arena, u32, import.indexCapacity);
+	import.vertexCount = 0;
+	import.indexCount = 0;
+	
+	memset(&import.optimizeStats, 0, sizeof(import.optimizeStats));
+	
+	processAssimpNode(model, scene->mRootNode, scene, -1, &import);
+	importer.FreeScene(); // everything needed is copied out
+	
+	buildModelGeometry(model, &import, cookedKey, path + MODEL_COOKED_EXTENSION, upload);
+	
+	printf("parsed (%u meshes, %u nodes, %u materials, %u draw calls).\n", (u32)model->meshes.size(), (u32)model->nodeParents.size(), (u32)model->materials.size(), (u32)model->batches.size());
+	
+	Model_Optimize_Stats *stats = &import.optimizeStats;
+	
+	if(stats->triangles > 0){
+		printf("optimized: %u -> %u vertices, ACMR %.3f -> %.3f, index memory %.1f -> %.1f KB, vertex memory %.1f -> %.1f KB\n",
+			stats->vertices, stats->optimizedVertices,
+			stats->misses / (float)stats->triangles, stats->optimizedMisses / (float)stats->triangles,
+			stats->triangles * 3 * sizeof(u32) / 1024.0f, stats->triangles * 3 * model->geometry.indexSize / 1024.0f,
+			stats->vertices * 8 * sizeof(float) / 1024.0f, stats->optimizedVertices * model->geometry.format.stride / 1024.0f);
+	}
+	
+	printf("cpu mesh data: %.1f KB resident (import scratch peak %.1f KB, released)\n", getModelCpuBytes(model) / 1024.0f, import.arena.peak / 1024.0f);
+	
+	freeArena(&import.arena);
+	
+	return true;
+}
+
+// give the model's pool ranges and draw commands back (textures stay cached, a BVH it was inserted into has to drop it first)
+void freeModel(Model *model){
+	freeVertexData(&model->geometry);
+	freeInstanceData(&model->nodeInstances);
+	
+	if(model->indirectBuffer)
+		glDeleteBuffers(1, &model->indirectBuffer);
+	
+	model->indirectBuffer = 0;
+	model->meshes.clear();
+	model->batches.clear();
+	
+	releaseModelCpuData(model, model->cpuData);
+}
+
+// vertices/indices processAssimpNode will add for node and its subtree
+static void countAssimpNode(aiNode *node, const aiScene *scene, u32 *vertexCount, u32 *indexCount){
+	for(u32 i = 0; i < node->mNumMeshes; i++){
+		aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+		
+		*vertexCount += mesh->mNumVertices;
+		
+		for(u32 j = 0; j < mesh->mNumFaces; j++)
+			*indexCount += mesh->mFaces[j].mNumIndices;
+	}
+	
+	for(u32 i = 0; i < node->mNumChildren; i++)
+		countAssimpNode(node->mChildren[i], scene, vertexCount, indexCount);
 }
 
-void processAssimpNode(Model *model, aiNode *node, const aiScene *scene){
+// add node (and its subtree) to the model's hierarchy, depth first so parents always come before children
+void processAssimpNode(Model *model, aiNode *node, const aiScene *scene, s32 parent, Model_Import *import){
+	u32 index = model->nodeParents.size();
+	
+	// assimp matrices are row major (and packed, so copied out before glm looks at them)
+	float transform[16];
+	memcpy(transform, &node->mTransformation, sizeof(transform));
+	glm::mat4 localMatrix = glm::transpose(glm::make_mat4(transform));
+	
+	model->nodeNames.push_back(node->mName.C_Str());
+	model->nodeParents.push_back(parent);
+	model->nodeSubtreeSizes.push_back(1);
+	model->nodeLocalMatrices.push_back(localMatrix);
+	model->nodeWorldMatrices.push_back(glm::mat4(1.0f));
+	model->nodeNormalMatrices.push_back(glm::mat3(1.0f));
+	model->nodeDirty.push_back(1);
+	model->dirtyNodes++;
+	
 	// loop through each mesh in this node and process them
 	for(unsigned int i = 0; i < node->mNumMeshes; i++){
 		aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-		model->meshes.push_back(processAssimpMesh(mesh, scene, model->path));
+		processAssimpMesh(model, mesh, import);
+		
+		model->meshNodes.push_back(index);
 	}
 	
 	// loop through each child of this node
 	for(unsigned int i = 0; i < node->mNumChildren; i++){
-		processAssimpNode(model, node->mChildren[i], scene);
+		processAssimpNode(model, node->mChildren[i], scene, index, import);
 	}
+	
+	model->nodeSubtreeSizes[index] = model->nodeParents.size() - index;
 }
 
-Object_Data processAssimpMesh(aiMesh *mesh, const aiScene *scene, std::string path){
-	float *vertices = (float*)malloc(mesh->mNumVertices * 8 * sizeof(float)); // 3 + 2 + 3 = 8
-	
-	// allocation work (# indices dependent on # faces)
-	int numIndices = 0;
-	for(int i = 0; i < mesh->mNumFaces; i++){
-		numIndices += mesh->mFaces[i].mNumIndices;
-	}
-	
-	u32 *indices = (u32*)malloc(numIndices * sizeof(u32));
+// append a mesh's vertices/indices to the import arrays (optimized) and add an Object_Data for it
+// (its buffers are filled in by buildModelGeometry once every mesh is in, it never points at the import arrays)
+void processAssimpMesh(Model *model, aiMesh *mesh, Model_Import *import){
+	Vertex_Data vertexData = Vertex_Data();
 	
+	vertexData.usingEBO = true;
+	vertexData.indexType = GL_UNSIGNED_INT; // until buildModelGeometry knows if 16 bits are enough
+	vertexData.indexSize = sizeof(u32);
+	vertexData.baseVertex = import->vertexCount;
+	vertexData.firstIndex = import->indexCount;
+	vertexData.allocation = -1;
 	
-	// process vertices
-	int verticesIndex = 0; // index in buffer
-	
+	// process vertices (3 + 2 + 3 = 8 floats)
 	for(unsigned int i = 0; i < mesh->mNumVertices; i++){
-		// push vertex coordinates
-		vertices[verticesIndex++] = mesh->mVertices[i].x;
-		vertices[verticesIndex++] = mesh->mVertices[i].y;
-		vertices[verticesIndex++] = mesh->mVertices[i].z;
-		
-		// push texture coordinates (if they exist)
-		if(mesh->mTextureCoords[0]){
-			vertices[verticesIndex++] = mesh->mTextureCoords[0][i].x;
-			vertices[verticesIndex++] = mesh->mTextureCoords[0][i].y;
-		} else {
-			vertices[verticesIndex++] = 0;
-			vertices[verticesIndex++] = 0;
-		}
+		float *vertex = import->vertices + (import->vertexCount + i) * 8;
+		
+		// vertex coordinates
+		vertex[0] = mesh->mVertices[i].x;
+		vertex[1] = mesh->mVertices[i].y;
+		vertex[2] = mesh->mVertices[i].z;
+		
+		// texture coordinates (if they exist)
+		vertex[3] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].x : 0.0f;
+		vertex[4] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].y : 0.0f;
 		
-		// push normals
-		vertices[verticesIndex++] = mesh->mNormals[i].x;
-		vertices[verticesIndex++] = mesh->mNormals[i].y;
-		vertices[verticesIndex++] = mesh->mNormals[i].z;
+		// normals
+		vertex[5] = mesh->mNormals[i].x;
+		vertex[6] = mesh->mNormals[i].y;
+		vertex[7] = mesh->mNormals[i].z;
 	}
 	
-	// process indices
-	int indicesIndex = 0;
+	import->vertexCount += mesh->mNumVertices;
+	
+	// process indices (relative to the mesh, baseVertex offsets them when drawing)
 	for(unsigned int i = 0; i < mesh->mNumFaces; i++){
 		aiFace face = mesh->mFaces[i];
 		
 		for(unsigned int j = 0; j < face.mNumIndices; j++){
-			indices[indicesIndex++] = face.mIndices[j];
+			import->indices[import->indexCount++] = face.mIndices[j];
 		}
 	}
 	
-	// create vertex data
-	// NOTE: mesh->mNumVertices?
-	Vertex_Data vertexData = createVertexData(vertices, mesh->mNumVertices, mesh->mNumVertices * 8 * sizeof(float), indices, numIndices, numIndices * sizeof(u32));
-
+	optimizeModelMesh(import, vertexData.baseVertex, vertexData.firstIndex);
+	
+	vertexData.vertexCount = import->vertexCount - vertexData.baseVertex;
+	vertexData.indicesCount = import->indexCount - vertexData.firstIndex;
+	vertexData.bounds = computeBounds(import->vertices + vertexData.baseVertex * 8, vertexData.vertexCount, 8);
+	
 	// process materials
-	Material material = createMaterial(glm::vec3(1.0f, 1.0f, 1.0f), 64, 1.0);
+	u32 materialIndex = mesh->mMaterialIndex;
+	
+	Object_Data finalMesh = createObjectData(&vertexData, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1), &model->materials[materialIndex]);
+	
+	model->meshes.push_back(finalMesh);
+	model->meshMaterials.push_back(materialIndex);
+}
+
+// optimize the mesh at the end of the import arrays in place: weld identical vertices (whatever assimp's join left,
+// it doesn't compare the 8 floats exactly like this), order triangles for the post-transform cache and then overdraw,
+// order vertices by first use
+static void optimizeModelMesh(Model_Import *import, u32 baseVertex, u32 firstIndex){
+	float *meshVertices = import->vertices + baseVertex * 8;
+	u32 *meshIndices = import->indices + firstIndex;
+	u32 vertexCount = import->vertexCount - baseVertex;
+	u32 indexCount = import->indexCount - firstIndex;
 	
-	if(mesh->mMaterialIndex >= 0){
-		aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
+	if(indexCount == 0)
+		return;
+	
+	// scratch only lives for this mesh
+	Arena_Mark mark = arenaMark(&import->arena);
+	
+	u32 misses = 0;
+	analyzeVertexCache(meshIndices, indexCount, vertexCount, VERTEX_CACHE_SIZE, &misses);
+	
+	import->optimizeStats.vertices += vertexCount;
+	import->optimizeStats.triangles += indexCount / 3;
+	import->optimizeStats.misses += misses;
+	
+	u32 *remap = arenaPush(&import->arena, u32, vertexCount);
+	u32 uniqueCount = weldVertices(remap, meshVertices, vertexCount, 8);
+	
+	float *welded = arenaPush(&import->arena, float, uniqueCount * 8);
+	remapVertices(welded, meshVertices, vertexCount, 8, remap);
+	remapIndices(meshIndices, meshIndices, indexCount, remap);
+	
+	u32 *ordered = arenaPush(&import->arena, u32, indexCount);
+	optimizeVertexCache(ordered, meshIndices, indexCount, uniqueCount);
+	optimizeOverdraw(meshIndices, ordered, indexCount, welded, uniqueCount, 8, OVERDRAW_THRESHOLD);
+	
+	u32 usedCount = optimizeVertexFetch(meshVertices, meshIndices, indexCount, welded, uniqueCount, 8);
+	import->vertexCount = baseVertex + usedCount;
+	
+	arenaRewind(&import->arena, mark);
+	
+	analyzeVertexCache(meshIndices, indexCount, usedCount, VERTEX_CACHE_SIZE, &misses);
+	
+	import->optimizeStats.optimizedVertices += usedCount;
+	import->optimizeStats.optimizedMisses += misses;
+}
+
+// simplify every mesh lodCount - 1 times, each level from the one before, appending the new indices
+// (a mesh that can't be simplified any further without too much error keeps using its last level)
+static void buildModelLods(Model *model, Model_Import *import, glm::vec3 *positions, u32 *lodFirstIndices, u32 *lodIndexCounts){
+	u32 meshCount = model->meshes.size();
+	u32 lodCount = model->lodCount;
+	
+	model->lodErrors.assign(lodCount, 0.0f);
+	
+	for(u32 i = 0; i < meshCount; i++){
+		Vertex_Data *vertexData = &model->meshes[i].vertexData;
 		
-		// diffuse textures
-		bindAssimpTexturesToMaterial(&material, mat, aiTextureType_DIFFUSE, DIFFUSE_MAP, path);
+		lodFirstIndices[i * lodCount] = vertexData->firstIndex;
+		lodIndexCounts[i * lodCount] = vertexData->indicesCount;
 		
-		// specular textures
-		bindAssimpTexturesToMaterial(&material, mat, aiTextureType_SPECULAR, SPECULAR_MAP, path);
+		for(u32 level = 1; level < lodCount; level++){
+			u32 firstIndex = lodFirstIndices[i * lodCount + level - 1];
+			u32 indexCount = lodIndexCounts[i * lodCount + level - 1];
+			
+			Arena_Mark mark = arenaMark(&import->arena);
+			
+			// mesh indices are relative to baseVertex
+			float error = 0.0f;
+			u32 *simplified = arenaPush(&import->arena, u32, indexCount);
+			u32 simplifiedCount = simplifyIndices(simplified, import->indices + firstIndex, indexCount, positions + vertexData->baseVertex, vertexData->vertexCount, indexCount / 6 * 3, MODEL_LOD_MAX_ERROR, &error);
+			
+			if(simplifiedCount < indexCount){
+				firstIndex = import->indexCount;
+				indexCount = simplifiedCount;
+				
+				// collapses leave the triangles in the old order, which the cache no longer likes
+				import->indexCount += indexCount;
+				optimizeVertexCache(import->indices + firstIndex, simplified, indexCount, vertexData->vertexCount);
+			}
+			
+			arenaRewind(&import->arena, mark);
+			
+			lodFirstIndices[i * lodCount + level] = firstIndex;
+			lodIndexCounts[i * lodCount + level] = indexCount;
+			
+			model->lodErrors[level] = glm::max(model->lodErrors[level], error);
+		}
 	}
 	
-	// TODO: vertex data not pointer
-	Object_Data finalMesh = createObjectData(&vertexData, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1), &material);
+	for(u32 level = 1; level < lodCount; level++){
+		u32 triangles = 0;
+		for(u32 i = 0; i < meshCount; i++)
+			triangles += lodIndexCounts[i * lodCount + level] / 3;
+		
+		printf("  lod %u: %u triangles (error %.4f)\n", level, triangles, model->lodErrors[level]);
+	}
+}
 
-	return finalMesh;
+// pack every mesh, upload it (if upload) and cook it (if cookedKey isn't 0)
+// the import arrays are only copied into the model if setModelCpuData asked for them
+static void buildModelGeometry(Model *model, Model_Import *import, u64 cookedKey, std::string cookedPath, bool upload){
+	if(model->meshes.empty())
+		return;
+	
+	glm::vec3 *positions = arenaPush(&import->arena, glm::vec3, import->vertexCount);
+	for(u32 i = 0; i < import->vertexCount; i++)
+		positions[i] = glm::make_vec3(import->vertices + i * 8);
+	
+	// every level of every mesh, mesh * lodCount + level
+	u32 *lodFirstIndices = arenaPush(&import->arena, u32, model->meshes.size() * model->lodCount);
+	u32 *lodIndexCounts = arenaPush(&import->arena, u32, model->meshes.size() * model->lodCount);
+	buildModelLods(model, import, positions, lodFirstIndices, lodIndexCounts);
+	
+	// indices are relative to each mesh's baseVertex, so 16 bits are enough as long as every mesh has fewer than 65536 vertices
+	// (one EBO means one index type for the whole model)
+	bool shortIndices = true;
+	for(u32 i = 0; i < model->meshes.size(); i++){
+		if(model->meshes[i].vertexData.vertexCount >= 65536)
+			shortIndices = false;
+	}
+	
+	// positions are quantized across the whole model's bounds, every mesh is drawn with the same decode uniforms
+	// (packed here instead of by createVertexData so the cooked file gets exactly what's uploaded)
+	Vertex_Format format = createVertexFormat(modelPositionFormat, modelUVFormat, modelNormalFormat);
+	
+	u8 *packed = arenaPush(&import->arena, u8, import->vertexCount * format.stride);
+	packVertices(packed, import->vertices, import->vertexCount, &format);
+	
+	void *indices = import->indices;
+	GLenum indexType = GL_UNSIGNED_INT;
+	
+	if(shortIndices){
+		u16 *shorts = arenaPush(&import->arena, u16, import->indexCount);
+		for(u32 i = 0; i < import->indexCount; i++)
+			shorts[i] = import->indices[i];
+		
+		indices = shorts;
+		indexType = GL_UNSIGNED_SHORT;
+	}
+	
+	Bounds bounds = computeBounds(import->vertices, import->vertexCount, 8);
+	
+	if(upload){
+		uploadModelGeometry(model, packed, import->vertexCount, format, indices, import->indexCount, indexType, bounds, lodFirstIndices, lodIndexCounts);
+	} else {
+		// only described, that's all the cooked file needs
+		model->geometry.usingEBO = true;
+		model->geometry.vertexCount = import->vertexCount;
+		model->geometry.indicesCount = import->indexCount;
+		model->geometry.indexType = indexType;
+		model->geometry.indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+		model->geometry.format = format;
+		model->geometry.bounds = bounds;
+	}
+	
+	if(cookedKey)
+		writeCookedModel(model, import, cookedPath, cookedKey, packed, indices, positions, lodFirstIndices, lodIndexCounts);
+	
+	if(model->cpuData & MODEL_CPU_PICKING){
+		model->positions.assign(positions, positions + import->vertexCount);
+		model->indices.assign(import->indices, import->indices + import->indexCount);
+	}
+	
+	if(model->cpuData & MODEL_CPU_VERTICES)
+		model->vertices.assign(import->vertices, import->vertices + import->vertexCount * 8);
 }
 
-void bindAssimpTexturesToMaterial(Material *material, aiMaterial *assimpMat, aiTextureType type, int intType, std::string modelDirectory){
-	for(unsigned int i = 0; i < assimpMat->GetTextureCount(type); i++){
-		aiString path;
-		assimpMat->GetTexture(type, i, &path);
+// put the model's packed vertices/indices into the mesh pool and group the meshes into one draw per material
+// (meshes, materials and nodes have to be there already, the lod arrays are mesh * lodCount + level)
+// batches span nodes, node matrices are instance attributes (nodeInstances) filled in by updateModel
+static void uploadModelGeometry(Model *model, void *vertices, u32 vertexCount, Vertex_Format format, void *indices, u32 indexCount, GLenum indexType, Bounds bounds, u32 *lodFirstIndices, u32 *lodIndexCounts){
+	model->geometry = createPackedVertexData(vertices, vertexCount, format, indices, indexCount, indexType, bounds);
+	
+	// point each mesh at the shared buffers
+	for(u32 i = 0; i < model->meshes.size(); i++){
+		Vertex_Data *vertexData = &model->meshes[i].vertexData;
 		
-		bool usedCached = false;
-		for(unsigned int j = 0; j < textureCache.size(); j++){
-			if(strcmp( textureCache[j].path.c_str(), (modelDirectory + "/" + path.C_Str()).c_str() ) == 0){
-				bindTextureToMaterial(material, &textureCache[j], intType);
-				usedCached = true;
-				break;
-			}
+		vertexData->VAO = model->geometry.VAO;
+		vertexData->VBO = model->geometry.VBO;
+		vertexData->EBO = model->geometry.EBO;
+		vertexData->allocation = model->geometry.allocation;
+		vertexData->format = model->geometry.format;
+		vertexData->indexType = model->geometry.indexType;
+		vertexData->indexSize = model->geometry.indexSize;
+	}
+	
+	// batches address the pool page directly (mesh offsets + where the model's ranges start)
+	model->poolGeneration = getMeshPoolGeneration();
+	model->poolBaseVertex = getMeshBaseVertex(model->geometry.allocation);
+	model->poolIndexOffset = getMeshIndexOffset(model->geometry.allocation);
+	
+	model->nodeInstances = createInstanceData(&model->geometry, model->nodeParents.size());
+	
+	// batches, one per material (meshes are added node by node, so within a batch a node's meshes are still contiguous)
+	std::vector<s32> batchOfMaterial(model->materials.size(), -1);
+	
+	for(u32 i = 0; i < model->meshes.size(); i++){
+		u32 material = model->meshMaterials[i];
+		
+		if(batchOfMaterial[material] < 0){
+			Model_Batch batch;
+			batch.material = material;
+			batch.lods.resize(model->lodCount);
+			batch.bounds = model->meshes[i].vertexData.bounds;
+			
+			for(u32 j = 0; j < model->lodCount; j++)
+				batch.lods[j].indirectOffset = 0;
+			
+			batchOfMaterial[material] = model->batches.size();
+			model->batches.push_back(batch);
 		}
 		
-		if(!usedCached){
-			Texture_Data texture = createTexture( (modelDirectory + "/" + path.C_Str()).c_str(), intType == 0 );
-			textureCache.push_back(texture);
+		Model_Batch *batch = &model->batches[batchOfMaterial[material]];
+		Vertex_Data *vertexData = &model->meshes[i].vertexData;
+		
+		batch->bounds = mergeBounds(batch->bounds, vertexData->bounds);
+		batch->meshes.push_back(i);
+		batch->baseVertices.push_back(model->poolBaseVertex + vertexData->baseVertex);
+		
+		for(u32 j = 0; j < model->lodCount; j++){
+			batch->lods[j].counts.push_back(lodIndexCounts[i * model->lodCount + j]);
+			batch->lods[j].offsets.push_back((const void*)(model->poolIndexOffset + lodFirstIndices[i * model->lodCount + j] * model->geometry.indexSize));
+		}
+	}
+	
+	uploadModelCommands(model);
+}
+
+// same draws as indirect commands, so a batch is one call without passing the arrays every time
+// each command's base instance is its mesh's node, without base instances drawModelBatch splits batches by node instead
+static void uploadModelCommands(Model *model){
+	if(glExtensions.multiDrawIndirect && glExtensions.baseInstance){
+		std::vector<DrawElementsIndirectCommand> commands;
+		
+		for(u32 i = 0; i < model->batches.size(); i++){
+			Model_Batch *batch = &model->batches[i];
 			
-			bindTextureToMaterial(material, &texture, intType);
+			for(u32 j = 0; j < model->lodCount; j++){
+				Model_Batch_Lod *lod = &batch->lods[j];
+				lod->indirectOffset = commands.size() * sizeof(DrawElementsIndirectCommand);
+				
+				for(u32 k = 0; k < lod->counts.size(); k++){
+					DrawElementsIndirectCommand command;
+					command.count = lod->counts[k];
+					command.instanceCount = 1;
+					command.firstIndex = (u32)((u64)lod->offsets[k] / model->geometry.indexSize);
+					command.baseVertex = batch->baseVertices[k];
+					command.baseInstance = model->meshNodes[batch->meshes[k]];
+					
+					commands.push_back(command);
+				}
+			}
 		}
+		
+		if(!model->indirectBuffer)
+			glGenBuffers(1, &model->indirectBuffer);
+		
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, model->indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
 	}
 }
 
-// updates the position of all contained meshes (NOTE: do NOT call updateObjectData on a mesh if it is within a model!)
-void updateModel(Model *model){
-	for(unsigned int i = 0; i < model->meshes.size(); i++){
-		glm::vec3 tempPosition = model->meshes[i].position;
-		glm::vec3 tempRotation = model->meshes[i].rotation;
-		glm::vec3 tempScale = model->meshes[i].scale;
+// the pool was compacted since the batches were built, shift them by however far the model's ranges moved
+static void rebaseModelBatches(Model *model){
+	model->poolGeneration = getMeshPoolGeneration();
+	
+	s32 baseVertex = getMeshBaseVertex(model->geometry.allocation);
+	u64 indexOffset = getMeshIndexOffset(model->geometry.allocation);
+	
+	if(baseVertex == model->poolBaseVertex && indexOffset == model->poolIndexOffset)
+		return;
+	
+	for(u32 i = 0; i < model->batches.size(); i++){
+		Model_Batch *batch = &model->batches[i];
+		
+		for(u32 j = 0; j < batch->baseVertices.size(); j++)
+			batch->baseVertices[j] += baseVertex - model->poolBaseVertex;
+		
+		for(u32 j = 0; j < batch->lods.size(); j++){
+			for(u32 k = 0; k < batch->lods[j].offsets.size(); k++)
+				batch->lods[j].offsets[k] = (const void*)((u64)batch->lods[j].offsets[k] - model->poolIndexOffset + indexOffset);
+		}
+	}
+	
+	model->poolBaseVertex = baseVertex;
+	model->poolIndexOffset = indexOffset;
+	
+	uploadModelCommands(model);
+}
+
+// COOKED MODELS //
+
+// hash of what a cooked file was built from, 0 if the source doesn't exist
+// (only the source's size and time are checked, an edited .mtl needs the cooked file deleted, and not its path,
+// so the cooker can reach it through a different one)
+u64 cookedModelKey(std::string path){
+	u64 size, modified;
+	if(!file_info(path.c_str(), &size, &modified))
+		return 0;
+	
+	u32 settings[] = {COOKED_MODEL_VERSION, modelPositionFormat, modelUVFormat, modelNormalFormat};
+	float maxError = MODEL_LOD_MAX_ERROR;
+	
+	u64 key = hashData(&size, sizeof(size));
+	key = hashData(&modified, sizeof(modified), key);
+	key = hashData(settings, sizeof(settings), key);
+	key = hashData(&maxError, sizeof(maxError), key);
+	
+	return key;
+}
+
+// a section has to be inside the file and hold exactly what the header says
+static bool validCookedSection(Cooked_Section *section, u64 fileSize, u64 expectedSize){
+	return section->offset <= fileSize && section->size <= fileSize - section->offset && section->size == expectedSize;
+}
+
+// every range in the file has to stay inside the geometry, and parents come before their children
+// (sections are already known to be in the file and the right size)
+static bool validCookedContents(Cooked_Model_Header *header, u8 *file){
+	Cooked_Node *nodes = (Cooked_Node*)(file + header->nodes.offset);
+	for(u32 i = 0; i < header->nodeCount; i++){
+		if(nodes[i].parent < -1 || nodes[i].parent >= (s32)i || nodes[i].subtreeSize == 0 || nodes[i].subtreeSize > header->nodeCount - i)
+			return false;
+	}
+	
+	Cooked_Mesh *meshes = (Cooked_Mesh*)(file + header->meshes.offset);
+	for(u32 i = 0; i < header->meshCount; i++){
+		if((u64)meshes[i].baseVertex + meshes[i].vertexCount > header->vertexCount || (u64)meshes[i].firstIndex + meshes[i].indexCount > header->indexCount || meshes[i].node >= header->nodeCount)
+			return false;
+	}
+	
+	u32 *lodFirstIndices = (u32*)(file + header->lodFirstIndices.offset);
+	u32 *lodIndexCounts = (u32*)(file + header->lodIndexCounts.offset);
+	for(u32 i = 0; i < header->meshCount * header->lodCount; i++){
+		if((u64)lodFirstIndices[i] + lodIndexCounts[i] > header->indexCount)
+			return false;
+	}
+	
+	return true;
+}
+
+// fill model from a cooked file, the vertices/indices are copied into the pool straight from the mapping
+// returns false if there's no usable file (nothing is added to the model then)
+static bool loadCookedModel(Model *model, std::string cookedPath, u64 key){
+	u64 size;
+	u8 *file = (u8*)map_file(cookedPath.c_str(), &size);
+	
+	if(!file)
+		return false;
+	
+	Cooked_Model_Header *header = (Cooked_Model_Header*)file;
+	
+	bool valid = size >= sizeof(Cooked_Model_Header) && header->magic == COOKED_MODEL_MAGIC && header->version == COOKED_MODEL_VERSION && header->key == key;
+	Vertex_Format format;
+	
+	if(valid){
+		format = createVertexFormat(header->positionFormat, header->uvFormat, header->normalFormat);
+		u32 indexSize = header->indexType == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
+		u32 lodEntries = header->meshCount * header->lodCount;
+		
+		valid = header->lodCount >= model->lodCount && header->meshCount > 0 && header->nodeCount > 0 &&
+			validCookedSection(&header->vertices, size, (u64)header->vertexCount * format.stride) &&
+			validCookedSection(&header->indices, size, (u64)header->indexCount * indexSize) &&
+			validCookedSection(&header->positions, size, (u64)header->vertexCount * sizeof(glm::vec3)) &&
+			validCookedSection(&header->meshes, size, (u64)header->meshCount * sizeof(Cooked_Mesh)) &&
+			validCookedSection(&header->lodFirstIndices, size, (u64)lodEntries * sizeof(u32)) &&
+			validCookedSection(&header->lodIndexCounts, size, (u64)lodEntries * sizeof(u32)) &&
+			validCookedSection(&header->lodErrors, size, (u64)header->lodCount * sizeof(float)) &&
+			validCookedSection(&header->nodes, size, (u64)header->nodeCount * sizeof(Cooked_Node)) &&
+			validCookedSection(&header->textures, size, (u64)header->textureCount * sizeof(Cooked_Texture)) &&
+			validCookedSection(&header->strings, size, header->strings.size) && header->strings.size > 0 && file[header->strings.offset + header->strings.size - 1] == 0 &&
+			validCookedContents(header, file);
+	}
+	
+	if(!valid){
+		printf("stale cooked model %s, reimporting\n", cookedPath.c_str());
+		unmap_file(file, size);
+		return false;
+	}
+	
+	const char *strings = (const char*)(file + header->strings.offset);
+	
+	// materials, with their textures bound before meshes take copies of them
+	for(u32 i = 0; i < header->materialCount; i++)
+		model->materials.push_back(createMaterial(glm::vec3(1.0f, 1.0f, 1.0f), 64, 1.0));
+	
+	Cooked_Texture *textures = (Cooked_Texture*)(file + header->textures.offset);
+	for(u32 i = 0; i < header->textureCount; i++){
+		if(textures[i].material < model->materials.size() && textures[i].path < header->strings.size)
+			bindModelTexture(&model->materials[textures[i].material], model->path + "/" + (strings + textures[i].path), textures[i].type);
+	}
+	
+	// node hierarchy
+	Cooked_Node *nodes = (Cooked_Node*)(file + header->nodes.offset);
+	for(u32 i = 0; i < header->nodeCount; i++){
+		model->nodeNames.push_back(nodes[i].name < header->strings.size ? strings + nodes[i].name : "");
+		model->nodeParents.push_back(nodes[i].parent);
+		model->nodeSubtreeSizes.push_back(nodes[i].subtreeSize);
+		model->nodeLocalMatrices.push_back(glm::make_mat4(nodes[i].localMatrix));
+		model->nodeWorldMatrices.push_back(glm::mat4(1.0f));
+		model->nodeNormalMatrices.push_back(glm::mat3(1.0f));
+		model->nodeDirty.push_back(1);
+		model->dirtyNodes++;
+	}
+	
+	// meshes (buffers are filled in by uploadModelGeometry, like after an import)
+	Cooked_Mesh *meshes = (Cooked_Mesh*)(file + header->meshes.offset);
+	for(u32 i = 0; i < header->meshCount; i++){
+		u32 material = meshes[i].material < model->materials.size() ? meshes[i].material : 0;
+		
+		Vertex_Data vertexData = Vertex_Data();
+		
+		vertexData.usingEBO = true;
+		vertexData.baseVertex = meshes[i].baseVertex;
+		vertexData.firstIndex = meshes[i].firstIndex;
+		vertexData.vertexCount = meshes[i].vertexCount;
+		vertexData.indicesCount = meshes[i].indexCount;
+		vertexData.bounds = meshes[i].bounds;
+		vertexData.allocation = -1;
+		
+		model->meshes.push_back(createObjectData(&vertexData, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), glm::vec3(1, 1, 1), &model->materials[material]));
+		model->meshMaterials.push_back(material);
+		model->meshNodes.push_back(meshes[i].node);
+	}
+	
+	float *lodErrors = (float*)(file + header->lodErrors.offset);
+	model->lodErrors.assign(lodErrors, lodErrors + model->lodCount);
+	
+	u32 *lodFirstIndices = (u32*)(file + header->lodFirstIndices.offset);
+	u32 *lodIndexCounts = (u32*)(file + header->lodIndexCounts.offset);
+	
+	// cooked with more levels than this load wants, the rest stay in the EBO unused
+	std::vector<u32> firstIndices, indexCounts;
+	
+	if(header->lodCount > model->lodCount){
+		for(u32 i = 0; i < header->meshCount; i++){
+			for(u32 level = 0; level < model->lodCount; level++){
+				firstIndices.push_back(lodFirstIndices[i * header->lodCount + level]);
+				indexCounts.push_back(lodIndexCounts[i * header->lodCount + level]);
+			}
+		}
 		
-		model->meshes[i].position += model->position;
-		model->meshes[i].rotation += model->rotation;
-		model->meshes[i].scale *= model->scale;
+		lodFirstIndices = firstIndices.data();
+		lodIndexCounts = indexCounts.data();
+	}
+	
+	format.positionOffset = glm::make_vec3(header->positionOffset);
+	format.positionScale = glm::make_vec3(header->positionScale);
 	
-		updateObjectData(&model->meshes[i]);
+	uploadModelGeometry(model, file + header->vertices.offset, header->vertexCount, format, file + header->indices.offset, header->indexCount, header->indexType, header->bounds, lodFirstIndices, lodIndexCounts);
+	
+	if(model->cpuData & MODEL_CPU_PICKING){
+		glm::vec3 *positions = (glm::vec3*)(file + header->positions.offset);
+		model->positions.assign(positions, positions + header->vertexCount);
 		
-		model->meshes[i].position = tempPosition;
-		model->meshes[i].rotation = tempRotation;
-		model->meshes[i].scale = tempScale;
+		if(header->indexType == GL_UNSIGNED_SHORT){
+			u16 *shorts = (u16*)(file + header->indices.offset);
+			model->indices.assign(shorts, shorts + header->indexCount);
+		} else {
+			u32 *indices = (u32*)(file + header->indices.offset);
+			model->indices.assign(indices, indices + header->indexCount);
+		}
 	}
+	
+	unmap_file(file, size);
+	
+	return true;
 }
 
-void drawModel(Model *model, Camera *camera, ShaderProgram *program){
-	useShader(program);
+// append a section to the file being cooked
+static Cooked_Section addCookedSection(std::vector<u8> *file, const void *data, u64 size){
+	Cooked_Section section;
+	section.offset = (file->size() + COOKED_MODEL_ALIGNMENT - 1) / COOKED_MODEL_ALIGNMENT * COOKED_MODEL_ALIGNMENT;
+	section.size = size;
+	
+	file->resize(section.offset + size, 0);
 	
-	setUniformMat4(*program, "projection", camera->projection);
-	setUniformMat4(*program, "view", camera->view);
+	if(size > 0)
+		memcpy(file->data() + section.offset, data, size);
 	
-	for(unsigned int i = 0; i < model->meshes.size(); i++){
-		/*Object_Data *object = &model->meshes[i];
+	return section;
+}
+
+// offset of a new string in strings
+static u32 addCookedString(std::vector<char> *strings, const char *string){
+	u32 offset = strings->size();
+	strings->insert(strings->end(), string, string + strlen(string) + 1);
+	
+	return offset;
+}
+
+// write what was just built for model, vertices/indices in the model's geometry format
+static void writeCookedModel(Model *model, Model_Import *import, std::string cookedPath, u64 key, void *vertices, void *indices, glm::vec3 *positions, u32 *lodFirstIndices, u32 *lodIndexCounts){
+	Vertex_Data *geometry = &model->geometry;
+	u32 meshCount = model->meshes.size();
+	u32 lodEntries = meshCount * model->lodCount;
+	
+	Cooked_Model_Header header = Cooked_Model_Header();
+	
+	header.magic = COOKED_MODEL_MAGIC;
+	header.version = COOKED_MODEL_VERSION;
+	header.key = key;
+	header.vertexCount = geometry->vertexCount;
+	header.indexCount = geometry->indicesCount;
+	header.indexType = geometry->indexType;
+	header.meshCount = meshCount;
+	header.nodeCount = model->nodeParents.size();
+	header.materialCount = model->materials.size();
+	header.lodCount = model->lodCount;
+	header.positionFormat = geometry->format.position;
+	header.uvFormat = geometry->format.uv;
+	header.normalFormat = geometry->format.normal;
+	memcpy(header.positionOffset, &geometry->format.positionOffset.x, sizeof(header.positionOffset));
+	memcpy(header.positionScale, &geometry->format.positionScale.x, sizeof(header.positionScale));
+	header.bounds = geometry->bounds;
+	
+	std::vector<char> strings;
+	
+	std::vector<Cooked_Mesh> meshes(meshCount);
+	for(u32 i = 0; i < meshCount; i++){
+		Vertex_Data *vertexData = &model->meshes[i].vertexData;
 		
-		setUniformMat4(*program, "model", object->modelMatrix);
+		meshes[i].baseVertex = vertexData->baseVertex;
+		meshes[i].vertexCount = vertexData->vertexCount;
+		meshes[i].firstIndex = vertexData->firstIndex;
+		meshes[i].indexCount = vertexData->indicesCount;
+		meshes[i].material = model->meshMaterials[i];
+		meshes[i].node = model->meshNodes[i];
+		meshes[i].bounds = vertexData->bounds;
+	}
+	
+	std::vector<Cooked_Node> nodes(header.nodeCount);
+	for(u32 i = 0; i < header.nodeCount; i++){
+		nodes[i].parent = model->nodeParents[i];
+		nodes[i].subtreeSize = model->nodeSubtreeSizes[i];
+		nodes[i].name = addCookedString(&strings, model->nodeNames[i].c_str());
+		memcpy(nodes[i].localMatrix, &model->nodeLocalMatrices[i][0][0], sizeof(nodes[i].localMatrix));
+	}
+	
+	std::vector<Cooked_Texture> textures(import->textures.size());
+	for(u32 i = 0; i < textures.size(); i++){
+		textures[i].material = import->textures[i].material;
+		textures[i].type = import->textures[i].type;
+		textures[i].path = addCookedString(&strings, import->textures[i].path.c_str());
+	}
+	
+	header.textureCount = textures.size();
+	
+	// the header goes in last, once every section's place is known
+	std::vector<u8> file(sizeof(Cooked_Model_Header), 0);
+	
+	header.vertices = addCookedSection(&file, vertices, (u64)header.vertexCount * geometry->format.stride);
+	header.indices = addCookedSection(&file, indices, (u64)header.indexCount * geometry->indexSize);
+	header.positions = addCookedSection(&file, positions, (u64)header.vertexCount * sizeof(glm::vec3));
+	header.meshes = addCookedSection(&file, meshes.data(), meshes.size() * sizeof(Cooked_Mesh));
+	header.lodFirstIndices = addCookedSection(&file, lodFirstIndices, lodEntries * sizeof(u32));
+	header.lodIndexCounts = addCookedSection(&file, lodIndexCounts, lodEntries * sizeof(u32));
+	header.lodErrors = addCookedSection(&file, model->lodErrors.data(), model->lodErrors.size() * sizeof(float));
+	header.nodes = addCookedSection(&file, nodes.data(), nodes.size() * sizeof(Cooked_Node));
+	header.textures = addCookedSection(&file, textures.data(), textures.size() * sizeof(Cooked_Texture));
+	header.strings = addCookedSection(&file, strings.data(), strings.size());
 	
-		setUniformMat3(*program, "normalMatrix", glm::mat3(glm::transpose(glm::inverse(object->modelMatrix))) );
+	memcpy(file.data(), &header, sizeof(header));
 	
-		setUniformMaterial(&object->material, *program);
+	if(write_binary_file(cookedPath.c_str(), file.data(), file.size()))
+		printf("cooked %s (%.1f KB)\n", cookedPath.c_str(), file.size() / 1024.0f);
+	else
+		printf("couldn't write cooked model %s\n", cookedPath.c_str());
+}
+
+// TEXTURES //
+
+// bind the texture at path to material, loading it unless a model already did
+static void bindModelTexture(Material *material, std::string path, int intType){
+	for(u32 i = 0; i < textureCache.size(); i++){
+		if(strcmp(textureCache[i].path.c_str(), path.c_str()) == 0){
+			bindTextureToMaterial(material, &textureCache[i], intType);
+			return;
+		}
+	}
+	
+	Texture_Data texture = createTexture(path.c_str(), intType == 0);
+	textureCache.push_back(texture);
+	
+	bindTextureToMaterial(material, &texture, intType);
+}
+
+// note down a material's textures of one type for the cooked file, and bind them if load
+static void importAssimpTextures(Model_Import *import, Material *material, u32 materialIndex, aiMaterial *assimpMat, aiTextureType type, int intType, std::string modelDirectory, bool load){
+	for(unsigned int i = 0; i < assimpMat->GetTextureCount(type); i++){
+		aiString path;
+		assimpMat->GetTexture(type, i, &path);
 		
-		char locationBuffer[64];
-		int currentTexture = 0;
+		Model_Texture_Reference reference;
+		reference.material = materialIndex;
+		reference.type = intType;
+		reference.path = path.C_Str();
 		
-		// bind textures
-		for(int i = 0; i < object->material.diffuseCount || 0; i++){
-			glActiveTexture(GL_TEXTURE0 + currentTexture);
-			glBindTexture(GL_TEXTURE_2D, object->material.diffuseMaps[i]);
-			
-			strcpy(locationBuffer, "");
-			sprintf(locationBuffer, "material.diffuseMaps[%d]", i);
-			setUniformInt(*program, locationBuffer, currentTexture);
-			
-			currentTexture++;
+		import->textures.push_back(reference);
+		
+		if(load)
+			bindModelTexture(material, modelDirectory + "/" + path.C_Str(), intType);
+	}
+}
+
+void bindAssimpTexturesToMaterial(Material *material, aiMaterial *assimpMat, aiTextureType type, int intType, std::string modelDirectory){
+	for(unsigned int i = 0; i < assimpMat->GetTextureCount(type); i++){
+		aiString path;
+		assimpMat->GetTexture(type, i, &path);
+		
+		bindModelTexture(material, modelDirectory + "/" + path.C_Str(), intType);
+	}
+}
+
+// index of the first node called name, -1 if there's none
+s32 findModelNode(Model *model, const char* name){
+	for(u32 i = 0; i < model->nodeNames.size(); i++){
+		if(strcmp(model->nodeNames[i].c_str(), name) == 0)
+			return i;
+	}
+	
+	return -1;
+}
+
+// move a node relative to its parent, its subtree gets new world matrices on the next updateModel
+void setModelNodeTransform(Model *model, u32 node, glm::mat4 localMatrix){
+	model->nodeLocalMatrices[node] = localMatrix;
+	
+	if(!model->nodeDirty[node]){
+		model->nodeDirty[node] = 1;
+		model->dirtyNodes++;
+	}
+}
+
+// new node matrices for the batches to draw with and their world space bounds (after world matrices changed)
+static void updateModelBatches(Model *model){
+	Instance_Data *instances = &model->nodeInstances;
+	
+	if(instances->VAO){
+		instances->transforms.resize(model->nodeParents.size());
+		
+		for(u32 i = 0; i < model->nodeParents.size(); i++){
+			instances->transforms[i].modelMatrix = model->nodeWorldMatrices[i];
+			instances->transforms[i].normalMatrix = model->nodeNormalMatrices[i];
 		}
 		
-		// bind specular maps
-		for(int i = 0; i < object->material.specularCount; i++){
-			glActiveTexture(GL_TEXTURE0 + currentTexture);
-			glBindTexture(GL_TEXTURE_2D, object->material.specularMaps[i]);
-			
-			strcpy(locationBuffer, "");
-			sprintf(locationBuffer, "material.specularMaps[%d]", i);
-			setUniformInt(*program, locationBuffer, currentTexture);
+		updateInstanceData(instances);
+	}
+	
+	for(u32 i = 0; i < model->batches.size(); i++){
+		Model_Batch *batch = &model->batches[i];
+		
+		for(u32 j = 0; j < batch->meshes.size(); j++){
+			u32 mesh = batch->meshes[j];
+			Bounds bounds = transformBounds(model->meshes[mesh].vertexData.bounds, model->nodeWorldMatrices[model->meshNodes[mesh]]);
 			
-			currentTexture++;
+			batch->bounds = j == 0 ? bounds : mergeBounds(batch->bounds, bounds);
+		}
+	}
+}
+
+// rebuild the model matrix if position/rotation/scale changed and the world matrices of every dirty subtree
+// (NOTE: do NOT call updateObjectData on a mesh if it is within a model, meshes are placed by their node)
+void updateModel(Model *model){
+	if(updateTransform(&model->transformCache, model->position, model->rotation, model->scale, &model->modelMatrix, &model->normalMatrix)){
+		// everything hangs off the model matrix
+		if(!model->nodeDirty.empty() && !model->nodeDirty[0]){
+			model->nodeDirty[0] = 1;
+			model->dirtyNodes++;
+		}
+	}
+	
+	if(model->dirtyNodes == 0)
+		return;
+	
+	u32 nodeCount = model->nodeParents.size();
+	
+	for(u32 i = 0; i < nodeCount;){
+		if(!model->nodeDirty[i]){
+			i++;
+			continue;
 		}
 		
-		// bind emission maps
-		for(int i = 0; i < object->material.emissionCount || 0; i++){
-			glActiveTexture(GL_TEXTURE0 + currentTexture);
-			glBindTexture(GL_TEXTURE_2D, object->material.emissionMaps[i]);
-			
-			strcpy(locationBuffer, "");
-			sprintf(locationBuffer, "material.emissionMaps[%d]", i);
-			setUniformInt(*program, locationBuffer, currentTexture);
+		// parents come first, so walking the subtree in order always sees an up to date parent
+		u32 end = i + model->nodeSubtreeSizes[i];
+		
+		for(u32 j = i; j < end; j++){
+			s32 parent = model->nodeParents[j];
+			glm::mat4 parentMatrix = parent < 0 ? model->modelMatrix : model->nodeWorldMatrices[parent];
 			
-			currentTexture++;
+			model->nodeWorldMatrices[j] = parentMatrix * model->nodeLocalMatrices[j];
+			model->nodeNormalMatrices[j] = glm::transpose(glm::inverse(glm::mat3(model->nodeWorldMatrices[j])));
+			model->nodeDirty[j] = 0;
 		}
 		
-		drawVertexData(object->vertexData, program);*/
+		i = end;
+	}
+	
+	model->dirtyNodes = 0;
+	
+	updateModelBatches(model);
+}
+
+// lowest level whose threshold the projected size is still under
+static u32 lodForScreenSize(Model *model, float screenSize){
+	u32 lod = 0;
+	float threshold = MODEL_LOD_SCREEN_SIZE;
+	
+	while(lod + 1 < model->lodCount && screenSize < threshold){
+		lod++;
+		threshold *= 0.5f;
+	}
+	
+	return lod;
+}
+
+// pick the level drawn from now on by how big the model is on screen (call after updateModel, once per frame)
+// the size has to move MODEL_LOD_HYSTERESIS past a threshold before the level changes, so it doesn't flicker
+// between two levels when the camera sits right at the threshold
+u32 selectModelLod(Model *model, Camera *camera){
+	if(model->lodCount <= 1 || model->batches.empty())
+		return model->lod = 0;
+	
+	// world space bounds of the whole model
+	Bounds bounds = model->batches[0].bounds;
+	for(u32 i = 1; i < model->batches.size(); i++)
+		bounds = mergeBounds(bounds, model->batches[i].bounds);
+	
+	float distance = glm::length(bounds.center - camera->position);
+	
+	// inside the bounds, always full detail
+	if(distance <= bounds.radius)
+		return model->lod = 0;
+	
+	// projected radius as a fraction of half the screen height (projection[1][1] = 1 / tan(fov / 2))
+	float screenSize = bounds.radius * camera->projection[1][1] / distance;
+	
+	u32 finest = lodForScreenSize(model, screenSize * (1.0f + MODEL_LOD_HYSTERESIS));
+	u32 coarsest = lodForScreenSize(model, screenSize * (1.0f - MODEL_LOD_HYSTERESIS));
+	
+	if(model->lod < finest)
+		model->lod = finest;
+	else if(model->lod > coarsest)
+		model->lod = coarsest;
+	
+	return model->lod;
+}
+
+// issue the draws of one batch at the model's current level (an INSTANCED program and the material have to be set already)
+void drawModelBatch(Model *model, u32 batch){
+	Model_Batch *modelBatch = &model->batches[batch];
+	Model_Batch_Lod *lod = &modelBatch->lods[model->lod];
+	
+	if(model->poolGeneration != getMeshPoolGeneration())
+		rebaseModelBatches(model);
+	
+	if(model->indirectBuffer){
+		stateBindVertexArray(model->nodeInstances.VAO);
 		
-		drawObjectData(&model->meshes[i], camera, program);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, model->indirectBuffer);
+		extMultiDrawElementsIndirect(GL_TRIANGLES, model->geometry.indexType, (const void*)(u64)lod->indirectOffset, lod->counts.size(), 0);
+		return;
 	}
-}
\ No newline at end of file
+	
+	// no base instance, one multi draw per run of meshes from the same node with the instance attributes moved to it
+	u32 count = lod->counts.size();
+	
+	for(u32 first = 0; first < count;){
+		u32 node = model->meshNodes[modelBatch->meshes[first]];
+		
+		u32 end = first + 1;
+		while(end < count && model->meshNodes[modelBatch->meshes[end]] == node)
+			end++;
+		
+		setInstanceBase(&model->nodeInstances, node);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, lod->counts.data() + first, model->geometry.indexType, lod->offsets.data() + first, end - first, modelBatch->baseVertices.data() + first);
+		
+		first = end;
+	}
+}
+
+// one multi draw per material, program has to be an INSTANCED variant (node matrices come from nodeInstances)
+void drawModel(Model *model, Camera *camera, ShaderProgram *program){
+	useShader(program);
+	
+	for(u32 i = 0; i < model->batches.size(); i++){
+		setUniformVertexFormat(program, &model->geometry.format);
+		bindMaterial(&model->materials[model->batches[i].material], program);
+		
+		drawModelBatch(model, i);
+	}
+}
+
+// same, with the variant each material needs
+void drawModel(Model *model, Camera *camera, ShaderPermutations *permutations){
+	for(u32 i = 0; i < model->batches.size(); i++){
+		Material *material = &model->materials[model->batches[i].material];
+		ShaderProgram *program = getShaderVariant(permutations, getShaderVariantKey(material, permutations->shadowMode, SHADER_FEATURE_INSTANCED));
+		
+		useShader(program);
+		setUniformVertexFormat(program, &model->geometry.format);
+		bindMaterial(material, program);
+		
+		drawModelBatch(model, i);
+	}
+}
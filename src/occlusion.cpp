@@ -0,0 +1,318 @@
+// software occlusion culling, a few big occluders are rasterized into a small depth buffer on the cpu
+// and bounds are tested against it, anything completely behind the occluders doesn't need to be drawn
+
+#include <occlusion.h>
+#include <jobs.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+void initOcclusionBuffer(Occlusion_Buffer *buffer, u32 width, u32 height){
+	buffer->width = (width + 3) & ~3; // 4 pixels at a time
+	buffer->height = height;
+	buffer->depth.assign(buffer->width * buffer->height, 1.0f);
+	buffer->viewProjection = glm::mat4(1.0f);
+	buffer->triangles.clear();
+	
+	memset(&buffer->stats, 0, sizeof(buffer->stats));
+}
+
+// start a new frame seen through viewProjection (forgets last frame's occluders and stats)
+void beginOcclusion(Occlusion_Buffer *buffer, glm::mat4 viewProjection){
+	buffer->viewProjection = viewProjection;
+	buffer->triangles.clear();
+	
+	memset(&buffer->stats, 0, sizeof(buffer->stats));
+}
+
+// OCCLUDERS //
+
+// clip space to buffer pixels + 0..1 depth
+static glm::vec3 toScreen(Occlusion_Buffer *buffer, glm::vec4 clip){
+	glm::vec3 ndc = glm::vec3(clip) / clip.w;
+	
+	return glm::vec3((ndc.x * 0.5f + 0.5f) * buffer->width, (ndc.y * 0.5f + 0.5f) * buffer->height, ndc.z * 0.5f + 0.5f);
+}
+
+static void addScreenTriangle(Occlusion_Buffer *buffer, glm::vec3 a, glm::vec3 b, glm::vec3 c){
+	// counter clockwise is front facing (same as gl), back faces are always behind a front face of a closed occluder
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if(area <= 0.0f)
+		return;
+	
+	Occlusion_Triangle triangle;
+	triangle.vertices[0] = a;
+	triangle.vertices[1] = b;
+	triangle.vertices[2] = c;
+	
+	buffer->triangles.push_back(triangle);
+	buffer->stats.triangles++;
+}
+
+// clip a clip space triangle against the near plane (z > -w), the others are handled by clamping to the buffer
+static void addClipTriangle(Occlusion_Buffer *buffer, glm::vec4 *clip){
+	// completely outside one plane
+	for(u32 axis = 0; axis < 3; axis++){
+		if(clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w)
+			return;
+		if(clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+			return;
+	}
+	
+	float distance[3];
+	bool allInside = true;
+	
+	for(u32 i = 0; i < 3; i++){
+		distance[i] = clip[i].z + clip[i].w;
+		allInside = allInside && distance[i] >= 0.0f;
+	}
+	
+	if(allInside){
+		addScreenTriangle(buffer, toScreen(buffer, clip[0]), toScreen(buffer, clip[1]), toScreen(buffer, clip[2]));
+		return;
+	}
+	
+	// sutherland-hodgman against the one plane, at most 4 vertices come out
+	glm::vec4 polygon[4];
+	u32 count = 0;
+	
+	for(u32 i = 0; i < 3; i++){
+		u32 next = (i + 1) % 3;
+		
+		if(distance[i] >= 0.0f)
+			polygon[count++] = clip[i];
+		
+		if((distance[i] >= 0.0f) != (distance[next] >= 0.0f)){
+			float t = distance[i] / (distance[i] - distance[next]);
+			polygon[count++] = clip[i] + (clip[next] - clip[i]) * t;
+		}
+	}
+	
+	for(u32 i = 2; i < count; i++)
+		addScreenTriangle(buffer, toScreen(buffer, polygon[0]), toScreen(buffer, polygon[i - 1]), toScreen(buffer, polygon[i]));
+}
+
+// add triangles (positions are the first 3 floats of every stride floats, indices can be NULL for a plain list)
+// occluders should be simple and solid, anything drawn here hides whatever is behind it
+void addOccluder(Occlusion_Buffer *buffer, float *positions, u32 stride, u32 *indices, u32 triangleCount, glm::mat4 modelMatrix){
+	glm::mat4 matrix = buffer->viewProjection * modelMatrix;
+	
+	for(u32 i = 0; i < triangleCount; i++){
+		glm::vec4 clip[3];
+		
+		for(u32 j = 0; j < 3; j++){
+			u32 vertex = indices ? indices[i * 3 + j] : i * 3 + j;
+			clip[j] = matrix * glm::vec4(positions[vertex * stride], positions[vertex * stride + 1], positions[vertex * stride + 2], 1.0f);
+		}
+		
+		addClipTriangle(buffer, clip);
+	}
+	
+	buffer->stats.occluders++;
+}
+
+// a box (in modelMatrix's space) as an occluder, only use it for things that really fill their bounds (walls, floors)
+void addOccluderBox(Occlusion_Buffer *buffer, Bounds bounds, glm::mat4 modelMatrix){
+	float corners[8 * 3];
+	
+	for(u32 i = 0; i < 8; i++){
+		corners[i * 3 + 0] = bounds.center.x + ((i & 1) ? bounds.extents.x : -bounds.extents.x);
+		corners[i * 3 + 1] = bounds.center.y + ((i & 2) ? bounds.extents.y : -bounds.extents.y);
+		corners[i * 3 + 2] = bounds.center.z + ((i & 4) ? bounds.extents.z : -bounds.extents.z);
+	}
+	
+	// counter clockwise seen from outside
+	static u32 indices[] = {
+		0, 2, 3,  0, 3, 1, // -z
+		4, 5, 7,  4, 7, 6, // +z
+		0, 4, 6,  0, 6, 2, // -x
+		1, 3, 7,  1, 7, 5, // +x
+		0, 1, 5,  0, 5, 4, // -y
+		2, 6, 7,  2, 7, 3  // +y
+	};
+	
+	addOccluder(buffer, corners, 3, indices, 12, modelMatrix);
+}
+
+// RASTERIZATION //
+
+// every triangle is drawn into one band of rows per job, so jobs never touch the same pixels
+static void rasterizeBand(void *data, u32 band){
+	Occlusion_Buffer *buffer = (Occlusion_Buffer*)data;
+	
+	s32 bandStart = band * OCCLUSION_BAND_HEIGHT;
+	s32 bandEnd = std::min((s32)buffer->height, bandStart + OCCLUSION_BAND_HEIGHT);
+	s32 width = buffer->width;
+	
+	float *depth = buffer->depth.data();
+	std::fill(depth + bandStart * width, depth + bandEnd * width, 1.0f);
+	
+	for(u32 t = 0; t < buffer->triangles.size(); t++){
+		glm::vec3 *v = buffer->triangles[t].vertices;
+		
+		// pixel range (pixel centers are at +0.5), x starts at a multiple of 4
+		s32 minX = std::max(0, (s32)floorf(std::min(v[0].x, std::min(v[1].x, v[2].x))));
+		s32 maxX = std::min(width, (s32)ceilf(std::max(v[0].x, std::max(v[1].x, v[2].x))));
+		s32 minY = std::max(bandStart, (s32)floorf(std::min(v[0].y, std::min(v[1].y, v[2].y))));
+		s32 maxY = std::min(bandEnd, (s32)ceilf(std::max(v[0].y, std::max(v[1].y, v[2].y))));
+		
+		if(minX >= maxX || minY >= maxY)
+			continue;
+		
+		minX &= ~3;
+		
+		// edge functions e = a*x + b*y + c, positive inside, edge i is the one opposite vertex i
+		float a[3], b[3], c[3];
+		for(u32 i = 0; i < 3; i++){
+			glm::vec3 from = v[(i + 1) % 3];
+			glm::vec3 to = v[(i + 2) % 3];
+			
+			a[i] = from.y - to.y;
+			b[i] = to.x - from.x;
+			c[i] = -(a[i] * from.x + b[i] * from.y);
+		}
+		
+		// depth as a plane over the screen (barycentric weights are edge / area)
+		float area = a[0] * v[0].x + b[0] * v[0].y + c[0];
+		float depthA = (a[0] * v[0].z + a[1] * v[1].z + a[2] * v[2].z) / area;
+		float depthB = (b[0] * v[0].z + b[1] * v[1].z + b[2] * v[2].z) / area;
+		float depthC = (c[0] * v[0].z + c[1] * v[1].z + c[2] * v[2].z) / area;
+		
+		for(s32 y = minY; y < maxY; y++){
+			float *row = depth + y * width;
+			float pixelY = y + 0.5f;
+			
+#ifdef OCCLUSION_SSE
+			__m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			__m128 zero = _mm_setzero_ps();
+			
+			__m128 edgeA[3], edgeRow[3];
+			for(u32 i = 0; i < 3; i++){
+				edgeA[i] = _mm_set1_ps(a[i]);
+				edgeRow[i] = _mm_set1_ps(b[i] * pixelY + c[i]);
+			}
+			
+			__m128 depthX = _mm_set1_ps(depthA);
+			__m128 depthRow = _mm_set1_ps(depthB * pixelY + depthC);
+			
+			for(s32 x = minX; x < maxX; x += 4){
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), stepX);
+				
+				__m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA[0], pixelX), edgeRow[0]);
+				__m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA[1], pixelX), edgeRow[1]);
+				__m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA[2], pixelX), edgeRow[2]);
+				
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+				
+				if(_mm_movemask_ps(inside) == 0)
+					continue;
+				
+				__m128 pixelDepth = _mm_add_ps(_mm_mul_ps(depthX, pixelX), depthRow);
+				__m128 current = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(current, pixelDepth);
+				
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+#else
+			for(s32 x = minX; x < maxX; x++){
+				float pixelX = x + 0.5f;
+				
+				if(a[0] * pixelX + b[0] * pixelY + c[0] < 0.0f || a[1] * pixelX + b[1] * pixelY + c[1] < 0.0f || a[2] * pixelX + b[2] * pixelY + c[2] < 0.0f)
+					continue;
+				
+				float pixelDepth = depthA * pixelX + depthB * pixelY + depthC;
+				row[x] = std::min(row[x], pixelDepth);
+			}
+#endif
+		}
+	}
+}
+
+// draw this frame's occluders (spread over the job threads, one band of rows each)
+void rasterizeOcclusion(Occlusion_Buffer *buffer){
+	auto start = std::chrono::steady_clock::now();
+	
+	u32 bands = (buffer->height + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT;
+	runJobs(rasterizeBand, buffer, bands);
+	
+	buffer->stats.rasterizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// TESTING //
+
+// true if the world space box is completely behind what was rasterized (conservative, unsure means visible)
+bool isOccluded(Occlusion_Buffer *buffer, Bounds bounds){
+	buffer->stats.tested++;
+	
+	glm::vec3 minimum = glm::vec3(1e30f);
+	glm::vec3 maximum = glm::vec3(-1e30f);
+	
+	for(u32 i = 0; i < 8; i++){
+		glm::vec3 corner = bounds.center + glm::vec3((i & 1) ? bounds.extents.x : -bounds.extents.x, (i & 2) ? bounds.extents.y : -bounds.extents.y, (i & 4) ? bounds.extents.z : -bounds.extents.z);
+		glm::vec4 clip = buffer->viewProjection * glm::vec4(corner, 1.0f);
+		
+		// crosses the near plane, could be right in front of the camera
+		if(clip.z < -clip.w || clip.w <= 0.0f)
+			return false;
+		
+		glm::vec3 screen = toScreen(buffer, clip);
+		
+		minimum = glm::min(minimum, screen);
+		maximum = glm::max(maximum, screen);
+	}
+	
+	s32 width = buffer->width;
+	s32 minX = std::max(0, (s32)floorf(minimum.x)) & ~3;
+	s32 maxX = std::min(width, ((s32)ceilf(maximum.x) + 3) & ~3);
+	s32 minY = std::max(0, (s32)floorf(minimum.y));
+	s32 maxY = std::min((s32)buffer->height, (s32)ceilf(maximum.y));
+	
+	// off screen, not for this test to decide
+	if(minX >= maxX || minY >= maxY)
+		return false;
+	
+	// visible if any pixel of its rectangle has nothing in front of the box's nearest point
+	float nearest = minimum.z;
+	
+	for(s32 y = minY; y < maxY; y++){
+		float *row = buffer->depth.data() + y * width;
+		
+#ifdef OCCLUSION_SSE
+		__m128 boxDepth = _mm_set1_ps(nearest);
+		
+		for(s32 x = minX; x < maxX; x += 4){
+			if(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)))
+				return false;
+		}
+#else
+		for(s32 x = minX; x < maxX; x++){
+			if(row[x] >= nearest)
+				return false;
+		}
+#endif
+	}
+	
+	buffer->stats.occluded++;
+	
+	return true;
+}
+
+Occlusion_Stats *getOcclusionStats(Occlusion_Buffer *buffer){
+	return &buffer->stats;
+}
+
+void printOcclusionStats(Occlusion_Buffer *buffer){
+	Occlusion_Stats *stats = &buffer->stats;
+	
+	float ratio = stats->tested ? (float)stats->occluded / stats->tested * 100.0f : 0.0f;
+	
+	printf("occlusion: %u occluders (%u triangles) rasterized in %.3f ms, %u / %u tested occluded (%.1f%%)\n", stats->occluders, stats->triangles, stats->rasterizeTime, stats->occluded, stats->tested, ratio);
+}
@@ -0,0 +1,506 @@
+// render queue, draws are collected over the frame then sorted by state and issued together
+
+#include <renderqueue.h>
+#include <glstate.h>
+#include <culling.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define RENDER_KEY_OPAQUE_DEPTH_BITS 19
+#define RENDER_KEY_TRANSPARENT_DEPTH_BITS 24
+
+void initRenderQueue(Render_Queue *queue){
+	queue->items.clear();
+	queue->entries.clear();
+	queue->scratch.clear();
+	
+	for(u32 i = 0; i < MAX_RENDER_PASSES; i++)
+		queue->passes[i] = Render_Pass();
+	
+	memset(&queue->stats, 0, sizeof(queue->stats));
+}
+
+// set what the queue binds/clears before drawing the items of pass
+void setRenderPass(Render_Queue *queue, u32 pass, u32 framebuffer, s32 x, s32 y, s32 width, s32 height, GLbitfield clear, GLenum cullFace){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	Render_Pass *renderPass = &queue->passes[pass];
+	
+	renderPass->used = true;
+	renderPass->framebuffer = framebuffer;
+	renderPass->viewport[0] = x;
+	renderPass->viewport[1] = y;
+	renderPass->viewport[2] = width;
+	renderPass->viewport[3] = height;
+	renderPass->clear = clear;
+	renderPass->cullFace = cullFace;
+}
+
+// cull the items of pass against frustumPlanes from now on (copied), NULL turns culling off
+void setRenderPassFrustum(Render_Queue *queue, u32 pass, glm::vec4 *frustumPlanes){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	Render_Pass *renderPass = &queue->passes[pass];
+	
+	renderPass->culling = frustumPlanes != NULL;
+	
+	if(frustumPlanes)
+		memcpy(renderPass->frustumPlanes, frustumPlanes, sizeof(renderPass->frustumPlanes));
+}
+
+// test the items of pass against occlusion's depth buffer (has to be rasterized before drawRenderQueue), NULL turns it off
+void setRenderPassOcclusion(Render_Queue *queue, u32 pass, Occlusion_Buffer *occlusion){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	queue->passes[pass].occlusion = occlusion;
+}
+
+// distance along the camera's view direction, 0 at the camera and 1 at the far plane
+static float viewDepth(glm::vec3 position, Camera *camera){
+	float depth = glm::dot(position - camera->position, camera->forward) / camera->farPlane;
+	
+	if(depth < 0.0f)
+		depth = 0.0f;
+	if(depth > 1.0f)
+		depth = 1.0f;
+	
+	return depth;
+}
+
+// pack everything that decides draw order into one integer (see layout in renderqueue.h)
+static u64 makeRenderKey(u32 pass, ShaderProgram *program, Material *material, u32 vertexArray, float depth){
+	u64 key = (u64)(pass & 0xF) << RENDER_KEY_PASS_SHIFT;
+	
+	u64 programBits = program->id & 0xFFF;
+	u64 materialBits = material->id & 0xFFFF;
+	
+	if(material->transparent){
+		u64 maxDepth = (1 << RENDER_KEY_TRANSPARENT_DEPTH_BITS) - 1;
+		u64 depthBits = maxDepth - (u64)(depth * maxDepth); // far first
+		
+		key |= (u64)1 << RENDER_KEY_TRANSPARENT_SHIFT;
+		key |= depthBits << 35;
+		key |= programBits << 23;
+		key |= materialBits << 7;
+	} else {
+		u64 maxDepth = (1 << RENDER_KEY_OPAQUE_DEPTH_BITS) - 1;
+		u64 depthBits = (u64)(depth * maxDepth); // near first
+		
+		key |= programBits << 47;
+		key |= materialBits << 31;
+		key |= (u64)(vertexArray & 0xFFF) << 19;
+		key |= depthBits;
+	}
+	
+	return key;
+}
+
+// queue a draw of vertexData with program + material, pass decides when it's drawn (lower first)
+void submitRenderItem(Render_Queue *queue, u32 pass, ShaderProgram *program, Material *material, Vertex_Data *vertexData, glm::mat4 modelMatrix, glm::mat3 normalMatrix, Camera *camera){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	Render_Item item;
+	item.key = makeRenderKey(pass, program, material, vertexData->VAO, viewDepth(glm::vec3(modelMatrix[3]), camera));
+	item.program = program;
+	item.material = material;
+	item.vertexData = vertexData;
+	item.instances = NULL;
+	item.model = NULL;
+	item.batch = 0;
+	item.modelMatrix = modelMatrix;
+	item.normalMatrix = normalMatrix;
+	item.bounds = transformBounds(vertexData->bounds, modelMatrix);
+	
+	queue->items.push_back(item);
+}
+
+// queue an object with its current transform (the object can be changed and submitted again afterwards)
+void submitObject(Render_Queue *queue, u32 pass, Object_Data *object, ShaderProgram *program, Camera *camera){
+	submitRenderItem(queue, pass, program, &object->material, &object->vertexData, object->modelMatrix, object->normalMatrix, camera);
+}
+
+// queue an object with the variant of permutations for its material and the lights pushed right now
+void submitObject(Render_Queue *queue, u32 pass, Object_Data *object, ShaderPermutations *permutations, Camera *camera){
+	ShaderProgram *program = getShaderVariant(permutations, getShaderVariantKey(&object->material, permutations->shadowMode));
+	
+	submitObject(queue, pass, object, program, camera);
+}
+
+// shared by the submitModel overloads, program is picked per batch from permutations if it's NULL
+static void submitModel(Render_Queue *queue, u32 pass, Model *model, ShaderProgram *program, ShaderPermutations *permutations, Camera *camera){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	for(u32 i = 0; i < model->batches.size(); i++){
+		Material *material = &model->materials[model->batches[i].material];
+		float depth = viewDepth(model->batches[i].bounds.center, camera);
+		
+		Render_Item item;
+		item.program = program ? program : getShaderVariant(permutations, getShaderVariantKey(material, permutations->shadowMode, SHADER_FEATURE_INSTANCED));
+		item.key = makeRenderKey(pass, item.program, material, model->nodeInstances.VAO, depth);
+		item.material = material;
+		item.vertexData = &model->geometry;
+		item.instances = NULL;
+		item.model = model;
+		item.batch = i;
+		item.modelMatrix = model->modelMatrix; // unused, nodes' matrices are instance attributes
+		item.normalMatrix = model->normalMatrix;
+		item.bounds = model->batches[i].bounds;
+		
+		queue->items.push_back(item);
+	}
+}
+
+// queue a model as one multi draw per material (uses the world matrices from the last updateModel)
+// program has to be an INSTANCED variant, like for submitInstances
+void submitModel(Render_Queue *queue, u32 pass, Model *model, ShaderProgram *program, Camera *camera){
+	submitModel(queue, pass, model, program, NULL, camera);
+}
+
+void submitModel(Render_Queue *queue, u32 pass, Model *model, ShaderPermutations *permutations, Camera *camera){
+	submitModel(queue, pass, model, NULL, permutations, camera);
+}
+
+// queue every instance uploaded to instances as one draw, program has to be an INSTANCED variant
+// (depth isn't known per instance, instanced draws sort as if they were at the camera)
+void submitInstances(Render_Queue *queue, u32 pass, Instance_Data *instances, Material *material, ShaderProgram *program, Camera *camera){
+	if(pass >= MAX_RENDER_PASSES){
+		printf("render pass %u out of range\n", pass);
+		return;
+	}
+	
+	Render_Item item;
+	item.key = makeRenderKey(pass, program, material, instances->VAO, 0.0f);
+	item.program = program;
+	item.material = material;
+	item.vertexData = &instances->vertexData;
+	item.instances = instances;
+	item.model = NULL;
+	item.batch = 0;
+	item.bounds = instances->bounds;
+	
+	queue->items.push_back(item);
+}
+
+void submitInstances(Render_Queue *queue, u32 pass, Instance_Data *instances, Material *material, ShaderPermutations *permutations, Camera *camera){
+	ShaderProgram *program = getShaderVariant(permutations, getShaderVariantKey(material, permutations->shadowMode, SHADER_FEATURE_INSTANCED));
+	
+	submitInstances(queue, pass, instances, material, program, camera);
+}
+
+// vertex array an item draws with
+static u32 itemVertexArray(Render_Item *item){
+	if(item->model)
+		return item->model->nodeInstances.VAO;
+	
+	return item->instances ? item->instances->VAO : item->vertexData->VAO;
+}
+
+// triangles one draw of an item covers (per instance for instanced items, at the current lod for models)
+static u32 itemTriangles(Render_Item *item){
+	if(item->model){
+		Model_Batch_Lod *lod = &item->model->batches[item->batch].lods[item->model->lod];
+		
+		u32 indexCount = 0;
+		for(u32 i = 0; i < lod->counts.size(); i++)
+			indexCount += lod->counts[i];
+		
+		return indexCount / 3;
+	}
+	
+	Vertex_Data *vertexData = item->instances ? &item->instances->vertexData : item->vertexData;
+	
+	return (vertexData->usingEBO ? vertexData->indicesCount : vertexData->vertexCount) / 3;
+}
+
+// lsd radix sort on the 64 bit keys, 8 bits at a time (stable, so equal keys keep submission order)
+// digits where every key has the same value are skipped, which is most of them for small queues
+static void sortRenderEntries(std::vector<Render_Sort_Entry> *entries, std::vector<Render_Sort_Entry> *scratch){
+	u32 count = entries->size();
+	scratch->resize(count);
+	
+	Render_Sort_Entry *source = entries->data();
+	Render_Sort_Entry *destination = scratch->data();
+	
+	for(u32 shift = 0; shift < 64; shift += 8){
+		u32 histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		
+		for(u32 i = 0; i < count; i++)
+			histogram[(source[i].key >> shift) & 0xFF]++;
+		
+		// every key has the same digit, order wouldn't change
+		if(histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+		
+		u32 offset = 0;
+		for(u32 i = 0; i < 256; i++){
+			u32 bucket = histogram[i];
+			histogram[i] = offset;
+			offset += bucket;
+		}
+		
+		for(u32 i = 0; i < count; i++)
+			destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+		
+		Render_Sort_Entry *temp = source;
+		source = destination;
+		destination = temp;
+	}
+	
+	// odd number of scatters, result ended up in scratch
+	if(source != entries->data())
+		memcpy(entries->data(), source, count * sizeof(Render_Sort_Entry));
+}
+
+// mark items outside their pass's frustum as not visible, one batch of boxes per pass,
+// then test what's left against the pass's occlusion buffer
+static void cullRenderItems(Render_Queue *queue){
+	u32 count = queue->items.size();
+	queue->visible.assign(count, 1);
+	
+	for(u32 pass = 0; pass < MAX_RENDER_PASSES; pass++){
+		Render_Pass *renderPass = &queue->passes[pass];
+		
+		if(!renderPass->culling && !renderPass->occlusion)
+			continue;
+		
+		queue->cullItems.clear();
+		for(u32 i = 0; i < count; i++){
+			if((queue->items[i].key >> RENDER_KEY_PASS_SHIFT) == pass)
+				queue->cullItems.push_back(i);
+		}
+		
+		u32 cullCount = queue->cullItems.size();
+		if(cullCount == 0)
+			continue;
+		
+		// gather the boxes into one array per component for cullBoxes
+		queue->cullBounds.resize(cullCount * 6);
+		queue->cullResults.resize(cullCount);
+		
+		float *centers[3], *extents[3];
+		for(u32 axis = 0; axis < 3; axis++){
+			centers[axis] = queue->cullBounds.data() + cullCount * axis;
+			extents[axis] = queue->cullBounds.data() + cullCount * (3 + axis);
+		}
+		
+		for(u32 i = 0; i < cullCount; i++){
+			Bounds *bounds = &queue->items[queue->cullItems[i]].bounds;
+			
+			for(u32 axis = 0; axis < 3; axis++){
+				centers[axis][i] = bounds->center[axis];
+				extents[axis][i] = bounds->extents[axis];
+			}
+		}
+		
+		if(renderPass->culling)
+			cullBoxes(renderPass->frustumPlanes, centers, extents, cullCount, queue->cullResults.data());
+		else
+			memset(queue->cullResults.data(), 1, cullCount);
+		
+		for(u32 i = 0; i < cullCount; i++){
+			u32 item = queue->cullItems[i];
+			
+			queue->visible[item] = queue->cullResults[i];
+			
+			if(queue->visible[item] && renderPass->occlusion && isOccluded(renderPass->occlusion, queue->items[item].bounds)){
+				queue->visible[item] = 0;
+				queue->stats.occluded++;
+			}
+		}
+	}
+}
+
+// bind pass's target and set its viewport and face culling, clearing the target too if clear is set
+static void applyRenderPass(Render_Pass *pass, bool clear){
+	if(!pass->used)
+		return;
+	
+	stateBindFramebuffer(pass->framebuffer);
+	glViewport(pass->viewport[0], pass->viewport[1], pass->viewport[2], pass->viewport[3]);
+	
+	if(clear && pass->clear)
+		glClear(pass->clear);
+	
+	stateCullFace(pass->cullFace);
+}
+
+// clear every configured pass whether anything of it gets drawn or not (a pass whose items were all culled would
+// keep showing last frame otherwise), returns the last one, which is left bound (-1 if no pass is configured)
+static s32 clearRenderPasses(Render_Queue *queue){
+	s32 last = -1;
+	
+	for(u32 i = 0; i < MAX_RENDER_PASSES; i++){
+		if(!queue->passes[i].used)
+			continue;
+		
+		applyRenderPass(&queue->passes[i], true);
+		last = i;
+	}
+	
+	return last;
+}
+
+// sort everything submitted since the last call, draw it and empty the queue
+void drawRenderQueue(Render_Queue *queue){
+	Render_Queue_Stats *stats = &queue->stats;
+	memset(stats, 0, sizeof(Render_Queue_Stats));
+	
+	u32 count = queue->items.size();
+	stats->items = count;
+	
+	s32 lastPass = clearRenderPasses(queue);
+	
+	if(count == 0)
+		return;
+	
+	cullRenderItems(queue);
+	
+	// what drawing the visible items in submission order would've cost
+	Render_Item *previous = NULL;
+	
+	for(u32 i = 0; i < count; i++){
+		if(!queue->visible[i])
+			continue;
+		
+		Render_Item *item = &queue->items[i];
+		
+		if(previous){
+			stats->unsortedProgramChanges += item->program != previous->program;
+			stats->unsortedMaterialChanges += item->material != previous->material || item->program != previous->program;
+			stats->unsortedVertexArrayChanges += itemVertexArray(item) != itemVertexArray(previous);
+		}
+		
+		previous = item;
+		stats->visible++;
+	}
+	
+	stats->culled = count - stats->visible - stats->occluded;
+	
+	if(stats->visible == 0){
+		queue->items.clear();
+		return;
+	}
+	
+	// sort (only what survived culling)
+	double sortStart = glfwGetTime();
+	
+	queue->entries.clear();
+	for(u32 i = 0; i < count; i++){
+		if(!queue->visible[i])
+			continue;
+		
+		Render_Sort_Entry entry;
+		entry.key = queue->items[i].key;
+		entry.index = i;
+		
+		queue->entries.push_back(entry);
+	}
+	
+	sortRenderEntries(&queue->entries, &queue->scratch);
+	
+	stats->sortTime = (glfwGetTime() - sortStart) * 1000.0;
+	
+	// draw, only touching state that differs from the previous item
+	u32 currentPass = 0xFFFFFFFF;
+	ShaderProgram *currentProgram = NULL;
+	Material *currentMaterial = NULL;
+	u32 currentVertexArray = 0xFFFFFFFF;
+	
+	for(u32 i = 0; i < stats->visible; i++){
+		Render_Item *item = &queue->items[queue->entries[i].index];
+		
+		u32 pass = item->key >> RENDER_KEY_PASS_SHIFT;
+		
+		if(pass != currentPass){
+			applyRenderPass(&queue->passes[pass], false);
+			
+			currentPass = pass;
+			stats->passChanges++;
+		}
+		
+		if(item->program != currentProgram){
+			useShader(item->program);
+			
+			currentProgram = item->program;
+			currentMaterial = NULL; // material uniforms belong to the program
+			stats->programChanges++;
+		}
+		
+		if(item->material != currentMaterial){
+			bindMaterial(item->material, item->program);
+			
+			currentMaterial = item->material;
+			stats->materialChanges++;
+		}
+		
+		if(itemVertexArray(item) != currentVertexArray){
+			currentVertexArray = itemVertexArray(item);
+			stats->vertexArrayChanges++;
+		}
+		
+		if(item->instances){
+			drawInstances(item->instances, item->program);
+			stats->instances += item->instances->uploadedCount;
+			stats->triangles += itemTriangles(item) * item->instances->uploadedCount;
+			continue;
+		}
+		
+		if(item->model){
+			setUniformVertexFormat(item->program, &item->model->geometry.format);
+			drawModelBatch(item->model, item->batch);
+		} else {
+			setUniformTransform(item->program, item->modelMatrix, item->normalMatrix);
+			drawVertexData(item->vertexData, item->program);
+		}
+		
+		stats->instances++;
+		stats->triangles += itemTriangles(item);
+	}
+	
+	// leave the last pass bound like when nothing was drawn, whatever comes after the queue expects its target
+	if(lastPass >= 0 && currentPass != (u32)lastPass)
+		applyRenderPass(&queue->passes[lastPass], false);
+	
+	// the first of each only counts as a change in the unsorted numbers if it differs from the previous item,
+	// so leave the initial binds out here too
+	stats->programChanges--;
+	stats->materialChanges--;
+	stats->vertexArrayChanges--;
+	
+	queue->items.clear();
+}
+
+Render_Queue_Stats *getRenderQueueStats(Render_Queue *queue){
+	return &queue->stats;
+}
+
+void printRenderQueueStats(Render_Queue *queue){
+	Render_Queue_Stats *stats = &queue->stats;
+	
+	printf("render queue: %u items (%u instances, %u triangles), %u passes, sorted in %.3f ms\n", stats->items, stats->instances, stats->triangles, stats->passChanges, stats->sortTime);
+	printf("  culling: %u visible, %u culled, %u occluded\n", stats->visible, stats->culled, stats->occluded);
+	printf("  state changes (sorted / submission order):\n");
+	printf("  %-16s %6u / %6u\n", "program", stats->programChanges, stats->unsortedProgramChanges);
+	printf("  %-16s %6u / %6u\n", "material", stats->materialChanges, stats->unsortedMaterialChanges);
+	printf("  %-16s %6u / %6u\n", "vertex array", stats->vertexArrayChanges, stats->unsortedVertexArrayChanges);
+}
@@ -0,0 +1,172 @@
+// streaming ring buffer for per frame data
+// everything pushed in a frame goes into that frame's region, so the cpu only ever writes memory the gpu
+// finished reading (RING_BUFFER_FRAMES frames ago), without a fence wait unless the gpu falls that far behind
+
+#include <ringbuffer.h>
+#include <extensions.h>
+
+#include <cstdio>
+#include <cstring>
+
+#define RING_FENCE_TIMEOUT 1000000000 // ns, 1 second before complaining
+
+// buffer + mapping for the current frameSize
+static void createRingStorage(Ring_Buffer *ring){
+	glGenBuffers(1, &ring->buffer);
+	
+	// copy write target so creating it doesn't disturb vertex array/uniform bindings
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+	
+	if(ring->persistent){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		u32 size = ring->frameSize * RING_BUFFER_FRAMES;
+		
+		extBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		ring->mapped = (u8*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	} else {
+		glBufferData(GL_COPY_WRITE_BUFFER, ring->frameSize, NULL, GL_STREAM_DRAW);
+		ring->mapped = NULL;
+	}
+	
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	
+	for(u32 i = 0; i < RING_BUFFER_FRAMES; i++)
+		ring->fences[i] = 0;
+}
+
+static void freeRingStorage(Ring_Buffer *ring){
+	for(u32 i = 0; i < RING_BUFFER_FRAMES; i++){
+		if(ring->fences[i])
+			glDeleteSync(ring->fences[i]);
+		
+		ring->fences[i] = 0;
+	}
+	
+	if(ring->mapped){
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		
+		ring->mapped = NULL;
+	}
+	
+	// the driver keeps the storage alive until draws still using it are done
+	glDeleteBuffers(1, &ring->buffer);
+	ring->buffer = 0;
+}
+
+// frameSize bytes per frame in flight (needs a context)
+void initRingBuffer(Ring_Buffer *ring, u32 frameSize){
+	ring->frameSize = frameSize;
+	ring->persistent = glExtensions.bufferStorage;
+	ring->frame = 0;
+	ring->head = 0;
+	ring->stalls = 0;
+	ring->peak = 0;
+	ring->generation = 0;
+	
+	createRingStorage(ring);
+}
+
+void freeRingBuffer(Ring_Buffer *ring){
+	freeRingStorage(ring);
+}
+
+// move on to the next region, waiting for the gpu if it's still reading it
+void beginRingFrame(Ring_Buffer *ring){
+	ring->head = 0;
+	
+	if(!ring->persistent){
+		// orphan, the driver hands out fresh storage while draws from last frame still read the old one
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, ring->frameSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+	
+	ring->frame = (ring->frame + 1) % RING_BUFFER_FRAMES;
+	
+	GLsync fence = ring->fences[ring->frame];
+	if(!fence)
+		return;
+	
+	// flush on the first try so the fence is actually submitted, otherwise this could wait forever
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	
+	if(result == GL_TIMEOUT_EXPIRED){
+		ring->stalls++;
+		
+		do {
+			result = glClientWaitSync(fence, 0, RING_FENCE_TIMEOUT);
+			
+			if(result == GL_TIMEOUT_EXPIRED)
+				printf("ring buffer: still waiting on the gpu\n");
+		} while(result == GL_TIMEOUT_EXPIRED);
+	}
+	
+	if(result == GL_WAIT_FAILED)
+		printf("ring buffer: fence wait failed\n");
+	
+	glDeleteSync(fence);
+	ring->fences[ring->frame] = 0;
+}
+
+// everything drawn from this frame's region has been submitted, fence it
+void endRingFrame(Ring_Buffer *ring){
+	if(ring->head > ring->peak)
+		ring->peak = ring->head;
+	
+	if(ring->persistent)
+		ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// out of room mid frame: draws already issued still read the current region, so nothing in it can be reused,
+// switch to new storage with room for at least needed bytes per frame right away (the old buffer is deleted,
+// the driver keeps it alive until those draws are done, and its fences go with it)
+static void growRingBuffer(Ring_Buffer *ring, u32 needed){
+	Ring_Buffer old = *ring;
+	
+	while(ring->frameSize < needed)
+		ring->frameSize *= 2;
+	
+	createRingStorage(ring);
+	freeRingStorage(&old);
+	
+	ring->head = 0;
+	ring->generation++;
+	
+	printf("ring buffer grown to %u KB per frame\n", ring->frameSize / 1024);
+}
+
+u32 pushRingBuffer(Ring_Buffer *ring, const void *data, u32 size, u32 alignment){
+	// aligned in the whole buffer, not just the region, so offset / alignment is exact for any alignment (vertex strides)
+	u32 regionStart = ring->persistent ? ring->frame * ring->frameSize : 0;
+	u32 offset = (regionStart + ring->head + alignment - 1) / alignment * alignment - regionStart;
+	
+	if(offset + size > ring->frameSize){
+		if(offset + size > ring->peak)
+			ring->peak = offset + size;
+		
+		// worst case alignment padding at the start of the new region
+		growRingBuffer(ring, size + alignment - 1);
+		
+		regionStart = ring->persistent ? ring->frame * ring->frameSize : 0;
+		offset = (regionStart + alignment - 1) / alignment * alignment - regionStart;
+	}
+	
+	ring->head = offset + size;
+	
+	if(ring->persistent){
+		memcpy(ring->mapped + regionStart + offset, data, size);
+	} else {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	
+	return regionStart + offset;
+}
+
+void printRingBufferStats(Ring_Buffer *ring){
+	printf("ring buffer (%s): %u KB per frame, peak %u KB, %u stalls\n", ring->persistent ? "persistent" : "orphaning", ring->frameSize / 1024, ring->peak / 1024, ring->stalls);
+}
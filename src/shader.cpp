@@ -2,40 +2,187 @@
 
 #include <shader.h>
 #include <fileio.h>
+#include <glstate.h>
+#include <extensions.h>
+#include <hash.h>
+
+#include <vector>
+#include <algorithm>
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
 
-// create a shader at a path and compiles it
-u32 createShader(char* shaderPath, GLenum shaderType){
-	// create shader
-	u32 shader = glCreateShader(shaderType);
+// everything createShader knows about a shader, compiling can be put off until a program actually needs it
+struct ShaderSource {
+	u64 hash; // hash of type + source, used for program cache keys
+	bool submitted; // glCompileShader called (not necessarily finished)
+	
+	std::string name; // path, for error messages
+};
+
+static std::unordered_map<u32, ShaderSource> shaderSources;
+
+// a program whose link was submitted but whose status hasn't been looked at yet
+// keeps stage names around since the stages are usually deleted before the program is first used
+struct PendingProgram {
+	u32 stages[3];
+	std::string stageNames[3];
+	u32 stageCount;
 	
-	// load + assign shader source
-	char* shaderSource = read_entire_file(shaderPath);
+	std::string description; // empty if the program wasn't named
 	
-	glShaderSource(shader, 1, &shaderSource, NULL);
+	bool saveToCache;
+	u64 cacheKey;
+};
+
+static std::unordered_map<u32, PendingProgram> pendingPrograms;
+
+// program binary cache
+static bool shaderCacheEnabled = false;
+static std::string shaderCacheDirectory;
+static u64 driverHash; // vendor/renderer/version, binaries from another driver are useless
+static ShaderCacheStats shaderCacheStats;
+
+#define PROGRAM_BINARY_MAGIC 0x42475250 // "PRGB"
+
+// what's stored in front of the driver's binary blob
+struct ProgramBinaryHeader {
+	u32 magic;
+	u32 format;
+	u64 key;
+};
+
+// start compiling a shader created by createShader (does nothing if it already is)
+// doesn't wait for the result, errors are reported when a program using it is first used (see finishShaderProgram)
+static void submitShader(u32 shader){
+	ShaderSource *source = &shaderSources[shader];
+	
+	if(source->submitted)
+		return;
 	
-	// compile shader and check for errors
 	glCompileShader(shader);
+	source->submitted = true;
+}
+
+// PREPROCESSOR //
+
+// append a shader file to output, expanding #include "path" (relative to the including file, each file only once)
+// defines are inserted right after the #version line of the first file, #line directives keep error line numbers
+// pointing at the right file (source string number = index into files)
+static bool preprocessShader(const std::string &path, const char* defines, std::string *output, std::vector<std::string> *files){
+	char* source = read_entire_file((char*)path.c_str());
 	
-	// check for errors (idk why error checking is this complicated, thanks opengl)
-	int success;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success); // get compilation status
-	// if unsuccessful, log why
-	if(!success){
-		// buffer for error
-		char info[512];
+	if(!source){
+		printf("couldn't read shader %s\n", path.c_str());
+		return false;
+	}
+	
+	u32 fileIndex = files->size();
+	files->push_back(path);
+	
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	
+	char directive[64];
+	u32 lineNumber = 1;
+	
+	for(char *line = source; *line; lineNumber++){
+		char *end = strchr(line, '\n');
+		u64 length = end ? end - line : strlen(line);
+		
+		std::string text(line, length);
+		line += length + (end ? 1 : 0);
+		
+		u64 start = text.find_first_not_of(" \t");
+		
+		if(start != std::string::npos && text.compare(start, 8, "#include") == 0){
+			u64 open = text.find('"', start);
+			u64 close = open != std::string::npos ? text.find('"', open + 1) : std::string::npos;
+			
+			if(close == std::string::npos){
+				printf("%s:%u: bad #include\n", path.c_str(), lineNumber);
+				free(source);
+				return false;
+			}
+			
+			std::string includePath = directory + text.substr(open + 1, close - open - 1);
+			
+			// already included, blank line to keep the numbering
+			if(std::find(files->begin(), files->end(), includePath) != files->end()){
+				*output += "\n";
+				continue;
+			}
+			
+			snprintf(directive, sizeof(directive), "#line 1 %u\n", (u32)files->size());
+			*output += directive;
+			
+			if(!preprocessShader(includePath, NULL, output, files)){
+				free(source);
+				return false;
+			}
+			
+			snprintf(directive, sizeof(directive), "#line %u %u\n", lineNumber + 1, fileIndex);
+			*output += directive;
+			continue;
+		}
 		
-		// get error
-		glGetShaderInfoLog(shader, 512, NULL, info);
+		*output += text;
+		*output += "\n";
 		
-		printf("%s shader compilation error: %s\n", shaderPath, info);
+		// #version has to come first, so defines go right after it
+		if(defines && start != std::string::npos && text.compare(start, 8, "#version") == 0){
+			*output += defines;
+			
+			snprintf(directive, sizeof(directive), "#line %u %u\n", lineNumber + 1, fileIndex);
+			*output += directive;
+		}
 	}
 	
-	printf("successfully compiled %s shader\n", shaderPath);
+	free(source);
+	
+	return true;
+}
 
-	free(shaderSource);
+// create a shader at a path and starts compiling it
+// (with the shader cache enabled compiling waits until a program using it misses the cache)
+u32 createShader(char* shaderPath, GLenum shaderType){
+	return createShader(shaderPath, shaderType, NULL);
+}
+
+// create a shader with extra #defines ("#define NAME VALUE\n" lines, can be NULL)
+u32 createShader(char* shaderPath, GLenum shaderType, const char* defines){
+	// create shader
+	u32 shader = glCreateShader(shaderType);
+	
+	// load + preprocess + assign shader source
+	std::string shaderSource;
+	std::vector<std::string> files;
+	
+	preprocessShader(shaderPath, defines, &shaderSource, &files);
+	
+	const char* sourceText = shaderSource.c_str();
+	glShaderSource(shader, 1, &sourceText, NULL);
+	
+	ShaderSource source;
+	source.hash = hashString(sourceText, hashData(&shaderType, sizeof(shaderType)));
+	source.submitted = false;
+	source.name = shaderPath;
+	
+	// include list so "0(12)" style errors can be traced back
+	for(u32 i = 1; i < files.size(); i++){
+		char index[16];
+		snprintf(index, sizeof(index), "%s%u=", i == 1 ? " [" : ", ", i);
+		source.name += index + files[i];
+	}
+	
+	if(files.size() > 1)
+		source.name += "]";
+	
+	shaderSources[shader] = source;
+	
+	if(!shaderCacheEnabled)
+		submitShader(shader);
 
 	return shader;
 }
@@ -43,134 +190,541 @@ u32 createShader(char* shaderPath, GLenum shaderType){
 // delete a shader (only when done with it)
 void deleteShader(u32 shader){
 	glDeleteShader(shader);
+	
+	shaderSources.erase(shader);
 }
 
-// create a shader program
-ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader){
-	// create program
-	ShaderProgram program = glCreateProgram();
+// PROGRAM BINARY CACHE //
+
+// save linked programs to directory and load them back on later runs instead of compiling (needs program binary support)
+void enableShaderCache(const char* directory){
+	if(!glExtensions.programBinary){
+		printf("shader cache not available (no program binary support)\n");
+		return;
+	}
 	
-	// attach shaders
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
+	make_directory(directory);
 	
-	// link shaders
-	glLinkProgram(program);
+	shaderCacheDirectory = directory;
+	shaderCacheEnabled = true;
 	
-	int success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if(!success){
-		char info[512];
-		glGetProgramInfoLog(program, 512, NULL, info);
-		printf("failed to link shader program: %s\n", info);
-	}  
+	driverHash = hashString((const char*)glGetString(GL_VENDOR));
+	driverHash = hashString((const char*)glGetString(GL_RENDERER), driverHash);
+	driverHash = hashString((const char*)glGetString(GL_VERSION), driverHash);
+}
 
-	return program;
+ShaderCacheStats *getShaderCacheStats(){
+	return &shaderCacheStats;
 }
 
-// create a shader program with names for more error info
-ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader, const char* shaderName, const char* vertexName, const char* fragmentName){
+// key for a program made of these shaders on this driver
+static u64 programCacheKey(u32 *shaders, u32 shaderCount){
+	u64 key = driverHash;
+	
+	for(u32 i = 0; i < shaderCount; i++)
+		key = hashData(&shaderSources[shaders[i]].hash, sizeof(u64), key);
+	
+	return key;
+}
+
+static std::string programCachePath(u64 key){
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+	
+	return shaderCacheDirectory + name;
+}
+
+// try to load a cached binary into program, false if there isn't one or the driver rejects it
+static bool loadProgramBinary(u32 program, u64 key){
+	u64 size;
+	u8 *data = (u8*)read_binary_file(programCachePath(key).c_str(), &size);
+	
+	if(!data)
+		return false;
+	
+	ProgramBinaryHeader *header = (ProgramBinaryHeader*)data;
+	
+	bool valid = size > sizeof(ProgramBinaryHeader) && header->magic == PROGRAM_BINARY_MAGIC && header->key == key;
+	
+	if(valid){
+		extProgramBinary(program, header->format, data + sizeof(ProgramBinaryHeader), (GLsizei)(size - sizeof(ProgramBinaryHeader)));
+		
+		// drivers refuse binaries they don't like anymore (updates etc), that's just a miss
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		valid = success;
+	}
+	
+	if(!valid)
+		printf("stale shader cache entry %016llx, recompiling\n", (unsigned long long)key);
+	
+	free(data);
+	
+	return valid;
+}
+
+static void saveProgramBinary(u32 program, u64 key){
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	
+	if(length <= 0)
+		return;
+	
+	u8 *data = (u8*)malloc(sizeof(ProgramBinaryHeader) + length);
+	
+	ProgramBinaryHeader *header = (ProgramBinaryHeader*)data;
+	header->magic = PROGRAM_BINARY_MAGIC;
+	header->key = key;
+	
+	GLenum format;
+	extGetProgramBinary(program, length, NULL, &format, data + sizeof(ProgramBinaryHeader));
+	header->format = format;
+	
+	if(!write_binary_file(programCachePath(key).c_str(), data, sizeof(ProgramBinaryHeader) + length))
+		printf("couldn't write shader cache entry %016llx\n", (unsigned long long)key);
+	
+	free(data);
+}
+
+// SHADER PROGRAMS //
+
+// attach a uniform block to a binding point if the program uses it, returns whether it does
+static bool bindUniformBlock(ShaderProgram *program, const char* name, u32 binding){
+	u32 index = glGetUniformBlockIndex(program->id, name);
+	
+	if(index == GL_INVALID_INDEX)
+		return false;
+	
+	glUniformBlockBinding(program->id, index, binding);
+	return true;
+}
+
+// point a sampler at a texture unit (program has to be bound)
+static void assignSampler(ShaderProgram *program, const char* name, s32 unit){
+	s32 location = getUniformLocation(program, name);
+	
+	if(location >= 0)
+		glUniform1i(location, unit);
+}
+
+// point each element of a sampler array at consecutive units starting at firstUnit
+static void assignSamplerArray(ShaderProgram *program, const char* name, s32 firstUnit){
+	s32 units[MAX_MATERIAL_TEXTURES];
+	
+	for(s32 i = 0; i < MAX_MATERIAL_TEXTURES; i++)
+		units[i] = firstUnit + i;
+	
+	// room for the name, "[", the largest s32 and "]"
+	std::vector<char> element(strlen(name) + 16);
+	snprintf(element.data(), element.size(), "%s[0]", name);
+	
+	// arrays are contiguous from element 0, elements past the last used one aren't active
+	s32 location = getUniformLocation(program, element.data());
+	
+	if(location < 0)
+		return;
+	
+	s32 count = 1;
+	while(count < MAX_MATERIAL_TEXTURES){
+		snprintf(element.data(), element.size(), "%s[%d]", name, count);
+		
+		if(getUniformLocation(program, element.data()) < 0)
+			break;
+		
+		count++;
+	}
+	
+	glUniform1iv(location, count, units);
+}
+
+// walk every active uniform once and store its location, so setting uniforms never has to ask opengl by name
+static void buildUniformTable(ShaderProgram *program){
+	program->uniforms.clear();
+	
+	s32 count;
+	glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &count);
+	
+	// longest active name including the terminator, element names need room for "[", the largest s32 and "]" on top
+	s32 maxLength;
+	glGetProgramiv(program->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	
+	std::vector<char> nameBuffer(maxLength + 1);
+	std::vector<char> element(maxLength + 16);
+	
+	for(s32 i = 0; i < count; i++){
+		char *name = nameBuffer.data();
+		s32 size;
+		GLenum type;
+		
+		glGetActiveUniform(program->id, i, nameBuffer.size(), NULL, &size, &type, name);
+		
+		s32 location = glGetUniformLocation(program->id, name);
+		
+		// members of uniform blocks don't have locations
+		if(location < 0)
+			continue;
+		
+		program->uniforms[name] = location;
+		
+		// arrays are reported once as "name[0]", so register every element (and the bare name) as well
+		char *bracket = strstr(name, "[0]");
+		if(size > 1 && bracket && bracket[3] == '\0'){
+			*bracket = '\0';
+			program->uniforms[name] = location;
+			
+			for(s32 j = 1; j < size; j++){
+				snprintf(element.data(), element.size(), "%s[%d]", name, j);
+				
+				program->uniforms[element.data()] = glGetUniformLocation(program->id, element.data());
+			}
+		}
+	}
+	
+	// resolve handles used by the draw path
+	UniformHandles *handles = &program->handles;
+	
+	handles->model = getUniformLocation(program, "model");
+	handles->normalMatrix = getUniformLocation(program, "normalMatrix");
+	
+	handles->materialColor = getUniformLocation(program, "material.color");
+	handles->materialShininess = getUniformLocation(program, "material.shininess");
+	handles->materialSpecularStrength = getUniformLocation(program, "material.specularStrength");
+	handles->materialDiffuseCount = getUniformLocation(program, "material.diffuseCount");
+	handles->materialSpecularCount = getUniformLocation(program, "material.specularCount");
+	handles->materialEmissionCount = getUniformLocation(program, "material.emissionCount");
+	
+	handles->positionOffset = getUniformLocation(program, "positionOffset");
+	handles->positionScale = getUniformLocation(program, "positionScale");
+	handles->normalEncoding = getUniformLocation(program, "normalEncoding");
+	
+	// samplers never change after this (see TEXTURE_UNIT_*)
+	stateUseProgram(program->id);
+	
+	assignSamplerArray(program, "material.diffuseMaps", TEXTURE_UNIT_DIFFUSE_MAPS);
+	assignSamplerArray(program, "material.specularMaps", TEXTURE_UNIT_SPECULAR_MAPS);
+	assignSamplerArray(program, "material.emissionMaps", TEXTURE_UNIT_EMISSION_MAPS);
+	
+	// single texture materials (untexturedfs)
+	assignSampler(program, "material.diffuseMap", TEXTURE_UNIT_DIFFUSE_MAPS);
+	assignSampler(program, "material.specularMap", TEXTURE_UNIT_SPECULAR_MAPS);
+	assignSampler(program, "material.emissionMap", TEXTURE_UNIT_EMISSION_MAPS);
+	
+	assignSampler(program, "material.normalMap", TEXTURE_UNIT_NORMAL_MAP);
+	assignSampler(program, "shadowMap", TEXTURE_UNIT_SHADOW_MAP);
+	assignSampler(program, "env", TEXTURE_UNIT_ENVIRONMENT);
+	
+	// shared uniform blocks
+	bindUniformBlock(program, "Lights", UNIFORM_BLOCK_LIGHTS);
+	bindUniformBlock(program, "Frame", UNIFORM_BLOCK_FRAME);
+	program->objectBlock = bindUniformBlock(program, "Object", UNIFORM_BLOCK_OBJECT);
+}
+
+// link shaders into a program (or load it from the cache), description is used in link errors and can be NULL
+// the link is only submitted, its status is collected the first time the program is used
+static ShaderProgram linkShaderProgram(u32 *shaders, u32 shaderCount, const char* description){
 	// create program
-	ShaderProgram program = glCreateProgram();
+	ShaderProgram program;
+	program.id = glCreateProgram();
+	program.ready = false;
+	program.objectBlock = false;
 	
-	// attach shaders
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
+	// nothing set yet (NaN never matches), the first draw sets the vertex decode uniforms
+	program.positionOffset = glm::vec3(NAN);
+	program.positionScale = glm::vec3(NAN);
+	program.normalEncoding = -1;
 	
-	// link shaders
-	glLinkProgram(program);
+	PendingProgram pending;
+	pending.stageCount = 0;
+	pending.description = description ? description : "";
+	pending.saveToCache = false;
+	pending.cacheKey = 0;
 	
-	int success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if(!success){
-		char info[512];
-		glGetProgramInfoLog(program, 512, NULL, info);
-		printf("failed to link shader program %s (vertex: %s, fragment: %s): %s\n", shaderName, vertexName, fragmentName, info);
+	bool cached = false;
+	
+	if(shaderCacheEnabled){
+		pending.cacheKey = programCacheKey(shaders, shaderCount);
+		cached = loadProgramBinary(program.id, pending.cacheKey);
+		
+		if(cached)
+			shaderCacheStats.hits++;
+		else
+			shaderCacheStats.misses++;
 	}
+	
+	if(!cached){
+		// attach shaders
+		for(u32 i = 0; i < shaderCount; i++){
+			submitShader(shaders[i]);
+			glAttachShader(program.id, shaders[i]);
+			
+			pending.stages[i] = shaders[i];
+			pending.stageNames[i] = shaderSources[shaders[i]].name;
+		}
+		
+		pending.stageCount = shaderCount;
+		pending.saveToCache = shaderCacheEnabled;
+		
+		if(shaderCacheEnabled)
+			extProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		
+		// link shaders
+		glLinkProgram(program.id);
+	}
+	
+	pendingPrograms[program.id] = pending;
 
 	return program;
 }
 
-// create a shader program + geometry shader
-ShaderProgram createShaderProgram(u32 vertexShader, u32 geometryShader, u32 fragmentShader){
-	// create program
-	ShaderProgram program = glCreateProgram();
+// wait for a program to finish compiling/linking, report errors and build its uniform table
+// called automatically the first time a program is used, so programs created together compile in parallel
+void finishShaderProgram(ShaderProgram *program){
+	if(program->ready)
+		return;
 	
-	// attach shaders
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, geometryShader);
-	glAttachShader(program, fragmentShader);
+	program->ready = true;
 	
-	// link shaders
-	glLinkProgram(program);
+	std::unordered_map<u32, PendingProgram>::iterator it = pendingPrograms.find(program->id);
 	
 	int success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	glGetProgramiv(program->id, GL_LINK_STATUS, &success);
+	
 	if(!success){
+		// report failing stages by name first, the link log alone is usually useless
+		if(it != pendingPrograms.end()){
+			PendingProgram *pending = &it->second;
+			
+			for(u32 i = 0; i < pending->stageCount; i++){
+				int compiled;
+				glGetShaderiv(pending->stages[i], GL_COMPILE_STATUS, &compiled);
+				
+				if(!compiled){
+					char info[512];
+					glGetShaderInfoLog(pending->stages[i], 512, NULL, info);
+					
+					printf("%s shader compilation error: %s\n", pending->stageNames[i].c_str(), info);
+				}
+			}
+		}
+		
 		char info[512];
-		glGetProgramInfoLog(program, 512, NULL, info);
-		printf("failed to link shader program: %s\n", info);
-	}  
+		glGetProgramInfoLog(program->id, 512, NULL, info);
+		
+		if(it != pendingPrograms.end() && !it->second.description.empty())
+			printf("failed to link shader program %s: %s\n", it->second.description.c_str(), info);
+		else
+			printf("failed to link shader program: %s\n", info);
+	} else if(it != pendingPrograms.end() && it->second.saveToCache){
+		saveProgramBinary(program->id, it->second.cacheKey);
+	}
+	
+	if(it != pendingPrograms.end())
+		pendingPrograms.erase(it);
+	
+	buildUniformTable(program);
+}
 
-	return program;
+// true if finishShaderProgram won't block
+// needs parallel shader compile support to actually know, without it this always says yes
+bool shaderProgramReady(ShaderProgram *program){
+	if(program->ready || !glExtensions.parallelShaderCompile)
+		return true;
+	
+	int complete;
+	glGetProgramiv(program->id, GL_COMPLETION_STATUS_KHR, &complete);
+	
+	return complete;
+}
+
+// create a shader program
+ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader){
+	u32 shaders[] = {vertexShader, fragmentShader};
+	
+	return linkShaderProgram(shaders, 2, NULL);
+}
+
+// create a shader program with names for more error info
+ShaderProgram createShaderProgram(u32 vertexShader, u32 fragmentShader, const char* shaderName, const char* vertexName, const char* fragmentName){
+	u32 shaders[] = {vertexShader, fragmentShader};
+	
+	char description[256];
+	snprintf(description, sizeof(description), "%s (vertex: %s, fragment: %s)", shaderName, vertexName, fragmentName);
+	
+	return linkShaderProgram(shaders, 2, description);
+}
+
+// create a shader program + geometry shader
+ShaderProgram createShaderProgram(u32 vertexShader, u32 geometryShader, u32 fragmentShader){
+	u32 shaders[] = {vertexShader, geometryShader, fragmentShader};
+	
+	return linkShaderProgram(shaders, 3, NULL);
 }
 
 // create a shader program + geometry shader with names for more error info
 ShaderProgram createShaderProgram(u32 vertexShader, u32 geometryShader, u32 fragmentShader, const char* shaderName, const char* vertexName, const char* geometryName, const char* fragmentName){
-	// create program
-	ShaderProgram program = glCreateProgram();
+	u32 shaders[] = {vertexShader, geometryShader, fragmentShader};
 	
-	// attach shaders
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, geometryShader);
-	glAttachShader(program, fragmentShader);
+	char description[256];
+	snprintf(description, sizeof(description), "%s (vertex: %s, geometry %s, fragment: %s)", shaderName, vertexName, geometryName, fragmentName);
 	
-	// link shaders
-	glLinkProgram(program);
+	return linkShaderProgram(shaders, 3, description);
+}
+
+// SHADER VARIANTS //
+
+// build a variant key, counts are clamped to what the key (and the light buffer) can hold
+u32 makeShaderVariantKey(u32 pointLights, u32 spotLights, u32 directionalLights, u32 features, u32 shadowMode){
+	u32 maxLights = (1 << VARIANT_LIGHT_BITS) - 1;
 	
-	int success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if(!success){
-		char info[512];
-		glGetProgramInfoLog(program, 512, NULL, info);
-		printf("failed to link shader program %s (vertex: %s, geometry %s, fragment: %s): %s\n", shaderName, vertexName, geometryName, fragmentName, info);
-	}
+	pointLights = pointLights < maxLights ? pointLights : maxLights;
+	spotLights = spotLights < maxLights ? spotLights : maxLights;
+	directionalLights = directionalLights < maxLights ? directionalLights : maxLights;
+	
+	return pointLights | (spotLights << VARIANT_LIGHT_BITS) | (directionalLights << (VARIANT_LIGHT_BITS * 2)) | 
+		(features << VARIANT_FEATURE_SHIFT) | (shadowMode << VARIANT_SHADOW_SHIFT);
+}
+
+// set up a family of programs built from the same two files, nothing is compiled until a variant is asked for
+void createShaderPermutations(ShaderPermutations *permutations, const char* vertexPath, const char* fragmentPath, const char* name, u32 shadowMode){
+	permutations->vertexPath = vertexPath;
+	permutations->fragmentPath = fragmentPath;
+	permutations->name = name;
+	permutations->shadowMode = shadowMode;
+	
+	permutations->variants.clear();
+}
 
+// the #define block a variant is compiled with
+static std::string variantDefines(u32 key){
+	u32 lightMask = (1 << VARIANT_LIGHT_BITS) - 1;
+	u32 features = (key >> VARIANT_FEATURE_SHIFT) & ((1 << (VARIANT_SHADOW_SHIFT - VARIANT_FEATURE_SHIFT)) - 1);
+	
+	char defines[512];
+	snprintf(defines, sizeof(defines), 
+		"#define SHADER_VARIANT\n"
+		"#define POINT_LIGHT_COUNT %u\n"
+		"#define SPOT_LIGHT_COUNT %u\n"
+		"#define DIRECTIONAL_LIGHT_COUNT %u\n"
+		"#define SHADOW_MODE %u\n", 
+		key & lightMask, (key >> VARIANT_LIGHT_BITS) & lightMask, (key >> (VARIANT_LIGHT_BITS * 2)) & lightMask, key >> VARIANT_SHADOW_SHIFT);
+	
+	std::string result = defines;
+	
+	if(features & SHADER_FEATURE_DIFFUSE_MAP)
+		result += "#define HAS_DIFFUSE_MAP\n";
+	if(features & SHADER_FEATURE_SPECULAR_MAP)
+		result += "#define HAS_SPECULAR_MAP\n";
+	if(features & SHADER_FEATURE_EMISSION_MAP)
+		result += "#define HAS_EMISSION_MAP\n";
+	if(features & SHADER_FEATURE_INSTANCED)
+		result += "#define INSTANCED\n";
+	
+	return result;
+}
+
+// get the program specialized for key, compiling it the first time it's asked for
+// (pointers stay valid, variants are never removed)
+ShaderProgram *getShaderVariant(ShaderPermutations *permutations, u32 key){
+	std::unordered_map<u32, ShaderProgram>::iterator it = permutations->variants.find(key);
+	
+	if(it != permutations->variants.end())
+		return &it->second;
+	
+	std::string defines = variantDefines(key);
+	
+	u32 vertex = createShader((char*)permutations->vertexPath.c_str(), SHADER_VERTEX, defines.c_str());
+	u32 fragment = createShader((char*)permutations->fragmentPath.c_str(), SHADER_FRAGMENT, defines.c_str());
+	
+	char name[128];
+	snprintf(name, sizeof(name), "%s[%08x]", permutations->name.c_str(), key);
+	
+	ShaderProgram *program = &permutations->variants[key];
+	*program = createShaderProgram(vertex, fragment, name, permutations->vertexPath.c_str(), permutations->fragmentPath.c_str());
+	
+	deleteShader(vertex);
+	deleteShader(fragment);
+	
 	return program;
 }
 
 // use a shader program
 void useShader(ShaderProgram *program){
-	glUseProgram(*program);
+	finishShaderProgram(program);
+	
+	stateUseProgram(program->id);
 }
 
+// look up a uniform location in the program's table (-1 if it doesn't exist, same as opengl)
+s32 getUniformLocation(ShaderProgram *program, const char* name){
+	finishShaderProgram(program);
+	
+	std::unordered_map<std::string, s32>::iterator it = program->uniforms.find(name);
+	
+	if(it == program->uniforms.end())
+		return -1;
+	
+	return it->second;
+}
+
+// by name (hash lookup, no gl query)
+
 // set a uniform float (singular)
-void setUniformFloat(ShaderProgram program, const char* location, float data){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformFloat(ShaderProgram *program, const char* location, float data){
+	setUniformFloat(program, getUniformLocation(program, location), data);
+}
+
+// set a uniform float(s)
+// num must be >0 and <=4
+void setUniformFloat(ShaderProgram *program, const char* location, float *data, s32 num){
+	setUniformFloat(program, getUniformLocation(program, location), data, num);
+}
+
+// set a uniform int (singular)
+void setUniformInt(ShaderProgram *program, const char* location, int data){
+	setUniformInt(program, getUniformLocation(program, location), data);
+}
+
+// set a uniform int(s)
+// num must be >0 and <=4
+void setUniformInt(ShaderProgram *program, const char* location, int *data, s32 num){
+	setUniformInt(program, getUniformLocation(program, location), data, num);
+}
+
+void setUniformMat4(ShaderProgram *program, const char* location, glm::mat4 matrix){
+	setUniformMat4(program, getUniformLocation(program, location), matrix);
+}
+
+void setUniformMat3(ShaderProgram *program, const char* location, glm::mat3 matrix){
+	setUniformMat3(program, getUniformLocation(program, location), matrix);
+}
+
+// by location (from getUniformLocation or program->handles)
+
+// set a uniform float (singular)
+void setUniformFloat(ShaderProgram *program, s32 location, float data){
+	useShader(program);
 	
-	glUniform1f(uniformLocation, data);
+	glUniform1f(location, data);
 }
 
 // set a uniform float(s)
 // num must be >0 and <=4
-void setUniformFloat(ShaderProgram program, const char* location, float *data, s32 num){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformFloat(ShaderProgram *program, s32 location, float *data, s32 num){
+	useShader(program);
 	
 	// todo: way to make this easier?
 	switch(num){
 		case 1:
-			glUniform1f(uniformLocation, data[0]);
+			glUniform1f(location, data[0]);
 			break;
 		case 2:
-			glUniform2f(uniformLocation, data[0], data[1]);
+			glUniform2f(location, data[0], data[1]);
 			break;
 		case 3:
-			glUniform3f(uniformLocation, data[0], data[1], data[2]);
+			glUniform3f(location, data[0], data[1], data[2]);
 			break;
 		case 4:
-			glUniform4f(uniformLocation, data[0], data[1], data[2], data[3]);
+			glUniform4f(location, data[0], data[1], data[2], data[3]);
 			break;
 		default:
 			printf("invalid number of floats\n");
@@ -179,32 +733,30 @@ void setUniformFloat(ShaderProgram program, const char* location, float *data, s
 }
 
 // set a uniform int (singular)
-void setUniformInt(ShaderProgram program, const char* location, int data){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformInt(ShaderProgram *program, s32 location, int data){
+	useShader(program);
 	
-	glUniform1i(uniformLocation, data);
+	glUniform1i(location, data);
 }
 
 // set a uniform int(s)
 // num must be >0 and <=4
-void setUniformInt(ShaderProgram program, const char* location, int *data, s32 num){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformInt(ShaderProgram *program, s32 location, int *data, s32 num){
+	useShader(program);
 	
 	// todo: way to make this easier?
 	switch(num){
 		case 1:
-			glUniform1i(uniformLocation, data[0]);
+			glUniform1i(location, data[0]);
 			break;
 		case 2:
-			glUniform2i(uniformLocation, data[0], data[1]);
+			glUniform2i(location, data[0], data[1]);
 			break;
 		case 3:
-			glUniform3i(uniformLocation, data[0], data[1], data[2]);
+			glUniform3i(location, data[0], data[1], data[2]);
 			break;
 		case 4:
-			glUniform4i(uniformLocation, data[0], data[1], data[2], data[3]);
+			glUniform4i(location, data[0], data[1], data[2], data[3]);
 			break;
 		default:
 			printf("invalid number of ints\n");
@@ -213,16 +765,14 @@ void setUniformInt(ShaderProgram program, const char* location, int *data, s32 n
 }
 
 // sadly we can't make different types for the matrix without using templates, which I don't feel like doing right now
-void setUniformMat4(ShaderProgram program, const char* location, glm::mat4 matrix){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformMat4(ShaderProgram *program, s32 location, glm::mat4 matrix){
+	useShader(program);
 	
-	glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
-void setUniformMat3(ShaderProgram program, const char* location, glm::mat3 matrix){
-	int uniformLocation = glGetUniformLocation(program, location);
-	glUseProgram(program);
+void setUniformMat3(ShaderProgram *program, s32 location, glm::mat3 matrix){
+	useShader(program);
 	
-	glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(matrix));
-}
\ No newline at end of file
+	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
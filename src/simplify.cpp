@@ -0,0 +1,265 @@
+// mesh simplification by edge collapse with quadric error metrics (garland & heckbert)
+// every vertex has a quadric (sum of the squared distances to the planes of its triangles), collapsing a into b
+// costs the quadrics of both evaluated at b, cheapest collapses are done first in passes over the whole mesh
+
+#include <simplify.h>
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+
+// symmetric 4x4 matrix, only the upper triangle
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+};
+
+struct Collapse {
+	u32 from;
+	u32 to;
+	float cost;
+};
+
+static void addQuadric(Quadric *q, Quadric *other){
+	q->a00 += other->a00; q->a01 += other->a01; q->a02 += other->a02; q->a03 += other->a03;
+	q->a11 += other->a11; q->a12 += other->a12; q->a13 += other->a13;
+	q->a22 += other->a22; q->a23 += other->a23;
+	q->a33 += other->a33;
+}
+
+// plane (normal, distance) weighted by triangle area
+static void planeQuadric(Quadric *q, glm::vec3 normal, float distance, float weight){
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	
+	q->a00 = a * a * weight; q->a01 = a * b * weight; q->a02 = a * c * weight; q->a03 = a * d * weight;
+	q->a11 = b * b * weight; q->a12 = b * c * weight; q->a13 = b * d * weight;
+	q->a22 = c * c * weight; q->a23 = c * d * weight;
+	q->a33 = d * d * weight;
+}
+
+// v^T Q v
+static double evaluateQuadric(Quadric *q, glm::vec3 v){
+	double x = v.x, y = v.y, z = v.z;
+	
+	return q->a00 * x * x + 2.0 * q->a01 * x * y + 2.0 * q->a02 * x * z + 2.0 * q->a03 * x
+		+ q->a11 * y * y + 2.0 * q->a12 * y * z + 2.0 * q->a13 * y
+		+ q->a22 * z * z + 2.0 * q->a23 * z
+		+ q->a33;
+}
+
+static u64 edgeKey(u32 a, u32 b){
+	return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+}
+
+// would moving from to to turn any triangle around from over (or squash it flat)
+static bool collapseFlips(glm::vec3 *positions, u32 *indices, u32 *adjacency, u32 adjacencyCount, u32 from, u32 to){
+	for(u32 i = 0; i < adjacencyCount; i++){
+		u32 *triangle = indices + adjacency[i] * 3;
+		
+		// triangles on the collapsed edge disappear
+		if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+			continue;
+		
+		glm::vec3 corners[3], moved[3];
+		for(u32 j = 0; j < 3; j++){
+			corners[j] = positions[triangle[j]];
+			moved[j] = triangle[j] == from ? positions[to] : corners[j];
+		}
+		
+		glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+		glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+		
+		if(glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+			return true;
+	}
+	
+	return false;
+}
+
+u32 simplifyIndices(u32 *destination, u32 *indices, u32 indexCount, glm::vec3 *positions, u32 vertexCount, u32 targetIndexCount, float targetError, float *error){
+	std::vector<u32> current(indices, indices + indexCount);
+	
+	if(error)
+		*error = 0.0f;
+	
+	// errors are relative to the mesh size so one targetError works for any model
+	glm::vec3 minimum = glm::vec3(1e30f), maximum = glm::vec3(-1e30f);
+	for(u32 i = 0; i < indexCount; i++){
+		minimum = glm::min(minimum, positions[indices[i]]);
+		maximum = glm::max(maximum, positions[indices[i]]);
+	}
+	
+	glm::vec3 size = maximum - minimum;
+	float extent = glm::max(size.x, glm::max(size.y, size.z));
+	
+	// nothing to simplify
+	if(indexCount == 0 || extent <= 0.0f){
+		memcpy(destination, indices, indexCount * sizeof(u32));
+		return indexCount;
+	}
+	
+	float maxCost = (targetError * extent) * (targetError * extent);
+	
+	// quadrics from the original triangles
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, vertexCount * sizeof(Quadric));
+	
+	for(u32 i = 0; i < indexCount; i += 3){
+		glm::vec3 a = positions[indices[i]], b = positions[indices[i + 1]], c = positions[indices[i + 2]];
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		
+		float area = glm::length(normal);
+		if(area <= 0.0f)
+			continue;
+		
+		normal /= area;
+		
+		Quadric q;
+		planeQuadric(&q, normal, -glm::dot(normal, a), area * 0.5f);
+		
+		for(u32 j = 0; j < 3; j++)
+			addQuadric(&quadrics[indices[i + j]], &q);
+	}
+	
+	// vertices on open edges (mesh borders, and uv/normal seams since those vertices are split) never move,
+	// so simplified meshes don't open holes or smear textures across seams
+	std::vector<u8> locked(vertexCount, 0);
+	{
+		std::unordered_map<u64, u32> edgeUses;
+		edgeUses.reserve(indexCount);
+		
+		for(u32 i = 0; i < indexCount; i += 3){
+			for(u32 j = 0; j < 3; j++)
+				edgeUses[edgeKey(indices[i + j], indices[i + (j + 1) % 3])]++;
+		}
+		
+		for(u32 i = 0; i < indexCount; i += 3){
+			for(u32 j = 0; j < 3; j++){
+				u32 a = indices[i + j], b = indices[i + (j + 1) % 3];
+				
+				if(edgeUses[edgeKey(a, b)] == 1){
+					locked[a] = 1;
+					locked[b] = 1;
+				}
+			}
+		}
+	}
+	
+	std::vector<u32> remap(vertexCount);
+	std::vector<u8> touched(vertexCount);
+	std::vector<u32> adjacencyOffsets(vertexCount + 1);
+	std::vector<u32> adjacency;
+	std::vector<Collapse> collapses;
+	
+	for(u32 i = 0; i < vertexCount; i++)
+		remap[i] = i;
+	
+	while(current.size() > targetIndexCount){
+		u32 triangleCount = current.size() / 3;
+		
+		// triangles around every vertex
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for(u32 i = 0; i < current.size(); i++)
+			adjacencyOffsets[current[i] + 1]++;
+		for(u32 i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		
+		adjacency.resize(current.size());
+		std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for(u32 i = 0; i < current.size(); i++)
+			adjacency[fill[current[i]]++] = i / 3;
+		
+		// every edge in both directions (if the vertex being removed isn't locked)
+		collapses.clear();
+		for(u32 i = 0; i < current.size(); i += 3){
+			for(u32 j = 0; j < 3; j++){
+				u32 a = current[i + j], b = current[i + (j + 1) % 3];
+				
+				for(u32 k = 0; k < 2; k++){
+					u32 from = k ? b : a;
+					u32 to = k ? a : b;
+					
+					if(locked[from])
+						continue;
+					
+					Quadric q = quadrics[from];
+					addQuadric(&q, &quadrics[to]);
+					
+					Collapse collapse;
+					collapse.from = from;
+					collapse.to = to;
+					collapse.cost = (float)glm::max(evaluateQuadric(&q, positions[to]), 0.0);
+					
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b){ return a.cost < b.cost; });
+		
+		// each collapse removes about 2 triangles, don't overshoot the target by much in one pass
+		u32 budget = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		u32 collapsed = 0;
+		
+		std::fill(touched.begin(), touched.end(), 0);
+		
+		for(u32 i = 0; i < collapses.size() && collapsed < budget; i++){
+			Collapse *collapse = &collapses[i];
+			
+			if(collapse->cost > maxCost)
+				break;
+			
+			// only one collapse per neighborhood each pass, adjacency would be out of date otherwise
+			if(touched[collapse->from] || touched[collapse->to])
+				continue;
+			
+			u32 *around = adjacency.data() + adjacencyOffsets[collapse->from];
+			u32 aroundCount = adjacencyOffsets[collapse->from + 1] - adjacencyOffsets[collapse->from];
+			
+			if(collapseFlips(positions, current.data(), around, aroundCount, collapse->from, collapse->to))
+				continue;
+			
+			remap[collapse->from] = collapse->to;
+			addQuadric(&quadrics[collapse->to], &quadrics[collapse->from]);
+			
+			for(u32 j = 0; j < aroundCount; j++){
+				for(u32 k = 0; k < 3; k++)
+					touched[current[around[j] * 3 + k]] = 1;
+			}
+			
+			if(error)
+				*error = glm::max(*error, sqrtf(collapse->cost) / extent);
+			
+			collapsed++;
+		}
+		
+		if(collapsed == 0)
+			break;
+		
+		// apply, dropping triangles that lost a corner
+		u32 write = 0;
+		for(u32 i = 0; i < current.size(); i += 3){
+			u32 a = remap[current[i]], b = remap[current[i + 1]], c = remap[current[i + 2]];
+			
+			if(a == b || b == c || c == a)
+				continue;
+			
+			current[write++] = a;
+			current[write++] = b;
+			current[write++] = c;
+		}
+		
+		current.resize(write);
+		
+		for(u32 i = 0; i < vertexCount; i++)
+			remap[i] = i;
+	}
+	
+	memcpy(destination, current.data(), current.size() * sizeof(u32));
+	
+	return current.size();
+}
@@ -0,0 +1,350 @@
+// batch transforms, builds model/normal matrices for many objects at once from structure-of-arrays input
+
+#include <transform.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+// sse2 is always there on x86-64, anything else (or a 32 bit build without -msse2) gets the scalar path
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+#define TRANSFORM_ARRAY_COUNT 10 // position 3 + rotation 4 + scale 3
+
+Transform_Arrays createTransformArrays(u32 count){
+	Transform_Arrays arrays;
+	
+	arrays.count = count;
+	arrays.capacity = (count + 3) & ~3;
+	
+	u64 arrayBytes = arrays.capacity * sizeof(float);
+	arrays.memory = calloc(1, arrayBytes * TRANSFORM_ARRAY_COUNT + 16);
+	
+	// align the first array to 16 bytes, the rest follow at multiples of 16
+	float *base = (float*)(((u64)arrays.memory + 15) & ~(u64)15);
+	
+	for(u32 i = 0; i < 3; i++)
+		arrays.position[i] = base + arrays.capacity * i;
+	for(u32 i = 0; i < 4; i++)
+		arrays.rotation[i] = base + arrays.capacity * (3 + i);
+	for(u32 i = 0; i < 3; i++)
+		arrays.scale[i] = base + arrays.capacity * (7 + i);
+	
+	return arrays;
+}
+
+void freeTransformArrays(Transform_Arrays *arrays){
+	free(arrays->memory);
+	
+	arrays->memory = NULL;
+	arrays->count = 0;
+	arrays->capacity = 0;
+}
+
+void setTransformEuler(Transform_Arrays *arrays, u32 index, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale){
+	for(u32 i = 0; i < 3; i++){
+		arrays->position[i][index] = position[i];
+		arrays->rotation[i][index] = rotation[i];
+		arrays->scale[i][index] = scale[i];
+	}
+	
+	arrays->rotation[3][index] = 0.0f;
+}
+
+void setTransformQuaternion(Transform_Arrays *arrays, u32 index, glm::vec3 position, glm::vec4 rotation, glm::vec3 scale){
+	for(u32 i = 0; i < 3; i++){
+		arrays->position[i][index] = position[i];
+		arrays->scale[i][index] = scale[i];
+	}
+	
+	for(u32 i = 0; i < 4; i++)
+		arrays->rotation[i][index] = rotation[i];
+}
+
+// SCALAR //
+
+// model = T * R * S, normal = R * S^-1 (or R with uniform scale), same rules as updateTransform
+static void writeMatrices(glm::vec3 position, glm::vec3 right, glm::vec3 up, glm::vec3 forward, glm::vec3 scale, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix){
+	(*modelMatrix)[0] = glm::vec4(right * scale.x, 0.0f);
+	(*modelMatrix)[1] = glm::vec4(up * scale.y, 0.0f);
+	(*modelMatrix)[2] = glm::vec4(forward * scale.z, 0.0f);
+	(*modelMatrix)[3] = glm::vec4(position, 1.0f);
+	
+	if(!normalMatrix)
+		return;
+	
+	bool uniformScale = scale.x == scale.y && scale.y == scale.z;
+	
+	if(uniformScale || scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f){
+		float flip = scale.x < 0.0f ? -1.0f : 1.0f;
+		*normalMatrix = glm::mat3(right * flip, up * flip, forward * flip);
+	} else {
+		*normalMatrix = glm::mat3(right / scale.x, up / scale.y, forward / scale.z);
+	}
+}
+
+static void eulerTransform(Transform_Arrays *arrays, u32 i, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix){
+	float sx = sinf(arrays->rotation[0][i]), cx = cosf(arrays->rotation[0][i]);
+	float sy = sinf(arrays->rotation[1][i]), cy = cosf(arrays->rotation[1][i]);
+	float sz = sinf(arrays->rotation[2][i]), cz = cosf(arrays->rotation[2][i]);
+	
+	// rotation columns (Rx * Ry * Rz)
+	glm::vec3 right = glm::vec3(cy*cz, sx*sy*cz + cx*sz, -cx*sy*cz + sx*sz);
+	glm::vec3 up = glm::vec3(-cy*sz, -sx*sy*sz + cx*cz, cx*sy*sz + sx*cz);
+	glm::vec3 forward = glm::vec3(sy, -sx*cy, cx*cy);
+	
+	glm::vec3 position = glm::vec3(arrays->position[0][i], arrays->position[1][i], arrays->position[2][i]);
+	glm::vec3 scale = glm::vec3(arrays->scale[0][i], arrays->scale[1][i], arrays->scale[2][i]);
+	
+	writeMatrices(position, right, up, forward, scale, modelMatrix, normalMatrix);
+}
+
+static void quaternionTransform(Transform_Arrays *arrays, u32 i, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix){
+	float x = arrays->rotation[0][i];
+	float y = arrays->rotation[1][i];
+	float z = arrays->rotation[2][i];
+	float w = arrays->rotation[3][i];
+	
+	// rotation columns (same as glm::mat3_cast, expects a unit quaternion)
+	glm::vec3 right = glm::vec3(1.0f - 2.0f*(y*y + z*z), 2.0f*(x*y + w*z), 2.0f*(x*z - w*y));
+	glm::vec3 up = glm::vec3(2.0f*(x*y - w*z), 1.0f - 2.0f*(x*x + z*z), 2.0f*(y*z + w*x));
+	glm::vec3 forward = glm::vec3(2.0f*(x*z + w*y), 2.0f*(y*z - w*x), 1.0f - 2.0f*(x*x + y*y));
+	
+	glm::vec3 position = glm::vec3(arrays->position[0][i], arrays->position[1][i], arrays->position[2][i]);
+	glm::vec3 scale = glm::vec3(arrays->scale[0][i], arrays->scale[1][i], arrays->scale[2][i]);
+	
+	writeMatrices(position, right, up, forward, scale, modelMatrix, normalMatrix);
+}
+
+void batchTransformsEulerScalar(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	for(u32 i = 0; i < arrays->count; i++)
+		eulerTransform(arrays, i, &modelMatrices[i], normalMatrices ? &normalMatrices[i] : NULL);
+}
+
+void batchTransformsQuaternionScalar(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	for(u32 i = 0; i < arrays->count; i++)
+		quaternionTransform(arrays, i, &modelMatrices[i], normalMatrices ? &normalMatrices[i] : NULL);
+}
+
+// SSE //
+
+#ifdef TRANSFORM_SSE
+
+// mask ? a : b
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b){
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// sine and cosine of 4 floats at once (cephes polynomials, same approach as sse_mathfun)
+// accurate to about 1 ulp for the angle ranges transforms use
+static inline void sincos4(__m128 x, __m128 *sine, __m128 *cosine){
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+	
+	__m128 signSin = _mm_and_ps(x, signMask);
+	x = _mm_andnot_ps(signMask, x); // abs
+	
+	// octant
+	__m128 y = _mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)); // 4 / pi
+	__m128i j = _mm_cvttps_epi32(y);
+	j = _mm_add_epi32(j, _mm_set1_epi32(1));
+	j = _mm_and_si128(j, _mm_set1_epi32(~1));
+	y = _mm_cvtepi32_ps(j);
+	
+	__m128 swapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+	__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+	
+	__m128i jCos = _mm_sub_epi32(j, _mm_set1_epi32(2));
+	__m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(jCos, _mm_set1_epi32(4)), 29));
+	
+	signSin = _mm_xor_ps(signSin, swapSignSin);
+	
+	// x - y * pi/4 in three parts for precision
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+	
+	__m128 z = _mm_mul_ps(x, x);
+	
+	// cosine polynomial
+	__m128 c = _mm_set1_ps(2.443315711809948e-5f);
+	c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765e-3f));
+	c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+	c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+	c = _mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	c = _mm_add_ps(c, _mm_set1_ps(1.0f));
+	
+	// sine polynomial
+	__m128 s = _mm_set1_ps(-1.9515295891e-4f);
+	s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736e-3f));
+	s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+	s = _mm_mul_ps(_mm_mul_ps(s, z), x);
+	s = _mm_add_ps(s, x);
+	
+	// which polynomial is sine and which is cosine depends on the octant
+	*sine = _mm_xor_ps(select4(polyMask, s, c), signSin);
+	*cosine = _mm_xor_ps(select4(polyMask, c, s), signCos);
+}
+
+// store 3 floats without touching the 4th
+static inline void store3(float *destination, __m128 v){
+	_mm_storel_pi((__m64*)destination, v);
+	_mm_store_ss(destination + 2, _mm_movehl_ps(v, v));
+}
+
+// write matrices for objects i..i+3 from rotation columns (one lane per object)
+static inline void writeMatrices4(Transform_Arrays *arrays, u32 i, __m128 *right, __m128 *up, __m128 *forward, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	__m128 scaleX = _mm_load_ps(arrays->scale[0] + i);
+	__m128 scaleY = _mm_load_ps(arrays->scale[1] + i);
+	__m128 scaleZ = _mm_load_ps(arrays->scale[2] + i);
+	
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	
+	float *model = (float*)&modelMatrices[i];
+	
+	// model columns, transposed from one lane per object to one register per object
+	__m128 columns[4][4] = {
+		{_mm_mul_ps(right[0], scaleX), _mm_mul_ps(right[1], scaleX), _mm_mul_ps(right[2], scaleX), zero},
+		{_mm_mul_ps(up[0], scaleY), _mm_mul_ps(up[1], scaleY), _mm_mul_ps(up[2], scaleY), zero},
+		{_mm_mul_ps(forward[0], scaleZ), _mm_mul_ps(forward[1], scaleZ), _mm_mul_ps(forward[2], scaleZ), zero},
+		{_mm_load_ps(arrays->position[0] + i), _mm_load_ps(arrays->position[1] + i), _mm_load_ps(arrays->position[2] + i), one}
+	};
+	
+	for(u32 c = 0; c < 4; c++){
+		_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+		
+		for(u32 k = 0; k < 4; k++)
+			_mm_storeu_ps(model + 16 * k + 4 * c, columns[c][k]);
+	}
+	
+	if(!normalMatrices)
+		return;
+	
+	// per column factor: sign with uniform (or degenerate) scale, 1/scale otherwise
+	__m128 uniform = _mm_and_ps(_mm_cmpeq_ps(scaleX, scaleY), _mm_cmpeq_ps(scaleY, scaleZ));
+	__m128 anyZero = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(scaleX, zero), _mm_cmpeq_ps(scaleY, zero)), _mm_cmpeq_ps(scaleZ, zero));
+	__m128 useFlip = _mm_or_ps(uniform, anyZero);
+	__m128 flip = select4(_mm_cmplt_ps(scaleX, zero), _mm_set1_ps(-1.0f), one);
+	
+	// (anyZero lanes take flip, the division there is never used)
+	__m128 factor[3] = {
+		select4(useFlip, flip, _mm_div_ps(one, scaleX)),
+		select4(useFlip, flip, _mm_div_ps(one, scaleY)),
+		select4(useFlip, flip, _mm_div_ps(one, scaleZ))
+	};
+	
+	__m128 *rotation[3] = {right, up, forward};
+	float *normal = (float*)&normalMatrices[i];
+	
+	for(u32 c = 0; c < 3; c++){
+		__m128 x = _mm_mul_ps(rotation[c][0], factor[c]);
+		__m128 y = _mm_mul_ps(rotation[c][1], factor[c]);
+		__m128 z = _mm_mul_ps(rotation[c][2], factor[c]);
+		__m128 w = zero;
+		
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		
+		store3(normal + 3 * c, x);
+		store3(normal + 9 + 3 * c, y);
+		store3(normal + 18 + 3 * c, z);
+		store3(normal + 27 + 3 * c, w);
+	}
+}
+
+void batchTransformsEuler(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	u32 simdCount = arrays->count & ~3;
+	
+	for(u32 i = 0; i < simdCount; i += 4){
+		__m128 sx, cx, sy, cy, sz, cz;
+		sincos4(_mm_load_ps(arrays->rotation[0] + i), &sx, &cx);
+		sincos4(_mm_load_ps(arrays->rotation[1] + i), &sy, &cy);
+		sincos4(_mm_load_ps(arrays->rotation[2] + i), &sz, &cz);
+		
+		__m128 sxsy = _mm_mul_ps(sx, sy);
+		__m128 cxsy = _mm_mul_ps(cx, sy);
+		
+		// rotation columns (Rx * Ry * Rz), see eulerTransform
+		__m128 right[3] = {
+			_mm_mul_ps(cy, cz),
+			_mm_add_ps(_mm_mul_ps(sxsy, cz), _mm_mul_ps(cx, sz)),
+			_mm_sub_ps(_mm_mul_ps(sx, sz), _mm_mul_ps(cxsy, cz))
+		};
+		
+		__m128 up[3] = {
+			_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(cy, sz)),
+			_mm_sub_ps(_mm_mul_ps(cx, cz), _mm_mul_ps(sxsy, sz)),
+			_mm_add_ps(_mm_mul_ps(cxsy, sz), _mm_mul_ps(sx, cz))
+		};
+		
+		__m128 forward[3] = {
+			sy,
+			_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(sx, cy)),
+			_mm_mul_ps(cx, cy)
+		};
+		
+		writeMatrices4(arrays, i, right, up, forward, modelMatrices, normalMatrices);
+	}
+	
+	// leftovers
+	for(u32 i = simdCount; i < arrays->count; i++)
+		eulerTransform(arrays, i, &modelMatrices[i], normalMatrices ? &normalMatrices[i] : NULL);
+}
+
+void batchTransformsQuaternion(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	u32 simdCount = arrays->count & ~3;
+	
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	
+	for(u32 i = 0; i < simdCount; i += 4){
+		__m128 x = _mm_load_ps(arrays->rotation[0] + i);
+		__m128 y = _mm_load_ps(arrays->rotation[1] + i);
+		__m128 z = _mm_load_ps(arrays->rotation[2] + i);
+		__m128 w = _mm_load_ps(arrays->rotation[3] + i);
+		
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		
+		// rotation columns, see quaternionTransform
+		__m128 right[3] = {
+			_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+			_mm_mul_ps(two, _mm_add_ps(xy, wz)),
+			_mm_mul_ps(two, _mm_sub_ps(xz, wy))
+		};
+		
+		__m128 up[3] = {
+			_mm_mul_ps(two, _mm_sub_ps(xy, wz)),
+			_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+			_mm_mul_ps(two, _mm_add_ps(yz, wx))
+		};
+		
+		__m128 forward[3] = {
+			_mm_mul_ps(two, _mm_add_ps(xz, wy)),
+			_mm_mul_ps(two, _mm_sub_ps(yz, wx)),
+			_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))
+		};
+		
+		writeMatrices4(arrays, i, right, up, forward, modelMatrices, normalMatrices);
+	}
+	
+	// leftovers
+	for(u32 i = simdCount; i < arrays->count; i++)
+		quaternionTransform(arrays, i, &modelMatrices[i], normalMatrices ? &normalMatrices[i] : NULL);
+}
+
+#else
+
+void batchTransformsEuler(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	batchTransformsEulerScalar(arrays, modelMatrices, normalMatrices);
+}
+
+void batchTransformsQuaternion(Transform_Arrays *arrays, glm::mat4 *modelMatrices, glm::mat3 *normalMatrices){
+	batchTransformsQuaternionScalar(arrays, modelMatrices, normalMatrices);
+}
+
+#endif
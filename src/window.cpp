@@ -2,6 +2,8 @@
 
 #include <window.h>
 #include <callbacks.h>
+#include <glstate.h>
+#include <extensions.h>
 
 #include <cstdio>
 
@@ -53,6 +55,11 @@ Window windowCreate(const char* title, s32 width, s32 height, bool useDefaultCal
 	// for fun
 	printf("Using OpenGL %d.%d\n", GLVersion.major, GLVersion.minor);
 	
+	// new context, nothing is known about its state yet
+	stateInvalidate();
+	
+	loadExtensions();
+	
 	// assign other values
 	window.width = width;
 	window.height = height;
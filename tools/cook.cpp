@@ -0,0 +1,385 @@
+// offline asset cooker: converts the models and textures under an asset root (bin by default) into the cooked files
+// loadModel/createTexture/createCubemap prefer, every asset on its own job so they're spread over all cores
+// a manifest keeps a content hash of every asset's sources, assets whose sources didn't change are skipped
+// (built with make cook, run from anywhere: cook [-force] [-lods N] [asset root])
+
+#include <model.h>
+#include <cookedtexture.h>
+#include <fileio.h>
+#include <hash.h>
+#include <jobs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define COOK_MANIFEST_NAME "cook.manifest" // in the asset root, "hash path" per line
+#define COOK_MODEL_LODS 4 // levels cooked models get, loads asking for fewer only use the first ones
+#define COOK_VERSION 1 // bump to recook everything when the cooker itself changes
+
+#define ASSET_MODEL 0
+#define ASSET_TEXTURE 1
+#define ASSET_CUBEMAP 2
+
+#define COOK_FAILED 0
+#define COOK_COOKED 1
+#define COOK_SKIPPED 2 // sources unchanged, cooked file up to date
+#define COOK_TOUCHED 3 // sources unchanged but their times changed (checkouts etc), only the cooked file's key is rewritten
+
+struct Cook_Asset {
+	u32 type;
+	std::string path; // source (model/image), or the cooked file for cubemaps
+	std::string cookedPath;
+	std::vector<std::string> sources; // every file the cooked file is built from, hashed for the manifest
+	
+	u64 hash; // content hash of the sources (filled in by the job)
+	u32 result;
+};
+
+struct Cook_Context {
+	std::vector<Cook_Asset> assets;
+	std::string root;
+	std::unordered_map<std::string, u64> manifest; // path (relative to root) -> hash from the last run (read only while jobs run)
+	
+	u32 lodCount;
+	bool force;
+};
+
+// cubemap faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order, like createCubemap gets them
+static const char* cubemapFaces[6] = {"right", "left", "top", "bottom", "front", "back"};
+
+static bool isDirectory(const char *path){
+	struct stat info;
+	return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool fileExists(const char *path){
+	u64 size, modified;
+	return file_info(path, &size, &modified);
+}
+
+// lower case extension without the dot ("" if there's none)
+static std::string extensionOf(std::string name){
+	size_t dot = name.find_last_of('.');
+	if(dot == std::string::npos)
+		return "";
+	
+	std::string extension = name.substr(dot + 1);
+	for(u32 i = 0; i < extension.size(); i++)
+		extension[i] = tolower(extension[i]);
+	
+	return extension;
+}
+
+static bool isImage(std::string extension){
+	return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+// SCANNING //
+
+// add every asset in directory (and below it)
+static void scanDirectory(Cook_Context *context, std::string directory){
+	DIR *handle = opendir(directory.c_str());
+	if(!handle)
+		return;
+	
+	std::vector<std::string> names;
+	
+	struct dirent *entry;
+	while((entry = readdir(handle)) != NULL){
+		if(entry->d_name[0] != '.')
+			names.push_back(entry->d_name);
+	}
+	
+	closedir(handle);
+	
+	// a directory with all 6 faces (same extension) is one cubemap, its images aren't cooked on their own
+	std::string faceExtension;
+	
+	for(u32 i = 0; i < names.size() && faceExtension.empty(); i++){
+		std::string first = std::string(cubemapFaces[0]) + ".";
+		
+		if(!isImage(extensionOf(names[i])) || names[i].compare(0, first.size(), first) != 0)
+			continue;
+		
+		std::string suffix = names[i].substr(first.size() - 1);
+		bool complete = true;
+		
+		for(u32 j = 0; j < 6; j++)
+			complete = complete && fileExists((directory + "/" + cubemapFaces[j] + suffix).c_str());
+		
+		if(complete)
+			faceExtension = suffix;
+	}
+	
+	if(!faceExtension.empty()){
+		Cook_Asset asset;
+		asset.type = ASSET_CUBEMAP;
+		asset.cookedPath = directory + "/" + CUBEMAP_COOKED_NAME;
+		asset.path = asset.cookedPath;
+		
+		for(u32 i = 0; i < 6; i++)
+			asset.sources.push_back(directory + "/" + cubemapFaces[i] + faceExtension);
+		
+		context->assets.push_back(asset);
+	}
+	
+	for(u32 i = 0; i < names.size(); i++){
+		std::string path = directory + "/" + names[i];
+		std::string extension = extensionOf(names[i]);
+		
+		if(isDirectory(path.c_str())){
+			scanDirectory(context, path);
+			continue;
+		}
+		
+		Cook_Asset asset;
+		asset.path = path;
+		asset.sources.push_back(path);
+		
+		if(extension == "obj"){
+			asset.type = ASSET_MODEL;
+			asset.cookedPath = path + MODEL_COOKED_EXTENSION;
+			
+			// materials change what's cooked too
+			std::string library = path.substr(0, path.size() - 3) + "mtl";
+			if(fileExists(library.c_str()))
+				asset.sources.push_back(library);
+		} else if(isImage(extension)){
+			bool face = false;
+			for(u32 j = 0; j < 6; j++)
+				face = face || names[i] == std::string(cubemapFaces[j]) + faceExtension;
+			
+			if(face)
+				continue;
+			
+			asset.type = ASSET_TEXTURE;
+			asset.cookedPath = path + TEXTURE_COOKED_EXTENSION;
+		} else {
+			continue;
+		}
+		
+		context->assets.push_back(asset);
+	}
+}
+
+// MANIFEST //
+
+// what an asset is called in the manifest, so the root can be given differently from one run to the next
+static std::string manifestName(Cook_Context *context, Cook_Asset *asset){
+	return asset->path.substr(context->root.size() + 1);
+}
+
+static void loadManifest(Cook_Context *context, std::string path){
+	FILE *file = fopen(path.c_str(), "r");
+	if(!file)
+		return;
+	
+	char line[1024];
+	while(fgets(line, sizeof(line), file)){
+		unsigned long long hash;
+		char assetPath[1024];
+		
+		if(sscanf(line, "%llx %1023[^\n]", &hash, assetPath) == 2)
+			context->manifest[assetPath] = hash;
+	}
+	
+	fclose(file);
+}
+
+// assets that failed are left out, so they're tried again next time
+static void saveManifest(Cook_Context *context, std::string path){
+	FILE *file = fopen(path.c_str(), "w");
+	if(!file){
+		printf("couldn't write %s\n", path.c_str());
+		return;
+	}
+	
+	for(u32 i = 0; i < context->assets.size(); i++){
+		Cook_Asset *asset = &context->assets[i];
+		
+		if(asset->result != COOK_FAILED)
+			fprintf(file, "%016llx %s\n", (unsigned long long)asset->hash, manifestName(context, asset).c_str());
+	}
+	
+	fclose(file);
+}
+
+// COOKING //
+
+// content hash of every source + whatever changes the output, 0 if a source can't be read
+static u64 hashSources(Cook_Context *context, Cook_Asset *asset){
+	u32 settings[] = {COOK_VERSION, asset->type, asset->type == ASSET_MODEL ? context->lodCount : 0};
+	u64 hash = hashData(settings, sizeof(settings));
+	
+	for(u32 i = 0; i < asset->sources.size(); i++){
+		u64 size;
+		void *data = read_binary_file(asset->sources[i].c_str(), &size);
+		
+		if(!data)
+			return 0;
+		
+		hash = hashData(data, size, hash);
+		free(data);
+	}
+	
+	return hash;
+}
+
+// the key (size/time of the sources) the runtime checks cooked files against
+static u64 runtimeKey(Cook_Asset *asset){
+	if(asset->type == ASSET_MODEL)
+		return cookedModelKey(asset->path);
+	
+	std::vector<const char*> sources;
+	for(u32 i = 0; i < asset->sources.size(); i++)
+		sources.push_back(asset->sources[i].c_str());
+	
+	return cookedTextureKey(sources.data(), sources.size());
+}
+
+// cooked models and textures both start with magic, version, key
+struct Cooked_File_Start {
+	u32 magic;
+	u32 version;
+	u64 key;
+};
+
+// bring an up to date cooked file's key in line with its sources' times, false if there's no file to fix
+static bool touchCookedFile(Cook_Asset *asset){
+	u64 size;
+	u8 *data = (u8*)read_binary_file(asset->cookedPath.c_str(), &size);
+	
+	if(!data)
+		return false;
+	
+	bool valid = size >= sizeof(Cooked_File_Start);
+	
+	if(valid){
+		Cooked_File_Start *start = (Cooked_File_Start*)data;
+		u64 key = runtimeKey(asset);
+		
+		if(start->key != key){
+			start->key = key;
+			valid = write_binary_file(asset->cookedPath.c_str(), data, size);
+		}
+	}
+	
+	free(data);
+	
+	return valid;
+}
+
+static void cookAsset(void *data, u32 index){
+	Cook_Context *context = (Cook_Context*)data;
+	Cook_Asset *asset = &context->assets[index];
+	
+	asset->hash = hashSources(context, asset);
+	asset->result = COOK_FAILED;
+	
+	if(!asset->hash){
+		printf("couldn't read the sources of %s\n", asset->path.c_str());
+		return;
+	}
+	
+	std::unordered_map<std::string, u64>::const_iterator previous = context->manifest.find(manifestName(context, asset));
+	
+	if(!context->force && previous != context->manifest.end() && previous->second == asset->hash){
+		Cooked_File_Start start;
+		u64 size;
+		void *cooked = read_binary_file(asset->cookedPath.c_str(), &size);
+		
+		bool current = cooked && size >= sizeof(start);
+		if(current)
+			memcpy(&start, cooked, sizeof(start));
+		
+		free(cooked);
+		
+		if(current && start.key == runtimeKey(asset)){
+			asset->result = COOK_SKIPPED;
+			return;
+		}
+		
+		if(current && touchCookedFile(asset)){
+			asset->result = COOK_TOUCHED;
+			return;
+		}
+	}
+	
+	bool cooked = false;
+	
+	if(asset->type == ASSET_MODEL){
+		cooked = cookModel(asset->path, context->lodCount);
+	} else if(asset->type == ASSET_TEXTURE){
+		cooked = cookTexture(asset->path.c_str());
+	} else {
+		const char *faces[6];
+		for(u32 i = 0; i < 6; i++)
+			faces[i] = asset->sources[i].c_str();
+		
+		cooked = cookCubemap(faces, asset->cookedPath.c_str());
+	}
+	
+	asset->result = cooked ? COOK_COOKED : COOK_FAILED;
+}
+
+int main(int argc, char **argv){
+	Cook_Context context;
+	context.lodCount = COOK_MODEL_LODS;
+	context.force = false;
+	
+	context.root = "./bin";
+	
+	for(s32 i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-force") == 0){
+			context.force = true;
+		} else if(strcmp(argv[i], "-lods") == 0 && i + 1 < argc){
+			context.lodCount = atoi(argv[++i]);
+			context.lodCount = context.lodCount > 0 ? context.lodCount : 1;
+		} else {
+			context.root = argv[i];
+		}
+	}
+	
+	// paths are built as root + "/" + ...
+	while(context.root.size() > 1 && context.root[context.root.size() - 1] == '/')
+		context.root.erase(context.root.size() - 1);
+	
+	if(!isDirectory(context.root.c_str())){
+		printf("usage: cook [-force] [-lods N] [asset root (./bin)]\n");
+		return EXIT_FAILURE;
+	}
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	scanDirectory(&context, context.root + "/models");
+	scanDirectory(&context, context.root + "/textures");
+	
+	std::string manifestPath = context.root + "/" + COOK_MANIFEST_NAME;
+	loadManifest(&context, manifestPath);
+	
+	initJobs(0);
+	printf("cooking %u assets in %s on %u threads\n", (u32)context.assets.size(), context.root.c_str(), getJobThreadCount() + 1);
+	
+	runJobs(cookAsset, &context, context.assets.size());
+	shutdownJobs();
+	
+	saveManifest(&context, manifestPath);
+	
+	u32 counts[4] = {0, 0, 0, 0};
+	for(u32 i = 0; i < context.assets.size(); i++)
+		counts[context.assets[i].result]++;
+	
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%u cooked, %u up to date, %u touched, %u failed in %.2f s\n", counts[COOK_COOKED], counts[COOK_SKIPPED], counts[COOK_TOUCHED], counts[COOK_FAILED], seconds);
+	
+	return counts[COOK_FAILED] > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
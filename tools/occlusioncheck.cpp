@@ -0,0 +1,152 @@
+// headless checks of the occlusion rasterizer: known occluders are rasterized and visibility results compared with
+// what they have to be, no window or context needed (built and run with make occlusioncheck, exits with 1 on failure)
+
+#include <occlusion.h>
+#include <jobs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#define CHECK_WIDTH 64
+#define CHECK_HEIGHT 64 // several bands, so jobs split the buffer
+#define CHECK_THREADS 4
+
+static u32 passed;
+static u32 failed;
+
+static void check(bool condition, const char* name){
+	if(condition){
+		passed++;
+	} else {
+		failed++;
+		printf("  FAILED: %s\n", name);
+	}
+}
+
+static Bounds makeBounds(glm::vec3 center, glm::vec3 extents){
+	Bounds bounds;
+	bounds.center = center;
+	bounds.extents = extents;
+	bounds.radius = glm::length(extents);
+	
+	return bounds;
+}
+
+// camera at the origin looking down -z, 90 degree fov so screen positions are easy to work out (x / -z)
+static glm::mat4 checkViewProjection(){
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	
+	return projection * view;
+}
+
+static float bufferDepth(Occlusion_Buffer *buffer, u32 x, u32 y){
+	return buffer->depth[y * buffer->width + x];
+}
+
+// nothing rasterized, nothing can be occluded
+static void checkEmpty(Occlusion_Buffer *buffer){
+	beginOcclusion(buffer, checkViewProjection());
+	rasterizeOcclusion(buffer);
+	
+	check(bufferDepth(buffer, CHECK_WIDTH / 2, CHECK_HEIGHT / 2) == 1.0f, "empty buffer is cleared to the far plane");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f))), "empty buffer occludes nothing");
+}
+
+// a 4x4 wall 5 units in front of the camera (covers |x / -z| < 2 / 4.9 on screen)
+static void checkWall(Occlusion_Buffer *buffer){
+	glm::mat4 viewProjection = checkViewProjection();
+	
+	beginOcclusion(buffer, viewProjection);
+	addOccluderBox(buffer, makeBounds(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(2.0f, 2.0f, 0.1f)), glm::mat4(1.0f));
+	rasterizeOcclusion(buffer);
+	
+	check(getOcclusionStats(buffer)->triangles == 2, "box occluder keeps only the 2 triangles facing the camera");
+	
+	// depth of the front face where it's drawn, untouched around it
+	glm::vec4 clip = viewProjection * glm::vec4(0.0f, 0.0f, -4.9f, 1.0f);
+	float expected = clip.z / clip.w * 0.5f + 0.5f;
+	
+	check(fabsf(bufferDepth(buffer, CHECK_WIDTH / 2, CHECK_HEIGHT / 2) - expected) < 1e-4f, "wall depth matches the projected front face");
+	check(bufferDepth(buffer, 0, 0) == 1.0f && bufferDepth(buffer, CHECK_WIDTH - 1, CHECK_HEIGHT - 1) == 1.0f, "pixels outside the wall stay at the far plane");
+	
+	check(isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f))), "box right behind the wall is occluded");
+	check(isOccluded(buffer, makeBounds(glm::vec3(1.0f, -1.0f, -20.0f), glm::vec3(1.0f))), "far box within the wall's silhouette is occluded");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.5f))), "box in front of the wall is visible");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(4.0f, 0.0f, -10.0f), glm::vec3(1.0f))), "box sticking out from behind the wall is visible");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.5f, 0.5f, 1.0f))), "box poking through the wall is visible");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f))), "box around the camera (crossing the near plane) is visible");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(1.0f))), "box behind the camera is visible");
+	
+	Occlusion_Stats *stats = getOcclusionStats(buffer);
+	check(stats->tested == 7 && stats->occluded == 2, "stats count every test and every occluded box");
+}
+
+// the same wall as a triangle list, wound both ways (clockwise is a back face and doesn't occlude anything)
+static void checkWinding(Occlusion_Buffer *buffer){
+	float positions[] = {
+		-2.0f, -2.0f, -5.0f,
+		 2.0f, -2.0f, -5.0f,
+		 2.0f,  2.0f, -5.0f,
+		-2.0f,  2.0f, -5.0f
+	};
+	
+	u32 frontIndices[] = {0, 1, 2,  0, 2, 3};
+	u32 backIndices[] = {0, 2, 1,  0, 3, 2};
+	
+	Bounds behind = makeBounds(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f));
+	
+	beginOcclusion(buffer, checkViewProjection());
+	addOccluder(buffer, positions, 3, frontIndices, 2, glm::mat4(1.0f));
+	rasterizeOcclusion(buffer);
+	
+	check(isOccluded(buffer, behind), "counter clockwise quad occludes");
+	
+	beginOcclusion(buffer, checkViewProjection());
+	addOccluder(buffer, positions, 3, backIndices, 2, glm::mat4(1.0f));
+	rasterizeOcclusion(buffer);
+	
+	check(getOcclusionStats(buffer)->triangles == 0, "clockwise quad is culled");
+	check(!isOccluded(buffer, behind), "clockwise quad occludes nothing");
+	
+	// moved by the model matrix, out of the way
+	beginOcclusion(buffer, checkViewProjection());
+	addOccluder(buffer, positions, 3, frontIndices, 2, glm::translate(glm::mat4(1.0f), glm::vec3(20.0f, 0.0f, 0.0f)));
+	rasterizeOcclusion(buffer);
+	
+	check(!isOccluded(buffer, behind), "occluder moved off screen by its model matrix occludes nothing");
+}
+
+// a floor reaching behind the camera has to be clipped at the near plane and still hide what's under it
+static void checkNearClipping(Occlusion_Buffer *buffer){
+	beginOcclusion(buffer, checkViewProjection());
+	addOccluderBox(buffer, makeBounds(glm::vec3(0.0f, -1.5f, 0.0f), glm::vec3(50.0f, 0.5f, 50.0f)), glm::mat4(1.0f));
+	rasterizeOcclusion(buffer);
+	
+	check(getOcclusionStats(buffer)->triangles > 0, "floor crossing the near plane is clipped, not dropped");
+	check(isOccluded(buffer, makeBounds(glm::vec3(0.0f, -5.0f, -10.0f), glm::vec3(1.0f))), "box under the floor is occluded");
+	check(!isOccluded(buffer, makeBounds(glm::vec3(0.0f, 1.0f, -10.0f), glm::vec3(1.0f))), "box above the floor is visible");
+}
+
+int main(){
+	initJobs(CHECK_THREADS);
+	
+	Occlusion_Buffer buffer;
+	initOcclusionBuffer(&buffer, CHECK_WIDTH, CHECK_HEIGHT);
+	
+	printf("occlusion checks (%ux%u buffer, %u threads):\n", buffer.width, buffer.height, getJobThreadCount());
+	
+	checkEmpty(&buffer);
+	checkWall(&buffer);
+	checkWinding(&buffer);
+	checkNearClipping(&buffer);
+	
+	shutdownJobs();
+	
+	printf("%u passed, %u failed\n", passed, failed);
+	
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}